@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <glib/gstdio.h>
+
+#include "blob.h"
+#include "gckeys.h"
+
+#define BLOB_ALIGN(x) (((x) + 7) & ~(gsize) 7)
+
+/* Escaped, so that two configs never share a file */
+gchar *wg_blob_path(const gchar * config)
+{
+	gchar *name, *file, *path;
+
+	name = g_uri_escape_string(config, NULL, FALSE);
+	file = g_strconcat(name, ".blob", NULL);
+	path = g_build_filename(g_get_user_config_dir(), "wireguard", file,
+				NULL);
+
+	g_free(file);
+	g_free(name);
+	return path;
+}
+
+/* A prefix length of at most max, FALSE unless all of s is one */
+static gboolean parse_cidr(const gchar * s, gint max, guint8 * cidr)
+{
+	gchar *end;
+	long n;
+
+	if (!g_ascii_isdigit(*s))
+		return FALSE;
+
+	errno = 0;
+	n = strtol(s, &end, 10);
+	if (errno || *end != '\0' || n > max)
+		return FALSE;
+
+	*cidr = n;
+	return TRUE;
+}
+
+/* Comma separated addresses with optional prefix, NULL if one is bad */
+GArray *wg_parse_allowed_ips(const gchar * ips)
+{
+	GArray *out = g_array_new(FALSE, TRUE, sizeof(struct wg_nl_allowedip));
+	struct wg_nl_allowedip ip;
+	gchar **parts, **part, *slash;
+	gboolean ok;
+
+	parts = g_strsplit(ips ? ips : "", ",", -1);
+
+	for (part = parts; *part; part++) {
+		g_strstrip(*part);
+		if (**part == '\0')
+			continue;
+
+		memset(&ip, 0, sizeof(ip));
+
+		slash = strchr(*part, '/');
+		if (slash)
+			*slash++ = '\0';
+
+		if (inet_pton(AF_INET, *part, &ip.addr.ip4) == 1) {
+			ip.family = AF_INET;
+			ip.cidr = 32;
+		} else if (inet_pton(AF_INET6, *part, &ip.addr.ip6) == 1) {
+			ip.family = AF_INET6;
+			ip.cidr = 128;
+		}
+
+		ok = ip.family && (slash == NULL
+				   || parse_cidr(slash, ip.cidr, &ip.cidr));
+		if (!ok) {
+			g_array_free(out, TRUE);
+			out = NULL;
+			break;
+		}
+
+		g_array_append_val(out, ip);
+	}
+
+	g_strfreev(parts);
+	return out;
+}
+
+static gboolean decode_key(const gchar * base64, guint8 * key)
+{
+	guchar *raw;
+	gsize len;
+
+	if (base64 == NULL || !wg_validate_key(base64, -1))
+		return FALSE;
+
+	raw = g_base64_decode(base64, &len);
+	if (len == WG_KEY_LEN)
+		memcpy(key, raw, WG_KEY_LEN);
+	g_free(raw);
+
+	return len == WG_KEY_LEN;
+}
+
+static gchar *peer_string(GConfClient * gconf, const gchar * dir,
+			  const gchar * key)
+{
+	gchar *path = g_strjoin("/", dir, key, NULL);
+	gchar *value = gconf_client_get_string(gconf, path, NULL);
+
+	g_free(path);
+	return value;
+}
+
+static gboolean compile_peer(GConfClient * gconf, const gchar * dir,
+			     GByteArray * out)
+{
+	struct wg_blob_peer peer;
+	struct wg_endpoint ep;
+	GArray *ips = NULL;
+	gchar *pubkey, *psk, *endpoint, *allowed;
+	gboolean ok = FALSE;
+	gsize size;
+	gchar *host, *path;
+
+	memset(&peer, 0, sizeof(peer));
+
+	path = g_strjoin("/", dir, GC_PEER_KEEPALIVE, NULL);
+	peer.keepalive = gconf_client_get_int(gconf, path, NULL);
+	g_free(path);
+
+	pubkey = peer_string(gconf, dir, GC_PEER_PUBKEY);
+	psk = peer_string(gconf, dir, GC_PEER_PSK);
+	endpoint = peer_string(gconf, dir, GC_PEER_ENDPOINT);
+	allowed = peer_string(gconf, dir, GC_PEER_IPS);
+
+	if (!decode_key(pubkey, peer.public_key))
+		goto out;
+	if (psk && !decode_key(psk, peer.preshared_key))
+		goto out;
+
+	if (endpoint) {
+		peer.endpoint_kind = wg_parse_endpoint(endpoint, -1, &ep);
+		if (peer.endpoint_kind == WG_ENDPOINT_INVALID
+		    || ep.host_len > G_MAXUINT8)
+			goto out;
+
+		peer.port = ep.port;
+		host = g_strndup(ep.host, ep.host_len);
+		if (ep.kind == WG_ENDPOINT_HOSTNAME)
+			peer.host_len = ep.host_len;
+		else
+			inet_pton(ep.kind == WG_ENDPOINT_IPV4 ? AF_INET :
+				  AF_INET6, host, peer.addr);
+		g_free(host);
+	}
+
+	if ((ips = wg_parse_allowed_ips(allowed)) == NULL)
+		goto out;
+
+	peer.n_ips = ips->len;
+	size = sizeof(peer) + ips->len * sizeof(struct wg_nl_allowedip);
+	peer.record_size = BLOB_ALIGN(size + peer.host_len + 1);
+
+	g_byte_array_append(out, (guint8 *) & peer, sizeof(peer));
+	g_byte_array_append(out, (guint8 *) ips->data,
+			    ips->len * sizeof(struct wg_nl_allowedip));
+	if (peer.host_len)
+		g_byte_array_append(out, (guint8 *) ep.host, peer.host_len);
+
+	/* NUL and padding */
+	size += peer.host_len;
+	while (size++ < peer.record_size)
+		g_byte_array_append(out, (guint8 *) "", 1);
+
+	ok = TRUE;
+
+ out:
+	if (ips)
+		g_array_free(ips, TRUE);
+	g_free(pubkey);
+	g_free(psk);
+	g_free(endpoint);
+	g_free(allowed);
+	return ok;
+}
+
+static void set_compiled_hash(GConfClient * gconf, const gchar * config,
+			      const gchar * hash)
+{
+	gchar *key = g_strjoin("/", GC_WIREGUARD, config, GC_CFG_COMPILED,
+			       NULL);
+
+	if (hash)
+		gconf_client_set_string(gconf, key, hash, NULL);
+	else
+		gconf_client_unset(gconf, key, NULL);
+
+	g_free(key);
+}
+
+/*
+ * The blob holds the private key, so it must never be readable by
+ * others, not even for a moment: it is written to a file created 0600
+ * and renamed over the old one.
+ */
+static gboolean write_blob(const gchar * path, const guint8 * data,
+			   gsize len)
+{
+	gchar *tmp = g_strconcat(path, ".tmp", NULL);
+	gssize n = 0;
+	int fd;
+
+	g_unlink(tmp);
+	fd = g_open(tmp, O_CREAT | O_WRONLY | O_TRUNC | O_EXCL, 0600);
+	if (fd < 0)
+		goto fail;
+
+	while (len && (n = write(fd, data, len)) > 0) {
+		data += n;
+		len -= n;
+	}
+
+	if (n < 0 || fsync(fd) < 0) {
+		close(fd);
+		goto fail;
+	}
+
+	if (close(fd) < 0 || g_rename(tmp, path) < 0)
+		goto fail;
+
+	g_free(tmp);
+	return TRUE;
+
+ fail:
+	g_warning("Unable to write %s: %s", path, g_strerror(errno));
+	g_unlink(tmp);
+	g_free(tmp);
+	return FALSE;
+}
+
+/*
+ * Compile a config stored in gconf and write it next to the others. The
+ * hash of the result goes into the config, so a blob left over from an
+ * earlier version of it is never used. Configs that come from a file
+ * are not compiled.
+ */
+gboolean wg_blob_compile(GConfClient * gconf, const gchar * config)
+{
+	struct wg_blob_header header;
+	GByteArray *out;
+	GChecksum *sum;
+	GSList *dirs, *iter;
+	gchar *base, *peers, *privkey, *path, *dir, *hash;
+	gsize hash_len = sizeof(header.hash);
+	gboolean ok = TRUE;
+
+	base = g_strjoin("/", GC_WIREGUARD, config, NULL);
+
+	path = g_strjoin("/", base, GC_CONFIG_FILE_OVERRIDE, NULL);
+	privkey = gconf_client_get_string(gconf, path, NULL);
+	g_free(path);
+	if (privkey) {
+		g_free(privkey);
+		g_free(base);
+		wg_blob_remove(gconf, config);
+		return FALSE;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = WG_BLOB_MAGIC;
+	header.version = WG_BLOB_VERSION;
+
+	path = g_strjoin("/", base, GC_CFG_PRIVATEKEY, NULL);
+	privkey = gconf_client_get_string(gconf, path, NULL);
+	g_free(path);
+	ok = decode_key(privkey, header.private_key);
+	g_free(privkey);
+
+	out = g_byte_array_new();
+	g_byte_array_append(out, (guint8 *) & header, sizeof(header));
+
+	peers = g_strjoin("/", base, GC_PEERS, NULL);
+	dirs = gconf_client_all_dirs(gconf, peers, NULL);
+	for (iter = dirs; iter; iter = iter->next) {
+		if (ok && !compile_peer(gconf, iter->data, out))
+			ok = FALSE;
+		header.n_peers++;
+		g_free(iter->data);
+	}
+	g_slist_free(dirs);
+	g_free(peers);
+	g_free(base);
+
+	if (!ok) {
+		g_byte_array_free(out, TRUE);
+		wg_blob_remove(gconf, config);
+		return FALSE;
+	}
+
+	header.size = out->len;
+
+	sum = g_checksum_new(G_CHECKSUM_SHA256);
+	g_checksum_update(sum, out->data + sizeof(header),
+			  out->len - sizeof(header));
+	g_checksum_get_digest(sum, header.hash, &hash_len);
+	hash = g_strdup(g_checksum_get_string(sum));
+	g_checksum_free(sum);
+
+	memcpy(out->data, &header, sizeof(header));
+
+	path = wg_blob_path(config);
+	dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0700);
+
+	ok = write_blob(path, out->data, out->len);
+	if (ok)
+		set_compiled_hash(gconf, config, hash);
+
+	g_free(hash);
+	g_free(dir);
+	g_free(path);
+	g_byte_array_free(out, TRUE);
+
+	return ok;
+}
+
+void wg_blob_remove(GConfClient * gconf, const gchar * config)
+{
+	gchar *path = wg_blob_path(config);
+
+	g_unlink(path);
+	g_free(path);
+
+	if (gconf)
+		set_compiled_hash(gconf, config, NULL);
+}
+
+/* Whether the header and every peer record agree with the length */
+gboolean wg_blob_valid(const struct wg_blob *blob)
+{
+	const struct wg_blob_peer *peer;
+	gsize off = sizeof(struct wg_blob_header);
+	guint i;
+
+	if (blob->len < off || blob->header->magic != WG_BLOB_MAGIC
+	    || blob->header->version != WG_BLOB_VERSION
+	    || blob->header->size != blob->len)
+		return FALSE;
+
+	/* Every record must stay within the file */
+	for (i = 0; i < blob->header->n_peers; i++) {
+		if (blob->len - off < sizeof(*peer))
+			return FALSE;
+
+		peer = (const struct wg_blob_peer *)(blob->data + off);
+		if (peer->record_size < sizeof(*peer) + peer->host_len + 1
+		    + (gsize) peer->n_ips * sizeof(struct wg_nl_allowedip)
+		    || peer->record_size > blob->len - off)
+			return FALSE;
+
+		off += peer->record_size;
+	}
+
+	return off == blob->len;
+}
+
+/*
+ * Read a blob file, NULL if it is missing, damaged or its contents don't
+ * hash to the hex SHA-256 given.
+ */
+struct wg_blob *wg_blob_load_file(const gchar * path, const gchar * hash)
+{
+	struct wg_blob *blob = g_new0(struct wg_blob, 1);
+	GChecksum *sum;
+	gboolean ok;
+
+	if (!g_file_get_contents(path, &blob->data, &blob->len, NULL))
+		goto fail;
+
+	blob->header = (const struct wg_blob_header *)blob->data;
+	if (!wg_blob_valid(blob))
+		goto fail;
+
+	sum = g_checksum_new(G_CHECKSUM_SHA256);
+	g_checksum_update(sum, (guchar *) blob->data + sizeof(*blob->header),
+			  blob->len - sizeof(*blob->header));
+	ok = !strcmp(g_checksum_get_string(sum), hash);
+	g_checksum_free(sum);
+
+	if (ok)
+		return blob;
+
+ fail:
+	wg_blob_free(blob);
+	return NULL;
+}
+
+/*
+ * Read the compiled form of a config. NULL if there is none, or if it is
+ * damaged or doesn't match what the config says it compiled to.
+ */
+struct wg_blob *wg_blob_load(GConfClient * gconf, const gchar * config)
+{
+	struct wg_blob *blob = NULL;
+	gchar *path, *key, *expected;
+
+	key = g_strjoin("/", GC_WIREGUARD, config, GC_CFG_COMPILED, NULL);
+	expected = gconf_client_get_string(gconf, key, NULL);
+	g_free(key);
+
+	if (expected) {
+		path = wg_blob_path(config);
+		blob = wg_blob_load_file(path, expected);
+		g_free(path);
+	}
+
+	g_free(expected);
+	return blob;
+}
+
+void wg_blob_free(struct wg_blob *blob)
+{
+	if (blob == NULL)
+		return;
+
+	g_free(blob->data);
+	g_free(blob);
+}
+
+/* Iterate over the peers, pass NULL to get the first one */
+const struct wg_blob_peer *wg_blob_next_peer(const struct wg_blob *blob,
+					     const struct wg_blob_peer *prev)
+{
+	const gchar *next;
+
+	if (prev == NULL)
+		next = blob->data + sizeof(*blob->header);
+	else
+		next = (const gchar *)prev + prev->record_size;
+
+	if (next >= blob->data + blob->len)
+		return NULL;
+
+	return (const struct wg_blob_peer *)next;
+}
+
+const struct wg_blob_peer *wg_blob_find_peer(const struct wg_blob *blob,
+					     const guint8 * public_key)
+{
+	const struct wg_blob_peer *peer = NULL;
+
+	while ((peer = wg_blob_next_peer(blob, peer)))
+		if (!memcmp(peer->public_key, public_key, WG_KEY_LEN))
+			return peer;
+
+	return NULL;
+}
+
+const struct wg_nl_allowedip *wg_blob_peer_ips(const struct wg_blob_peer
+					       *peer)
+{
+	return (const struct wg_nl_allowedip *)(peer + 1);
+}
+
+/* The hostname of the endpoint, "" for literal addresses */
+const gchar *wg_blob_peer_host(const struct wg_blob_peer *peer)
+{
+	return (const gchar *)(wg_blob_peer_ips(peer) + peer->n_ips);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __BLOB_H__
+#define __BLOB_H__
+
+#include <gconf/gconf-client.h>
+#include <glib.h>
+
+#include "validate.h"
+#include "wgnl.h"
+
+/*
+ * A config compiled into what the kernel needs: keys decoded, endpoints
+ * and allowed IPs parsed. The file is a local cache in native byte
+ * order, written by whoever saves a config and read back in one go.
+ */
+
+#define WG_BLOB_MAGIC 0x57474231	/* "WGB1" */
+#define WG_BLOB_VERSION 2
+#define WG_BLOB_HASH_LEN 32
+
+struct wg_blob_header {
+	guint32 magic;
+	guint32 version;
+	guint32 size;
+	guint32 n_peers;
+	/* SHA-256 of everything after the header */
+	guint8 hash[WG_BLOB_HASH_LEN];
+	guint8 private_key[WG_KEY_LEN];
+};
+
+/*
+ * Followed by n_ips struct wg_nl_allowedip and then the NUL-terminated
+ * hostname, padded to 8 bytes in all.
+ */
+struct wg_blob_peer {
+	guint8 public_key[WG_KEY_LEN];
+	/* All zero without a preshared key */
+	guint8 preshared_key[WG_KEY_LEN];
+	guint32 record_size;
+	guint32 n_ips;
+	/* Seconds, or WG_KEEPALIVE_OFF or WG_KEEPALIVE_ADAPTIVE */
+	gint32 keepalive;
+	guint16 port;
+	/* enum wg_endpoint_kind, WG_ENDPOINT_INVALID without endpoint */
+	guint8 endpoint_kind;
+	guint8 host_len;
+	/* The address of a literal endpoint, in network byte order */
+	guint8 addr[16];
+};
+
+struct wg_blob {
+	gchar *data;
+	gsize len;
+	const struct wg_blob_header *header;
+};
+
+gchar *wg_blob_path(const gchar * config);
+GArray *wg_parse_allowed_ips(const gchar * ips);
+gboolean wg_blob_compile(GConfClient * gconf, const gchar * config);
+void wg_blob_remove(GConfClient * gconf, const gchar * config);
+
+gboolean wg_blob_valid(const struct wg_blob *blob);
+struct wg_blob *wg_blob_load_file(const gchar * path, const gchar * hash);
+struct wg_blob *wg_blob_load(GConfClient * gconf, const gchar * config);
+void wg_blob_free(struct wg_blob *blob);
+
+const struct wg_blob_peer *wg_blob_next_peer(const struct wg_blob *blob,
+					     const struct wg_blob_peer *prev);
+const struct wg_blob_peer *wg_blob_find_peer(const struct wg_blob *blob,
+					     const guint8 * public_key);
+const struct wg_nl_allowedip *wg_blob_peer_ips(const struct wg_blob_peer
+					       *peer);
+const gchar *wg_blob_peer_host(const struct wg_blob_peer *peer);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __GCKEYS_H__
+#define __GCKEYS_H__
+
+#include <icd/wireguard/libicd_wireguard_shared.h>
+
+/*
+ * Keys and methods used by the applets that libicd-network-wireguard
+ * doesn't know about (yet). Guarded, so a newer shared header takes
+ * precedence.
+ */
+
+/* Ordered list of configs to fail over to when the tunnel goes stale */
+#ifndef GC_WIREGUARD_FAILOVER
+#define GC_WIREGUARD_FAILOVER GC_WIREGUARD"/failover_configs"
+#endif
+
+/* Seconds a tunnel may be stale before failing over, 0 disables it */
+#ifndef GC_WIREGUARD_FAILOVER_TIMEOUT
+#define GC_WIREGUARD_FAILOVER_TIMEOUT GC_WIREGUARD"/failover_timeout"
+#endif
+
+/* Hash of the compiled form of a config, see blob.h */
+#ifndef GC_CFG_COMPILED
+#define GC_CFG_COMPILED "CompiledHash"
+#endif
+
+/* Tunnel MTU of a config, 0 works it out from the path, see mtu.h */
+#ifndef GC_CFG_MTU
+#define GC_CFG_MTU "MTU"
+#endif
+
+/* Address of a host with discard and chargen, see speedtest.h */
+#ifndef GC_CFG_SPEEDTEST
+#define GC_CFG_SPEEDTEST "SpeedTestHost"
+#endif
+
+/* PersistentKeepalive of a peer, see keepalive.h */
+#ifndef GC_PEER_KEEPALIVE
+#define GC_PEER_KEEPALIVE "PersistentKeepalive"
+#endif
+
+/*
+ * Provider methods for what the applet works out at run time but can't
+ * set itself, as that takes CAP_NET_ADMIN. SetMtu takes the MTU (u),
+ * SetKeepalive the base64 public keys of peers (as) and their
+ * keepalives in seconds (au).
+ */
+#ifndef ICD_WIREGUARD_METHOD_SETMTU
+#define ICD_WIREGUARD_METHOD_SETMTU "SetMtu"
+#endif
+
+#ifndef ICD_WIREGUARD_METHOD_SETKEEPALIVE
+#define ICD_WIREGUARD_METHOD_SETKEEPALIVE "SetKeepalive"
+#endif
+
+#endif
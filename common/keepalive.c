@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "keepalive.h"
+
+/* The keepalive entry as typed: "off" or empty, "auto", or seconds */
+gboolean wg_keepalive_parse(const gchar * s, gint * keepalive)
+{
+	gchar *end;
+	glong secs;
+
+	if (s == NULL || *s == '\0' || !g_ascii_strcasecmp(s, "off")) {
+		*keepalive = WG_KEEPALIVE_OFF;
+		return TRUE;
+	}
+
+	if (!g_ascii_strcasecmp(s, "auto")) {
+		*keepalive = WG_KEEPALIVE_ADAPTIVE;
+		return TRUE;
+	}
+
+	secs = strtol(s, &end, 10);
+	if (*end != '\0' || secs < 0 || secs > WG_KEEPALIVE_MAX)
+		return FALSE;
+
+	*keepalive = secs;
+	return TRUE;
+}
+
+gchar *wg_keepalive_to_string(gint keepalive)
+{
+	if (keepalive == WG_KEEPALIVE_ADAPTIVE)
+		return g_strdup("auto");
+	if (keepalive <= WG_KEEPALIVE_OFF)
+		return g_strdup("off");
+
+	return g_strdup_printf("%d", keepalive);
+}
+
+/* Start learning from scratch, e.g. on a new network */
+void wg_keepalive_reset(struct wg_keepalive *ka, gint64 now)
+{
+	gboolean battery = ka->battery;
+	guint backoffs = ka->backoffs;
+
+	memset(ka, 0, sizeof(*ka));
+	ka->interval = WG_KEEPALIVE_MIN_S;
+	ka->since = now;
+	ka->battery = battery;
+	ka->backoffs = backoffs;
+}
+
+/* The interval to use now, in seconds */
+guint wg_keepalive_current(const struct wg_keepalive *ka)
+{
+	if (ka->battery)
+		return MAX(ka->interval, WG_KEEPALIVE_BATTERY_S);
+
+	return ka->interval;
+}
+
+static guint next_interval(const struct wg_keepalive *ka)
+{
+	/* Halve the distance to what failed, or grow by half without it */
+	if (ka->failed) {
+		if (ka->failed - ka->good <= WG_KEEPALIVE_PRECISION_S)
+			return ka->interval;
+		return ka->good + (ka->failed - ka->good) / 2;
+	}
+
+	return MIN(ka->interval + ka->interval / 2, WG_KEEPALIVE_CEILING_S);
+}
+
+/*
+ * Tell whether handshakes still work at the current interval. Returns
+ * TRUE when the interval to use changed.
+ */
+gboolean wg_keepalive_feed(struct wg_keepalive *ka, gboolean handshakes_ok,
+			   gint64 now)
+{
+	guint next;
+
+	/* Failures are expected on battery, nothing to learn from them */
+	if (ka->battery)
+		return FALSE;
+
+	if (!handshakes_ok) {
+		if (ka->interval <= WG_KEEPALIVE_MIN_S)
+			return FALSE;
+
+		/* What held before doesn't any more, the NAT changed */
+		if (ka->good >= ka->interval)
+			ka->good = 0;
+
+		ka->failed = ka->interval;
+		ka->interval = MAX(ka->good, WG_KEEPALIVE_MIN_S);
+		ka->since = now;
+		ka->backoffs++;
+		return TRUE;
+	}
+
+	if (now - ka->since < WG_KEEPALIVE_PROBATION_S * (gint64) G_USEC_PER_SEC)
+		return FALSE;
+
+	ka->good = MAX(ka->good, ka->interval);
+	ka->since = now;
+
+	next = next_interval(ka);
+	if (next <= ka->interval)
+		return FALSE;
+
+	ka->interval = next;
+	return TRUE;
+}
+
+/*
+ * Switch to the longer profile on battery with the screen off, and back.
+ * Returns TRUE when the interval to use changed.
+ */
+gboolean wg_keepalive_set_battery(struct wg_keepalive *ka, gboolean battery,
+				  gint64 now)
+{
+	guint before = wg_keepalive_current(ka);
+
+	if (ka->battery == battery)
+		return FALSE;
+
+	ka->battery = battery;
+
+	/* Whatever happened meanwhile says nothing about the interval */
+	if (!battery)
+		ka->since = now;
+
+	return wg_keepalive_current(ka) != before;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __KEEPALIVE_H__
+#define __KEEPALIVE_H__
+
+#include <glib.h>
+
+/* What the keepalive key of a peer holds, besides a number of seconds */
+#define WG_KEEPALIVE_OFF 0
+#define WG_KEEPALIVE_ADAPTIVE -1
+#define WG_KEEPALIVE_MAX 65535
+
+/*
+ * The adaptive interval starts short enough for about any NAT and grows
+ * while handshakes keep working at it, until one fails. It then stays
+ * at the longest interval that worked, narrowing in on the NAT's mapping
+ * timeout to within WG_KEEPALIVE_PRECISION_S.
+ */
+#define WG_KEEPALIVE_MIN_S 25
+#define WG_KEEPALIVE_CEILING_S 300
+#define WG_KEEPALIVE_PROBATION_S 600
+#define WG_KEEPALIVE_PRECISION_S 5
+
+/*
+ * On battery with the screen off nobody waits for incoming traffic, so
+ * a mapping may expire now and then: the interval is at least this.
+ */
+#define WG_KEEPALIVE_BATTERY_S 300
+
+struct wg_keepalive {
+	/* The interval being tried */
+	guint interval;
+	/* Longest interval that held, 0 if none did yet */
+	guint good;
+	/* Shortest interval that failed, 0 if none did yet */
+	guint failed;
+	/* Monotonic time interval was taken into use */
+	gint64 since;
+	gboolean battery;
+	guint backoffs;
+};
+
+gboolean wg_keepalive_parse(const gchar * s, gint * keepalive);
+gchar *wg_keepalive_to_string(gint keepalive);
+
+void wg_keepalive_reset(struct wg_keepalive *ka, gint64 now);
+guint wg_keepalive_current(const struct wg_keepalive *ka);
+gboolean wg_keepalive_feed(struct wg_keepalive *ka, gboolean handshakes_ok,
+			   gint64 now);
+gboolean wg_keepalive_set_battery(struct wg_keepalive *ka, gboolean battery,
+				  gint64 now);
+
+#endif
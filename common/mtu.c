@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "mtu.h"
+#include "wakeups.h"
+
+struct wg_mtu_probe {
+	int fd;
+	int family;
+	/* Largest packet the path takes, as far as we know */
+	gint path_mtu;
+	guint tries;
+	guint watch;
+	guint timeout;
+	wg_mtu_probe_cb cb;
+	gpointer data;
+};
+
+/* The MTU key as typed: "auto" or empty, or a number within range */
+gint wg_mtu_parse(const gchar * s)
+{
+	gchar *end;
+	glong mtu;
+
+	if (s == NULL || *s == '\0' || !g_ascii_strcasecmp(s, "auto"))
+		return WG_MTU_AUTO;
+
+	mtu = strtol(s, &end, 10);
+	if (*end != '\0' || mtu < WG_MTU_MIN || mtu > WG_MTU_MAX)
+		return -1;
+
+	return mtu;
+}
+
+/*
+ * The tunnel MTU for a path that takes link_mtu sized packets, with the
+ * endpoint in the given address family. A link that is too small for
+ * the minimum has the outer packets fragmented rather than IPv6 broken.
+ */
+guint wg_mtu_for_link(guint link_mtu, int family)
+{
+	guint overhead = family == AF_INET6 ? WG_MTU_OVERHEAD_IPV6 :
+	    WG_MTU_OVERHEAD_IPV4;
+
+	if (link_mtu == 0)
+		return WG_MTU_DEFAULT;
+
+	if (link_mtu < WG_MTU_MIN + overhead)
+		return WG_MTU_MIN;
+
+	return MIN(link_mtu - overhead, WG_MTU_MAX);
+}
+
+static int mtu_level(int family)
+{
+	return family == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+}
+
+static gint socket_mtu(int fd, int family)
+{
+	socklen_t len = sizeof(int);
+	int mtu;
+
+	if (getsockopt(fd, mtu_level(family),
+		       family == AF_INET6 ? IPV6_MTU : IP_MTU, &mtu, &len) < 0)
+		return -errno;
+
+	return mtu;
+}
+
+static int open_connected(const struct sockaddr *dst, socklen_t len,
+			  int flags)
+{
+	int fd, err;
+
+	fd = socket(dst->sa_family, SOCK_DGRAM | SOCK_CLOEXEC | flags,
+		    IPPROTO_UDP);
+	if (fd < 0)
+		return -errno;
+
+	if (connect(fd, dst, len) < 0) {
+		err = errno;
+		close(fd);
+		return -err;
+	}
+
+	return fd;
+}
+
+/*
+ * The MTU of the path to dst as the kernel knows it: the MTU of the
+ * interface the route goes out of, or less if ICMP said so before.
+ * Returns a negative errno value on failure.
+ */
+gint wg_mtu_path(const struct sockaddr *dst, socklen_t len)
+{
+	gint mtu;
+	int fd;
+
+	fd = open_connected(dst, len, 0);
+	if (fd < 0)
+		return fd;
+
+	mtu = socket_mtu(fd, dst->sa_family);
+	close(fd);
+
+	return mtu;
+}
+
+static void probe_free(struct wg_mtu_probe *probe)
+{
+	if (probe->watch)
+		g_source_remove(probe->watch);
+	if (probe->timeout)
+		g_source_remove(probe->timeout);
+	if (probe->fd >= 0)
+		close(probe->fd);
+
+	g_free(probe);
+}
+
+static void probe_finish(struct wg_mtu_probe *probe)
+{
+	probe->cb(wg_mtu_for_link(probe->path_mtu, probe->family),
+		  probe->data);
+	probe_free(probe);
+}
+
+/*
+ * Send a packet as large as the path is thought to take, with DF set.
+ * The peer drops it, but a router in between that can't forward it
+ * reports back what it can. Returns FALSE once there is nothing to send.
+ */
+static gboolean probe_send(struct wg_mtu_probe *probe)
+{
+	gsize headers = probe->family == AF_INET6 ? 40 + 8 : 20 + 8;
+	guint8 *buf;
+	gssize ret;
+
+	while (probe->tries++ < WG_MTU_PROBE_TRIES) {
+		if (probe->path_mtu <= (gint) headers)
+			return FALSE;
+
+		buf = g_malloc0(probe->path_mtu - headers);
+		ret = send(probe->fd, buf, probe->path_mtu - headers, 0);
+		g_free(buf);
+
+		if (ret >= 0)
+			return TRUE;
+		if (errno != EMSGSIZE)
+			return FALSE;
+
+		/* The kernel already knows of a smaller MTU */
+		probe->path_mtu = socket_mtu(probe->fd, probe->family);
+	}
+
+	return FALSE;
+}
+
+/* The MTU a router reported, -1 for other errors */
+static gint read_error(struct wg_mtu_probe *probe)
+{
+	struct sock_extended_err *ee;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	guint8 control[512];
+	gint mtu = -1;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if (recvmsg(probe->fd, &msg, MSG_ERRQUEUE) < 0)
+		return -1;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (!(cmsg->cmsg_level == IPPROTO_IP
+		      && cmsg->cmsg_type == IP_RECVERR)
+		    && !(cmsg->cmsg_level == IPPROTO_IPV6
+			 && cmsg->cmsg_type == IPV6_RECVERR))
+			continue;
+
+		ee = (struct sock_extended_err *)CMSG_DATA(cmsg);
+		if (ee->ee_errno == EMSGSIZE && ee->ee_info > 0)
+			mtu = ee->ee_info;
+	}
+
+	return mtu;
+}
+
+/* FALSE once the probe is done */
+static gboolean probe_error(struct wg_mtu_probe *probe)
+{
+	gint mtu;
+
+	mtu = read_error(probe);
+	if (mtu < 0 || mtu >= probe->path_mtu)
+		return TRUE;
+
+	probe->path_mtu = mtu;
+	if (probe_send(probe))
+		return TRUE;
+
+	probe->watch = 0;
+	probe_finish(probe);
+	return FALSE;
+}
+
+static gboolean probe_error_cb(GIOChannel * source, GIOCondition cond,
+			       gpointer data)
+{
+	struct wakeup w;
+	gboolean ret;
+
+	(void)source;
+	(void)cond;
+
+	wakeup_begin(&w, WAKEUP_MTU_PROBE);
+	ret = probe_error(data);
+	wakeup_end(&w);
+
+	return ret;
+}
+
+static gboolean probe_timeout_cb(gpointer data)
+{
+	struct wg_mtu_probe *probe = data;
+	struct wakeup w;
+
+	/* No complaints within the timeout, the path takes it */
+	wakeup_begin(&w, WAKEUP_MTU_PROBE);
+	probe->timeout = 0;
+	probe_finish(probe);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+/*
+ * Refine the MTU of the path to dst by sending packets with DF set to
+ * it. cb gets the tunnel MTU once probing is done, from the main loop,
+ * and the probe is freed after it returns. NULL if probing can't start.
+ */
+struct wg_mtu_probe *wg_mtu_probe_start(const struct sockaddr *dst,
+					socklen_t len, wg_mtu_probe_cb cb,
+					gpointer data)
+{
+	struct wg_mtu_probe *probe;
+	GIOChannel *channel;
+	int on = 1, pmtudisc;
+
+	probe = g_new0(struct wg_mtu_probe, 1);
+	probe->family = dst->sa_family;
+	probe->cb = cb;
+	probe->data = data;
+
+	probe->fd = open_connected(dst, len, SOCK_NONBLOCK);
+	if (probe->fd < 0)
+		goto fail;
+
+	if (probe->family == AF_INET6) {
+		pmtudisc = IPV6_PMTUDISC_DO;
+		if (setsockopt(probe->fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER,
+			       &pmtudisc, sizeof(pmtudisc)) < 0
+		    || setsockopt(probe->fd, IPPROTO_IPV6, IPV6_RECVERR, &on,
+				  sizeof(on)) < 0)
+			goto fail;
+	} else {
+		pmtudisc = IP_PMTUDISC_DO;
+		if (setsockopt(probe->fd, IPPROTO_IP, IP_MTU_DISCOVER,
+			       &pmtudisc, sizeof(pmtudisc)) < 0
+		    || setsockopt(probe->fd, IPPROTO_IP, IP_RECVERR, &on,
+				  sizeof(on)) < 0)
+			goto fail;
+	}
+
+	probe->path_mtu = socket_mtu(probe->fd, probe->family);
+	if (probe->path_mtu < 0 || !probe_send(probe))
+		goto fail;
+
+	channel = g_io_channel_unix_new(probe->fd);
+	probe->watch = g_io_add_watch(channel, G_IO_ERR, probe_error_cb, probe);
+	g_io_channel_unref(channel);
+
+	probe->timeout = g_timeout_add(WG_MTU_PROBE_TIMEOUT_MS,
+				       probe_timeout_cb, probe);
+
+	return probe;
+
+ fail:
+	probe_free(probe);
+	return NULL;
+}
+
+void wg_mtu_probe_cancel(struct wg_mtu_probe *probe)
+{
+	if (probe)
+		probe_free(probe);
+}
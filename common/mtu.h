@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __MTU_H__
+#define __MTU_H__
+
+#include <sys/socket.h>
+
+#include <glib.h>
+
+/* What the MTU key of a config holds when the MTU is worked out for it */
+#define WG_MTU_AUTO 0
+
+/* IPv6 inside the tunnel needs at least this much */
+#define WG_MTU_MIN 1280
+#define WG_MTU_MAX 9000
+
+/* Outer IP and UDP headers plus WireGuard's data header and tag */
+#define WG_MTU_OVERHEAD_IPV4 (20 + 8 + 32)
+#define WG_MTU_OVERHEAD_IPV6 (40 + 8 + 32)
+
+/* What wg-quick uses when it knows nothing: 1500 less IPv6 overhead */
+#define WG_MTU_DEFAULT 1420
+
+#define WG_MTU_PROBE_TRIES 4
+#define WG_MTU_PROBE_TIMEOUT_MS 1000
+
+/* The tunnel MTU that fits the path that was probed */
+typedef void (*wg_mtu_probe_cb)(gint mtu, gpointer data);
+
+struct wg_mtu_probe;
+
+gint wg_mtu_parse(const gchar * s);
+guint wg_mtu_for_link(guint link_mtu, int family);
+gint wg_mtu_path(const struct sockaddr *dst, socklen_t len);
+
+struct wg_mtu_probe *wg_mtu_probe_start(const struct sockaddr *dst,
+					socklen_t len, wg_mtu_probe_cb cb,
+					gpointer data);
+void wg_mtu_probe_cancel(struct wg_mtu_probe *probe);
+
+#endif
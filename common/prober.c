@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <sys/socket.h>
+
+#include <gio/gio.h>
+
+#include "prober.h"
+#include "resolvcache.h"
+#include "validate.h"
+#include "wakeups.h"
+
+/*
+ * Where the probe number goes. For ICMP that is the echo sequence, for
+ * UDP the low half of a handshake initiation's sender index.
+ */
+#define PROBE_SEQ_OFFSET 6
+
+/* WireGuard message type of a handshake initiation */
+#define WG_HANDSHAKE_INITIATION 1
+
+struct probe_target {
+	/* NULL once the run is over while a lookup was still going */
+	struct wg_prober *prober;
+	gchar *name;
+	gchar *host;
+	guint16 port;
+	enum wg_endpoint_kind kind;
+	gboolean resolving;
+
+	int fd;
+	gboolean icmp;
+	/* The port was closed or the host unreachable */
+	gboolean refused;
+	guint watch;
+	gint64 sent_at[WG_PROBE_COUNT];
+	guint sent;
+	guint received;
+	gint64 best;
+};
+
+struct wg_prober {
+	/* name -> struct wg_probe_result */
+	GHashTable *results;
+	GPtrArray *queued;
+	GPtrArray *running;
+	guint timeout;
+	wg_probe_done_cb cb;
+	gpointer data;
+};
+
+static void target_free(struct probe_target *t)
+{
+	if (t->watch)
+		g_source_remove(t->watch);
+	if (t->fd >= 0)
+		close(t->fd);
+
+	g_free(t->name);
+	g_free(t->host);
+	g_free(t);
+}
+
+/* Detach a target from its run, it is freed once its lookup returns */
+static void target_release(gpointer data)
+{
+	struct probe_target *t = data;
+
+	if (t->resolving)
+		t->prober = NULL;
+	else
+		target_free(t);
+}
+
+struct wg_prober *wg_prober_new(void)
+{
+	struct wg_prober *prober = g_new0(struct wg_prober, 1);
+
+	prober->results = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, g_free);
+	prober->queued = g_ptr_array_new_with_free_func(target_release);
+	prober->running = g_ptr_array_new_with_free_func(target_release);
+
+	return prober;
+}
+
+void wg_prober_free(struct wg_prober *prober)
+{
+	if (prober == NULL)
+		return;
+
+	if (prober->timeout)
+		g_source_remove(prober->timeout);
+
+	g_ptr_array_free(prober->queued, TRUE);
+	g_ptr_array_free(prober->running, TRUE);
+	g_hash_table_destroy(prober->results);
+	g_free(prober);
+}
+
+gboolean wg_prober_is_fresh(struct wg_prober *prober, const gchar * name)
+{
+	struct wg_probe_result *res = g_hash_table_lookup(prober->results,
+							  name);
+
+	return res && g_get_monotonic_time() - res->time <
+	    (gint64) WG_PROBE_TTL * G_USEC_PER_SEC;
+}
+
+/* Queue an endpoint to be probed for name by the next run */
+void wg_prober_add(struct wg_prober *prober, const gchar * name,
+		   const gchar * endpoint)
+{
+	struct probe_target *t;
+	struct wg_endpoint ep;
+
+	if (wg_parse_endpoint(endpoint, -1, &ep) == WG_ENDPOINT_INVALID)
+		return;
+
+	t = g_new0(struct probe_target, 1);
+	t->name = g_strdup(name);
+	t->host = g_strndup(ep.host, ep.host_len);
+	t->port = ep.port;
+	t->kind = ep.kind;
+	t->fd = -1;
+	t->best = -1;
+
+	g_ptr_array_add(prober->queued, t);
+}
+
+/* Add what a target found to the result for its name */
+static void merge_result(struct probe_target *t)
+{
+	struct wg_probe_result *res;
+
+	res = g_hash_table_lookup(t->prober->results, t->name);
+	res->sent += t->sent;
+	res->received += t->received;
+	if (t->best >= 0 && (res->rtt_us < 0 || t->best < res->rtt_us))
+		res->rtt_us = t->best;
+	if (t->sent && !t->icmp && !t->received && !t->refused)
+		res->unmeasured = TRUE;
+}
+
+static void finish_run(struct wg_prober *prober)
+{
+	wg_probe_done_cb cb = prober->cb;
+	guint i;
+
+	if (prober->timeout) {
+		g_source_remove(prober->timeout);
+		prober->timeout = 0;
+	}
+
+	/* Whatever hasn't answered by now counts as lost */
+	for (i = 0; i < prober->running->len; i++)
+		merge_result(prober->running->pdata[i]);
+	g_ptr_array_set_size(prober->running, 0);
+	prober->cb = NULL;
+
+	if (cb)
+		cb(prober->data);
+}
+
+static void target_done(struct probe_target *t)
+{
+	struct wg_prober *prober = t->prober;
+
+	merge_result(t);
+
+	/* This frees t */
+	g_ptr_array_remove_fast(prober->running, t);
+
+	/* Don't wait for the timeout when everybody answered */
+	if (prober->running->len == 0)
+		finish_run(prober);
+}
+
+/* FALSE once the target is done */
+static gboolean read_replies(struct probe_target *t)
+{
+	guint8 buf[WG_PROBE_SIZE];
+	gint64 now = g_get_monotonic_time();
+	guint16 seq;
+	ssize_t len;
+
+	while ((len = recv(t->fd, buf, sizeof(buf), 0)) >= 0) {
+		if (len < PROBE_SEQ_OFFSET + 2)
+			continue;
+
+		if (t->icmp && buf[0] != ICMP_ECHOREPLY
+		    && buf[0] != ICMP6_ECHO_REPLY)
+			continue;
+
+		seq = buf[PROBE_SEQ_OFFSET] << 8 | buf[PROBE_SEQ_OFFSET + 1];
+		if (seq >= WG_PROBE_COUNT || t->sent_at[seq] == 0)
+			continue;
+
+		t->received++;
+		if (t->best < 0 || now - t->sent_at[seq] < t->best)
+			t->best = now - t->sent_at[seq];
+		t->sent_at[seq] = 0;
+	}
+
+	/* Unreachable or refused, there is nothing more to wait for */
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		t->refused = TRUE;
+
+	if (t->refused || t->received == t->sent) {
+		t->watch = 0;
+		target_done(t);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean reply_cb(GIOChannel * source, GIOCondition cond,
+			 gpointer data)
+{
+	struct wakeup w;
+	gboolean ret;
+
+	(void)source;
+	(void)cond;
+
+	wakeup_begin(&w, WAKEUP_PROBER);
+	ret = read_replies(data);
+	wakeup_end(&w);
+
+	return ret;
+}
+
+static int open_probe_socket(int family, gboolean * icmp)
+{
+	int fd;
+
+	/* Unprivileged ICMP only works within net.ipv4.ping_group_range */
+	fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		    family == AF_INET ? IPPROTO_ICMP : IPPROTO_ICMPV6);
+	*icmp = fd >= 0;
+	if (fd >= 0)
+		return fd;
+
+	return socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		      IPPROTO_UDP);
+}
+
+/*
+ * Send all probes of a target at once. Real WireGuard peers silently
+ * drop UDP probes, so without ICMP silence is reported as unmeasured;
+ * only an echo service or a refused port tell anything.
+ */
+static gboolean send_probes(struct probe_target *t, GInetAddress * addr)
+{
+	struct sockaddr_storage ss;
+	GSocketAddress *sa;
+	GIOChannel *channel;
+	guint8 buf[WG_PROBE_SIZE];
+	socklen_t len;
+	guint i;
+
+	sa = g_inet_socket_address_new(addr, t->port);
+	len = g_socket_address_get_native_size(sa);
+	if (!g_socket_address_to_native(sa, &ss, sizeof(ss), NULL)) {
+		g_object_unref(sa);
+		return FALSE;
+	}
+	g_object_unref(sa);
+
+	t->fd = open_probe_socket(ss.ss_family, &t->icmp);
+	if (t->fd < 0 || connect(t->fd, (struct sockaddr *)&ss, len) < 0)
+		return FALSE;
+
+	memset(buf, 0, sizeof(buf));
+	if (t->icmp)
+		buf[0] = ss.ss_family == AF_INET ? ICMP_ECHO :
+		    ICMP6_ECHO_REQUEST;
+	else
+		buf[0] = WG_HANDSHAKE_INITIATION;
+
+	for (i = 0; i < WG_PROBE_COUNT; i++) {
+		buf[PROBE_SEQ_OFFSET] = i >> 8;
+		buf[PROBE_SEQ_OFFSET + 1] = i & 0xff;
+
+		t->sent_at[i] = g_get_monotonic_time();
+		if (send(t->fd, buf, sizeof(buf), 0) < 0) {
+			t->sent_at[i] = 0;
+			continue;
+		}
+		t->sent++;
+	}
+
+	if (t->sent == 0)
+		return FALSE;
+
+	channel = g_io_channel_unix_new(t->fd);
+	t->watch = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+				  reply_cb, t);
+	g_io_channel_unref(channel);
+
+	return TRUE;
+}
+
+static void resolved_cb(const gchar * host, GInetAddress * addr,
+			gpointer data)
+{
+	struct probe_target *t = data;
+
+	(void)host;
+
+	t->resolving = FALSE;
+
+	if (t->prober == NULL) {
+		target_free(t);
+		return;
+	}
+
+	if (addr == NULL || !send_probes(t, addr))
+		target_done(t);
+}
+
+static gboolean run_timeout_cb(gpointer data)
+{
+	struct wg_prober *prober = data;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_PROBER);
+	prober->timeout = 0;
+	finish_run(prober);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+/*
+ * Probe everything queued since the last run in parallel. cb is called
+ * once all targets answered or WG_PROBE_TIMEOUT_MS passed. Returns FALSE
+ * if there was nothing to probe or a run is still going.
+ */
+gboolean wg_prober_run(struct wg_prober *prober, wg_probe_done_cb cb,
+		       gpointer data)
+{
+	struct wg_probe_result *res;
+	struct probe_target *t;
+	GInetAddress *addr;
+	GPtrArray *tmp;
+	gint64 now = g_get_monotonic_time();
+	guint i;
+
+	if (prober->timeout || prober->queued->len == 0)
+		return FALSE;
+
+	tmp = prober->running;
+	prober->running = prober->queued;
+	prober->queued = tmp;
+
+	prober->cb = cb;
+	prober->data = data;
+
+	for (i = 0; i < prober->running->len; i++) {
+		t = prober->running->pdata[i];
+		t->prober = prober;
+
+		res = g_new0(struct wg_probe_result, 1);
+		res->rtt_us = -1;
+		res->time = now;
+		g_hash_table_replace(prober->results, g_strdup(t->name), res);
+	}
+
+	prober->timeout = g_timeout_add(WG_PROBE_TIMEOUT_MS, run_timeout_cb,
+					prober);
+
+	/* Targets may finish right away, so walk a copy */
+	tmp = g_ptr_array_sized_new(prober->running->len);
+	for (i = 0; i < prober->running->len; i++)
+		g_ptr_array_add(tmp, prober->running->pdata[i]);
+
+	for (i = 0; i < tmp->len && prober->timeout; i++) {
+		t = tmp->pdata[i];
+
+		if (t->kind != WG_ENDPOINT_HOSTNAME) {
+			addr = g_inet_address_new_from_string(t->host);
+			resolved_cb(t->host, addr, t);
+			if (addr)
+				g_object_unref(addr);
+			continue;
+		}
+
+		t->resolving = TRUE;
+		wg_resolv_cache_resolve(wg_resolv_cache_get_default(), t->host,
+					resolved_cb, t);
+	}
+
+	g_ptr_array_free(tmp, TRUE);
+	return TRUE;
+}
+
+const struct wg_probe_result *wg_prober_lookup(struct wg_prober *prober,
+					       const gchar * name)
+{
+	return g_hash_table_lookup(prober->results, name);
+}
+
+/* Where a result sorts: by latency, then unknown ones, unreachable last */
+static gint64 rank(const struct wg_probe_result *res)
+{
+	if (res && res->rtt_us >= 0)
+		return res->rtt_us;
+
+	return res == NULL || res->unmeasured ? G_MAXINT64 - 1 : G_MAXINT64;
+}
+
+/*
+ * Order names by measured latency. Names that weren't probed or only
+ * got unanswered UDP probes are not ranked; they stay in name order
+ * after the measured ones, ahead of those found unreachable.
+ */
+gint wg_prober_compare(struct wg_prober *prober, const gchar * a,
+		       const gchar * b)
+{
+	gint64 ta = rank(wg_prober_lookup(prober, a));
+	gint64 tb = rank(wg_prober_lookup(prober, b));
+
+	if (ta != tb)
+		return ta < tb ? -1 : 1;
+
+	return g_strcmp0(a, b);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __PROBER_H__
+#define __PROBER_H__
+
+#include <glib.h>
+
+#define WG_PROBE_COUNT 3
+#define WG_PROBE_TIMEOUT_MS 2000
+/* Seconds a result is good for before the name is probed again */
+#define WG_PROBE_TTL 300
+/* The size of a WireGuard handshake initiation */
+#define WG_PROBE_SIZE 148
+
+struct wg_probe_result {
+	/* Best round trip time, -1 if nothing came back */
+	gint64 rtt_us;
+	guint sent;
+	guint received;
+	/*
+	 * Only UDP could be sent and nothing came back. Real WireGuard
+	 * peers never answer those, so this says nothing about the peer
+	 * and the name is not ranked by it.
+	 */
+	gboolean unmeasured;
+	/* Monotonic time the result was taken */
+	gint64 time;
+};
+
+typedef void (*wg_probe_done_cb)(gpointer data);
+
+struct wg_prober;
+
+struct wg_prober *wg_prober_new(void);
+void wg_prober_free(struct wg_prober *prober);
+
+gboolean wg_prober_is_fresh(struct wg_prober *prober, const gchar * name);
+void wg_prober_add(struct wg_prober *prober, const gchar * name,
+		   const gchar * endpoint);
+gboolean wg_prober_run(struct wg_prober *prober, wg_probe_done_cb cb,
+		       gpointer data);
+const struct wg_probe_result *wg_prober_lookup(struct wg_prober *prober,
+					       const gchar * name);
+gint wg_prober_compare(struct wg_prober *prober, const gchar * a,
+		       const gchar * b);
+
+#endif
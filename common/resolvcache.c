@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gio/gio.h>
+
+#include "resolvcache.h"
+#include "validate.h"
+#include "wakeups.h"
+
+struct resolv_waiter {
+	wg_resolve_cb cb;
+	gpointer data;
+};
+
+struct resolv_entry {
+	/* NULL for a negative entry */
+	GInetAddress *addr;
+	gint64 expires;
+	gboolean pending;
+	GSList *waiters;
+};
+
+struct resolv_lookup {
+	struct wg_resolv_cache *cache;
+	gchar *host;
+};
+
+struct wg_resolv_cache {
+	GResolver *resolver;
+	GCancellable *cancellable;
+	GHashTable *entries;
+	gint64 positive_ttl;
+	gint64 negative_ttl;
+	struct wg_resolv_stats stats;
+};
+
+static struct wg_resolv_cache *default_cache;
+
+static void free_entry(gpointer data)
+{
+	struct resolv_entry *entry = data;
+
+	if (entry->addr)
+		g_object_unref(entry->addr);
+
+	g_slist_foreach(entry->waiters, (GFunc) g_free, NULL);
+	g_slist_free(entry->waiters);
+	g_free(entry);
+}
+
+struct wg_resolv_cache *wg_resolv_cache_new(GResolver * resolver,
+					    guint positive_ttl,
+					    guint negative_ttl)
+{
+	struct wg_resolv_cache *cache = g_new0(struct wg_resolv_cache, 1);
+
+	cache->resolver = resolver ? g_object_ref(resolver)
+	    : g_resolver_get_default();
+	cache->cancellable = g_cancellable_new();
+	cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+					       g_free, free_entry);
+	cache->positive_ttl = (gint64) positive_ttl * G_USEC_PER_SEC;
+	cache->negative_ttl = (gint64) negative_ttl * G_USEC_PER_SEC;
+
+	return cache;
+}
+
+/* The cache shared by everything in this process */
+struct wg_resolv_cache *wg_resolv_cache_get_default(void)
+{
+	if (default_cache == NULL)
+		default_cache = wg_resolv_cache_new(NULL,
+						    WG_RESOLV_POSITIVE_TTL,
+						    WG_RESOLV_NEGATIVE_TTL);
+
+	return default_cache;
+}
+
+void wg_resolv_cache_free(struct wg_resolv_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	/* Lookups still in flight only free their own state when cancelled */
+	g_cancellable_cancel(cache->cancellable);
+	g_object_unref(cache->cancellable);
+	g_object_unref(cache->resolver);
+	g_hash_table_destroy(cache->entries);
+
+	if (cache == default_cache)
+		default_cache = NULL;
+
+	g_free(cache);
+}
+
+static void lookup_done_cb(GObject * src, GAsyncResult * res, gpointer data)
+{
+	struct resolv_lookup *lookup = data;
+	struct wg_resolv_cache *cache;
+	struct resolv_entry *entry;
+	GInetAddress *addr = NULL;
+	GSList *waiters, *iter;
+	GError *error = NULL;
+	GList *addrs;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_RESOLVER);
+
+	addrs = g_resolver_lookup_by_name_finish(G_RESOLVER(src), res, &error);
+
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The cache is gone, don't touch it */
+		g_error_free(error);
+		goto out;
+	}
+
+	cache = lookup->cache;
+	entry = g_hash_table_lookup(cache->entries, lookup->host);
+
+	if (addrs != NULL) {
+		addr = g_object_ref(addrs->data);
+		g_resolver_free_addresses(addrs);
+	} else {
+		g_warning("Unable to resolve %s: %s", lookup->host,
+			  error ? error->message : "no addresses");
+		cache->stats.failures++;
+	}
+
+	if (error)
+		g_error_free(error);
+
+	if (entry == NULL) {
+		if (addr)
+			g_object_unref(addr);
+		goto out;
+	}
+
+	if (entry->addr)
+		g_object_unref(entry->addr);
+
+	entry->addr = addr ? g_object_ref(addr) : NULL;
+	entry->expires = g_get_monotonic_time() +
+	    (addr ? cache->positive_ttl : cache->negative_ttl);
+	entry->pending = FALSE;
+
+	/* Callbacks may re-enter the cache, so detach the waiters first */
+	waiters = g_slist_reverse(entry->waiters);
+	entry->waiters = NULL;
+
+	for (iter = waiters; iter; iter = iter->next) {
+		struct resolv_waiter *w = iter->data;
+		w->cb(lookup->host, addr, w->data);
+		g_free(w);
+	}
+	g_slist_free(waiters);
+
+	if (addr)
+		g_object_unref(addr);
+
+ out:
+	g_free(lookup->host);
+	g_free(lookup);
+	wakeup_end(&w);
+}
+
+/*
+ * Resolve host, calling cb with the result. Fresh cache entries are
+ * answered right away; otherwise cb runs from the main loop once the
+ * lookup finishes. Concurrent requests for one name share a lookup.
+ */
+void wg_resolv_cache_resolve(struct wg_resolv_cache *cache,
+			     const gchar * host, wg_resolve_cb cb,
+			     gpointer data)
+{
+	struct resolv_entry *entry;
+	struct resolv_lookup *lookup;
+
+	entry = g_hash_table_lookup(cache->entries, host);
+
+	if (entry && !entry->pending
+	    && entry->expires > g_get_monotonic_time()) {
+		cache->stats.hits++;
+		if (cb)
+			cb(host, entry->addr, data);
+		return;
+	}
+
+	if (entry == NULL) {
+		entry = g_new0(struct resolv_entry, 1);
+		g_hash_table_insert(cache->entries, g_strdup(host), entry);
+	}
+
+	if (cb) {
+		struct resolv_waiter *w = g_new0(struct resolv_waiter, 1);
+		w->cb = cb;
+		w->data = data;
+		entry->waiters = g_slist_prepend(entry->waiters, w);
+	}
+
+	if (entry->pending) {
+		cache->stats.joined++;
+		return;
+	}
+
+	cache->stats.misses++;
+	entry->pending = TRUE;
+
+	lookup = g_new0(struct resolv_lookup, 1);
+	lookup->cache = cache;
+	lookup->host = g_strdup(host);
+
+	g_resolver_lookup_by_name_async(cache->resolver, host,
+					cache->cancellable, lookup_done_cb,
+					lookup);
+}
+
+/* TRUE if there is a fresh entry for host; addr is not referenced */
+gboolean wg_resolv_cache_peek(struct wg_resolv_cache *cache,
+			      const gchar * host, GInetAddress ** addr)
+{
+	struct resolv_entry *entry;
+
+	entry = g_hash_table_lookup(cache->entries, host);
+	if (entry == NULL || entry->pending
+	    || entry->expires <= g_get_monotonic_time())
+		return FALSE;
+
+	if (addr)
+		*addr = entry->addr;
+
+	return TRUE;
+}
+
+/*
+ * The endpoint as a socket address. Hostnames must already be in the
+ * cache (prefetch them when the config is picked), callers that use this
+ * have no time to look them up.
+ */
+gboolean wg_resolv_cache_sockaddr(struct wg_resolv_cache *cache,
+				  const gchar * endpoint,
+				  struct sockaddr_storage *ss, socklen_t * len)
+{
+	struct wg_endpoint ep;
+	GInetAddress *addr = NULL;
+	GSocketAddress *sa;
+	gchar *host;
+	gboolean ok;
+
+	if (wg_parse_endpoint(endpoint, -1, &ep) == WG_ENDPOINT_INVALID)
+		return FALSE;
+
+	host = g_strndup(ep.host, ep.host_len);
+	if (ep.kind == WG_ENDPOINT_HOSTNAME) {
+		if (wg_resolv_cache_peek(cache, host, &addr) && addr)
+			g_object_ref(addr);
+	} else {
+		addr = g_inet_address_new_from_string(host);
+	}
+	g_free(host);
+
+	if (addr == NULL)
+		return FALSE;
+
+	sa = g_inet_socket_address_new(addr, ep.port);
+	*len = g_socket_address_get_native_size(sa);
+	ok = g_socket_address_to_native(sa, ss, sizeof(*ss), NULL);
+
+	g_object_unref(sa);
+	g_object_unref(addr);
+	return ok;
+}
+
+/*
+ * Start lookups for the hostnames of all given endpoints at once, so they
+ * run in parallel. Returns the number of lookups that were started.
+ */
+guint wg_resolv_cache_prefetch(struct wg_resolv_cache *cache,
+			       const gchar * const *endpoints)
+{
+	struct wg_endpoint ep;
+	guint started = 0, misses;
+	gchar *host;
+
+	for (; endpoints && *endpoints; endpoints++) {
+		if (wg_parse_endpoint(*endpoints, -1, &ep) !=
+		    WG_ENDPOINT_HOSTNAME)
+			continue;
+
+		host = g_strndup(ep.host, ep.host_len);
+		misses = cache->stats.misses;
+		wg_resolv_cache_resolve(cache, host, NULL, NULL);
+		if (cache->stats.misses != misses)
+			started++;
+		g_free(host);
+	}
+
+	return started;
+}
+
+/* Forget all answers, e.g. when the underlying network changed */
+void wg_resolv_cache_expire(struct wg_resolv_cache *cache)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, cache->entries);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		((struct resolv_entry *)value)->expires = 0;
+}
+
+const struct wg_resolv_stats *wg_resolv_cache_get_stats(struct wg_resolv_cache
+							*cache)
+{
+	return &cache->stats;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __RESOLVCACHE_H__
+#define __RESOLVCACHE_H__
+
+#include <sys/socket.h>
+
+#include <gio/gio.h>
+
+/* Seconds a successful and a failed lookup stay in the cache */
+#define WG_RESOLV_POSITIVE_TTL 300
+#define WG_RESOLV_NEGATIVE_TTL 30
+
+/* addr is NULL when the name could not be resolved */
+typedef void (*wg_resolve_cb)(const gchar * host, GInetAddress * addr,
+			      gpointer data);
+
+struct wg_resolv_stats {
+	guint hits;
+	guint misses;
+	guint failures;
+	guint joined;
+};
+
+struct wg_resolv_cache;
+
+struct wg_resolv_cache *wg_resolv_cache_new(GResolver * resolver,
+					    guint positive_ttl,
+					    guint negative_ttl);
+struct wg_resolv_cache *wg_resolv_cache_get_default(void);
+void wg_resolv_cache_free(struct wg_resolv_cache *cache);
+
+void wg_resolv_cache_resolve(struct wg_resolv_cache *cache,
+			     const gchar * host, wg_resolve_cb cb,
+			     gpointer data);
+gboolean wg_resolv_cache_peek(struct wg_resolv_cache *cache,
+			      const gchar * host, GInetAddress ** addr);
+gboolean wg_resolv_cache_sockaddr(struct wg_resolv_cache *cache,
+				  const gchar * endpoint,
+				  struct sockaddr_storage *ss, socklen_t * len);
+guint wg_resolv_cache_prefetch(struct wg_resolv_cache *cache,
+			       const gchar * const *endpoints);
+void wg_resolv_cache_expire(struct wg_resolv_cache *cache);
+
+const struct wg_resolv_stats *wg_resolv_cache_get_stats(struct wg_resolv_cache
+							*cache);
+
+#endif
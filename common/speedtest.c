@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "speedtest.h"
+#include "wakeups.h"
+
+/* Calls per wakeup, so a fast link can't starve the main loop */
+#define SPEEDTEST_BATCH 16
+
+
+enum phase {
+	PHASE_DOWN = 0,
+	PHASE_UP,
+};
+
+struct wg_speedtest {
+	struct sockaddr_storage dst;
+	socklen_t len;
+	guint16 ports[2];
+	guint seconds;
+
+	enum phase phase;
+	int fd;
+	guint watch;
+	guint timeout;
+	gboolean connected;
+	gint64 start;
+	guint64 bytes;
+
+	/* What is sent, and where a short send left off */
+	guint8 *buf;
+	gsize offset;
+	gboolean zerocopy;
+	gboolean no_trunc;
+
+	gint64 wall_start;
+	gint64 cpu_start;
+	struct wg_speedtest_result result;
+	wg_speedtest_cb cb;
+	gpointer data;
+};
+
+static void start_phase(struct wg_speedtest *st, enum phase phase);
+
+/* The RFC 864 chargen pattern, starting at the first line */
+void wg_speedtest_pattern(guint8 * buf, gsize len)
+{
+	gsize i, col;
+
+	for (i = 0; i < len; i++) {
+		col = i % WG_SPEEDTEST_LINE;
+		if (col == WG_SPEEDTEST_LINE - 2)
+			buf[i] = '\r';
+		else if (col == WG_SPEEDTEST_LINE - 1)
+			buf[i] = '\n';
+		else
+			buf[i] = ' ' + (i / WG_SPEEDTEST_LINE + col) % 95;
+	}
+}
+
+static gint64 cpu_time(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return 0;
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * G_USEC_PER_SEC
+	    + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static gdouble mbps(guint64 bytes, gint64 us)
+{
+	/* Bits per microsecond are Mbit/s */
+	return us > 0 ? bytes * 8.0 / us : 0.0;
+}
+
+static void stop_io(struct wg_speedtest *st)
+{
+	if (st->watch)
+		g_source_remove(st->watch);
+	if (st->timeout)
+		g_source_remove(st->timeout);
+	st->watch = 0;
+	st->timeout = 0;
+
+	if (st->fd >= 0)
+		close(st->fd);
+	st->fd = -1;
+}
+
+static void speedtest_free(struct wg_speedtest *st)
+{
+	stop_io(st);
+	g_free(st->buf);
+	g_free(st);
+}
+
+static void finish(struct wg_speedtest *st)
+{
+	gint64 wall = g_get_monotonic_time() - st->wall_start;
+
+	stop_io(st);
+
+	if (wall > 0)
+		st->result.cpu_percent =
+		    100.0 * (cpu_time() - st->cpu_start) / wall;
+
+	st->cb(&st->result, st->data);
+	speedtest_free(st);
+}
+
+static void end_phase(struct wg_speedtest *st)
+{
+	gint64 us = g_get_monotonic_time() - st->start;
+	int queued;
+
+	if (st->connected && st->phase == PHASE_UP) {
+		/* Still in the socket buffer is not through the tunnel yet */
+		if (ioctl(st->fd, SIOCOUTQ, &queued) == 0 && queued > 0)
+			st->bytes -= MIN(st->bytes, (guint64) queued);
+
+		st->result.up_bytes = st->bytes;
+		st->result.up_mbps = mbps(st->bytes, us);
+	} else if (st->connected) {
+		st->result.down_bytes = st->bytes;
+		st->result.down_mbps = mbps(st->bytes, us);
+	}
+
+	stop_io(st);
+
+	if (st->phase == PHASE_DOWN)
+		start_phase(st, PHASE_UP);
+	else
+		finish(st);
+}
+
+/* One direction failing still leaves the other one to measure */
+static void phase_failed(struct wg_speedtest *st, int error)
+{
+	if (st->result.error == 0)
+		st->result.error = error;
+
+	st->connected = FALSE;
+	end_phase(st);
+}
+
+static gboolean phase_timeout_cb(gpointer data)
+{
+	struct wg_speedtest *st = data;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	st->timeout = 0;
+	end_phase(st);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+/*
+ * Read what chargen sends. MSG_TRUNC has TCP drop the data instead of
+ * copying it out, where the kernel supports that. FALSE once the
+ * phase is over.
+ */
+static gboolean receive(struct wg_speedtest *st)
+{
+	gssize n;
+	guint i;
+
+	for (i = 0; i < SPEEDTEST_BATCH; i++) {
+		n = recv(st->fd, st->buf, WG_SPEEDTEST_CHUNK,
+			 st->no_trunc ? 0 : MSG_TRUNC);
+		if (n > 0) {
+			st->bytes += n;
+			continue;
+		}
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return TRUE;
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EINVAL && !st->no_trunc) {
+			st->no_trunc = TRUE;
+			continue;
+		}
+
+		/* Closed early; what came until then still counts */
+		st->watch = 0;
+		if (n < 0 && st->result.error == 0)
+			st->result.error = -errno;
+		end_phase(st);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean read_cb(GIOChannel * source, GIOCondition cond,
+			gpointer data)
+{
+	struct wakeup w;
+	gboolean ret;
+
+	(void)source;
+	(void)cond;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	ret = receive(data);
+	wakeup_end(&w);
+
+	return ret;
+}
+
+/*
+ * The pattern sent never changes, so zerocopy completions only have to
+ * be drained; the buffer is never waited for. The kernel falls back to
+ * copying by itself where it can't do without, e.g. over loopback.
+ */
+static gboolean enable_zerocopy(int fd)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+	int on = 1;
+
+	return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+#else
+	(void)fd;
+	return FALSE;
+#endif
+}
+
+static int send_flags(struct wg_speedtest *st)
+{
+#ifdef MSG_ZEROCOPY
+	if (st->zerocopy)
+		return MSG_NOSIGNAL | MSG_ZEROCOPY;
+#endif
+	return MSG_NOSIGNAL;
+}
+
+/* Zerocopy completions queue up on the socket until they are read */
+static void drain_completions(int fd)
+{
+	guint8 control[128];
+	struct msghdr msg;
+
+	do {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+	} while (recvmsg(fd, &msg, MSG_ERRQUEUE) >= 0);
+}
+
+/* FALSE once the phase is over */
+static gboolean transmit(struct wg_speedtest *st, GIOCondition cond)
+{
+	gssize n;
+	guint i;
+
+	if (st->zerocopy && (cond & G_IO_ERR))
+		drain_completions(st->fd);
+
+	for (i = 0; i < SPEEDTEST_BATCH; i++) {
+		n = send(st->fd, st->buf + st->offset,
+			 WG_SPEEDTEST_CHUNK - st->offset, send_flags(st));
+		if (n > 0) {
+			st->bytes += n;
+			st->offset = (st->offset + n) % WG_SPEEDTEST_CHUNK;
+			continue;
+		}
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return TRUE;
+		if (n < 0 && errno == EINTR)
+			continue;
+		/* Out of room for completions; plain sends it is */
+		if (n < 0 && errno == ENOBUFS && st->zerocopy) {
+			st->zerocopy = FALSE;
+			continue;
+		}
+
+		st->watch = 0;
+		phase_failed(st, n < 0 ? -errno : -EPIPE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean write_cb(GIOChannel * source, GIOCondition cond,
+			 gpointer data)
+{
+	struct wakeup w;
+	gboolean ret;
+
+	(void)source;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	ret = transmit(data, cond);
+	wakeup_end(&w);
+
+	return ret;
+}
+
+static gboolean connect_timeout_cb(gpointer data)
+{
+	struct wg_speedtest *st = data;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	st->timeout = 0;
+	phase_failed(st, -ETIMEDOUT);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+static gboolean connected_cb(GIOChannel * source, GIOCondition cond,
+			     gpointer data)
+{
+	struct wg_speedtest *st = data;
+	socklen_t len = sizeof(int);
+	int error = 0;
+	GIOChannel *channel;
+	struct wakeup w;
+
+	(void)source;
+	(void)cond;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	st->watch = 0;
+	g_source_remove(st->timeout);
+	st->timeout = 0;
+
+	if (getsockopt(st->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+		error = errno;
+	if (error) {
+		phase_failed(st, -error);
+		wakeup_end(&w);
+		return FALSE;
+	}
+
+	st->connected = TRUE;
+	st->start = g_get_monotonic_time();
+
+	channel = g_io_channel_unix_new(st->fd);
+	if (st->phase == PHASE_DOWN) {
+		st->watch = g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+					   read_cb, st);
+	} else {
+		st->zerocopy = enable_zerocopy(st->fd);
+		st->watch = g_io_add_watch(channel,
+					   G_IO_OUT | G_IO_HUP | G_IO_ERR,
+					   write_cb, st);
+	}
+	g_io_channel_unref(channel);
+
+	st->timeout = g_timeout_add_seconds(st->seconds, phase_timeout_cb, st);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+static void start_phase(struct wg_speedtest *st, enum phase phase)
+{
+	struct sockaddr_storage dst = st->dst;
+	int size = WG_SPEEDTEST_SOCKBUF;
+	GIOChannel *channel;
+
+	st->phase = phase;
+	st->connected = FALSE;
+	st->bytes = 0;
+	st->offset = 0;
+
+	if (dst.ss_family == AF_INET6)
+		((struct sockaddr_in6 *)&dst)->sin6_port =
+		    htons(st->ports[phase]);
+	else
+		((struct sockaddr_in *)&dst)->sin_port = htons(st->ports[phase]);
+
+	st->fd = socket(dst.ss_family,
+			SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (st->fd < 0) {
+		phase_failed(st, -errno);
+		return;
+	}
+
+	/* Large buffers keep a long fat tunnel busy; failing is harmless */
+	setsockopt(st->fd, SOL_SOCKET,
+		   phase == PHASE_DOWN ? SO_RCVBUF : SO_SNDBUF, &size,
+		   sizeof(size));
+
+	if (connect(st->fd, (struct sockaddr *)&dst, st->len) < 0
+	    && errno != EINPROGRESS) {
+		phase_failed(st, -errno);
+		return;
+	}
+
+	channel = g_io_channel_unix_new(st->fd);
+	st->watch = g_io_add_watch(channel, G_IO_OUT | G_IO_HUP | G_IO_ERR,
+				   connected_cb, st);
+	g_io_channel_unref(channel);
+
+	st->timeout = g_timeout_add(WG_SPEEDTEST_CONNECT_TIMEOUT_MS,
+				    connect_timeout_cb, st);
+}
+
+static gboolean begin_cb(gpointer data)
+{
+	struct wg_speedtest *st = data;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_SPEEDTEST);
+	st->timeout = 0;
+	st->wall_start = g_get_monotonic_time();
+	st->cpu_start = cpu_time();
+	start_phase(st, PHASE_DOWN);
+	wakeup_end(&w);
+
+	return FALSE;
+}
+
+/*
+ * Measure download from chargen, then upload to discard, each for the
+ * given number of seconds. dst is the host, its port is not used. cb
+ * gets the result from the main loop, also when all of it failed, and
+ * the test is freed after it returns.
+ */
+struct wg_speedtest *wg_speedtest_start(const struct sockaddr *dst,
+					socklen_t len, guint16 discard_port,
+					guint16 chargen_port, guint seconds,
+					wg_speedtest_cb cb, gpointer data)
+{
+	struct wg_speedtest *st;
+
+	if (len > sizeof(st->dst)
+	    || (dst->sa_family != AF_INET && dst->sa_family != AF_INET6))
+		return NULL;
+
+	st = g_new0(struct wg_speedtest, 1);
+	memcpy(&st->dst, dst, len);
+	st->len = len;
+	st->ports[PHASE_DOWN] = chargen_port;
+	st->ports[PHASE_UP] = discard_port;
+	st->seconds = MAX(seconds, 1);
+	st->fd = -1;
+	st->cb = cb;
+	st->data = data;
+
+	st->buf = g_malloc(WG_SPEEDTEST_CHUNK);
+	wg_speedtest_pattern(st->buf, WG_SPEEDTEST_CHUNK);
+
+	/* Failures are reported through cb, never from in here */
+	st->timeout = g_idle_add(begin_cb, st);
+
+	return st;
+}
+
+void wg_speedtest_cancel(struct wg_speedtest *st)
+{
+	if (st)
+		speedtest_free(st);
+}
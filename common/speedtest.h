@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __SPEEDTEST_H__
+#define __SPEEDTEST_H__
+
+#include <sys/socket.h>
+
+#include <glib.h>
+
+/*
+ * Throughput through the tunnel, measured against the discard (RFC 863)
+ * and chargen (RFC 864) TCP services of a host on the other side: data
+ * is read from chargen for a while, then written to discard.
+ */
+#define WG_SPEEDTEST_DISCARD_PORT 9
+#define WG_SPEEDTEST_CHARGEN_PORT 19
+
+#define WG_SPEEDTEST_SECONDS 5
+#define WG_SPEEDTEST_CONNECT_TIMEOUT_MS 3000
+
+/* chargen lines are 72 characters and CRLF, rotating over 95 of them */
+#define WG_SPEEDTEST_LINE 74
+#define WG_SPEEDTEST_CYCLE (95 * WG_SPEEDTEST_LINE)
+
+/* Bytes moved per call: whole cycles, so repeating it keeps the pattern */
+#define WG_SPEEDTEST_CHUNK (37 * WG_SPEEDTEST_CYCLE)
+/* Asked for as socket buffers, the kernel may give less */
+#define WG_SPEEDTEST_SOCKBUF (1024 * 1024)
+
+struct wg_speedtest_result {
+	guint64 down_bytes;
+	guint64 up_bytes;
+	/* Mbit/s, 0 for a direction that could not be measured */
+	gdouble down_mbps;
+	gdouble up_mbps;
+	/*
+	 * Time the whole process spent on the CPU, in percent of the wall
+	 * time; in the applet that is all of hildon-desktop, not just the
+	 * test. The tunnel's encryption runs in kernel workers, not in it.
+	 */
+	gdouble cpu_percent;
+	/* 0, or the negative errno value of the first thing that failed */
+	int error;
+};
+
+typedef void (*wg_speedtest_cb)(const struct wg_speedtest_result *result,
+				gpointer data);
+
+struct wg_speedtest;
+
+void wg_speedtest_pattern(guint8 * buf, gsize len);
+
+struct wg_speedtest *wg_speedtest_start(const struct sockaddr *dst,
+					socklen_t len, guint16 discard_port,
+					guint16 chargen_port, guint seconds,
+					wg_speedtest_cb cb, gpointer data);
+void wg_speedtest_cancel(struct wg_speedtest *st);
+
+#endif
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <glib.h>
+
+#include "validate.h"
+
+/* Base64 of 32 bytes: 43 characters and one '=' of padding */
+#define WG_KEY_B64_LEN 44
+
+#define HOSTNAME_MAX 253
+#define LABEL_MAX 63
+
+typedef gboolean(*token_fn) (const gchar * s, gssize len, gboolean arg);
+
+static gsize str_len(const gchar * s, gssize len)
+{
+	if (s == NULL)
+		return 0;
+
+	return len < 0 ? strlen(s) : (gsize) len;
+}
+
+static void trim(const gchar ** s, gsize * len)
+{
+	while (*len > 0 && g_ascii_isspace((*s)[0])) {
+		(*s)++;
+		(*len)--;
+	}
+
+	while (*len > 0 && g_ascii_isspace((*s)[*len - 1]))
+		(*len)--;
+}
+
+static gboolean tok_eq(const gchar * s, gsize len, const gchar * lit)
+{
+	return strlen(lit) == len && !g_ascii_strncasecmp(s, lit, len);
+}
+
+static gboolean parse_uint(const gchar * s, gsize len, guint max, guint * out)
+{
+	guint v = 0;
+	gsize i;
+
+	/* Five digits is enough for anything we parse (ports, prefixes) */
+	if (len == 0 || len > 5)
+		return FALSE;
+
+	for (i = 0; i < len; i++) {
+		if (!g_ascii_isdigit(s[i]))
+			return FALSE;
+		v = v * 10 + (guint) (s[i] - '0');
+	}
+
+	if (v > max)
+		return FALSE;
+
+	if (out)
+		*out = v;
+
+	return TRUE;
+}
+
+/*
+ * Walk a comma separated list once, handing each element to fn. Empty
+ * elements (",,", trailing commas) are passed on as well, so they end up
+ * being rejected by the element validator.
+ */
+static gint validate_list(const gchar * s, gssize len, token_fn fn,
+			  gboolean arg)
+{
+	const gchar *tok, *sep, *end;
+	gint n = 0;
+
+	if (s == NULL)
+		return -1;
+
+	end = s + str_len(s, len);
+
+	for (tok = s;; tok = sep + 1) {
+		sep = memchr(tok, ',', end - tok);
+		if (sep == NULL)
+			sep = end;
+
+		if (!fn(tok, sep - tok, arg))
+			return -1;
+
+		n++;
+
+		if (sep == end)
+			return n;
+	}
+}
+
+gboolean wg_validate_key(const gchar * s, gssize len)
+{
+	/* The last character only carries 4 bits, the rest is padding */
+	static const gchar last[] = "AEIMQUYcgkosw048";
+	gsize n = str_len(s, len), i;
+
+	if (n != WG_KEY_B64_LEN || s[WG_KEY_B64_LEN - 1] != '=')
+		return FALSE;
+
+	for (i = 0; i < WG_KEY_B64_LEN - 2; i++) {
+		if (!g_ascii_isalnum(s[i]) && s[i] != '+' && s[i] != '/')
+			return FALSE;
+	}
+
+	return memchr(last, s[WG_KEY_B64_LEN - 2], sizeof(last) - 1) != NULL;
+}
+
+gboolean wg_validate_ip(const gchar * s, gssize len, gint * family)
+{
+	gchar buf[INET6_ADDRSTRLEN];
+	guchar addr[sizeof(struct in6_addr)];
+	gsize n = str_len(s, len);
+	gint af;
+
+	trim(&s, &n);
+
+	if (n == 0 || n >= sizeof(buf))
+		return FALSE;
+
+	/* inet_pton() wants a terminated string, so use a stack copy */
+	memcpy(buf, s, n);
+	buf[n] = '\0';
+
+	af = memchr(buf, ':', n) ? AF_INET6 : AF_INET;
+
+	if (inet_pton(af, buf, addr) != 1)
+		return FALSE;
+
+	if (family)
+		*family = af;
+
+	return TRUE;
+}
+
+gboolean wg_validate_cidr(const gchar * s, gssize len, gboolean need_prefix)
+{
+	gsize n = str_len(s, len);
+	const gchar *slash;
+	gint family;
+
+	trim(&s, &n);
+
+	slash = memchr(s, '/', n);
+	if (slash == NULL)
+		return !need_prefix && wg_validate_ip(s, n, NULL);
+
+	if (!wg_validate_ip(s, slash - s, &family))
+		return FALSE;
+
+	return parse_uint(slash + 1, n - (slash - s) - 1,
+			  family == AF_INET6 ? 128 : 32, NULL);
+}
+
+gint wg_validate_cidr_list(const gchar * s, gssize len, gboolean need_prefix)
+{
+	return validate_list(s, len, wg_validate_cidr, need_prefix);
+}
+
+static gboolean validate_ip_token(const gchar * s, gssize len, gboolean arg)
+{
+	(void)arg;
+	return wg_validate_ip(s, len, NULL);
+}
+
+gint wg_validate_ip_list(const gchar * s, gssize len)
+{
+	return validate_list(s, len, validate_ip_token, FALSE);
+}
+
+gboolean wg_validate_port(const gchar * s, gssize len, guint16 * port)
+{
+	gsize n = str_len(s, len);
+	guint v;
+
+	trim(&s, &n);
+
+	if (!parse_uint(s, n, 65535, &v) || v == 0)
+		return FALSE;
+
+	if (port)
+		*port = (guint16) v;
+
+	return TRUE;
+}
+
+static gboolean validate_hostname(const gchar * s, gsize len)
+{
+	gsize i, label = 0;
+	gboolean numeric = TRUE;
+
+	/* A single trailing dot marks a fully qualified name */
+	if (len > 0 && s[len - 1] == '.')
+		len--;
+
+	if (len == 0 || len > HOSTNAME_MAX)
+		return FALSE;
+
+	for (i = 0; i < len; i++) {
+		if (s[i] == '.') {
+			if (label == 0 || s[i - 1] == '-')
+				return FALSE;
+			label = 0;
+			numeric = TRUE;
+			continue;
+		}
+
+		if (!g_ascii_isalnum(s[i]) && s[i] != '-')
+			return FALSE;
+
+		if (s[i] == '-' && label == 0)
+			return FALSE;
+
+		if (!g_ascii_isdigit(s[i]))
+			numeric = FALSE;
+
+		if (++label > LABEL_MAX)
+			return FALSE;
+	}
+
+	/* Something like 10.0.0.256 is a broken address, not a name */
+	return s[len - 1] != '-' && !numeric;
+}
+
+enum wg_endpoint_kind wg_parse_endpoint(const gchar * s, gssize len,
+					struct wg_endpoint *ep)
+{
+	gsize n = str_len(s, len);
+	const gchar *host, *colon;
+	gsize host_len;
+	enum wg_endpoint_kind kind;
+	gint family;
+	guint16 port;
+
+	trim(&s, &n);
+
+	if (n == 0)
+		return WG_ENDPOINT_INVALID;
+
+	if (s[0] == '[') {
+		/* [2001:db8::1]:51820 */
+		const gchar *rb = memchr(s, ']', n);
+
+		if (rb == NULL || rb + 1 == s + n || rb[1] != ':')
+			return WG_ENDPOINT_INVALID;
+
+		host = s + 1;
+		host_len = rb - host;
+		colon = rb + 1;
+
+		if (!wg_validate_ip(host, host_len, &family)
+		    || family != AF_INET6)
+			return WG_ENDPOINT_INVALID;
+
+		kind = WG_ENDPOINT_IPV6;
+	} else {
+		colon = memchr(s, ':', n);
+		if (colon == NULL)
+			return WG_ENDPOINT_INVALID;
+
+		host = s;
+		host_len = colon - s;
+
+		/* A second colon means an IPv6 address without brackets */
+		if (memchr(colon + 1, ':', n - host_len - 1))
+			return WG_ENDPOINT_INVALID;
+
+		if (wg_validate_ip(host, host_len, NULL))
+			kind = WG_ENDPOINT_IPV4;
+		else if (validate_hostname(host, host_len))
+			kind = WG_ENDPOINT_HOSTNAME;
+		else
+			return WG_ENDPOINT_INVALID;
+	}
+
+	if (!wg_validate_port(colon + 1, n - (colon + 1 - s), &port))
+		return WG_ENDPOINT_INVALID;
+
+	if (ep) {
+		ep->kind = kind;
+		ep->host = host;
+		ep->host_len = host_len;
+		ep->port = port;
+	}
+
+	return kind;
+}
+
+static gboolean validate_dns_token(const gchar * s, gssize len, gboolean arg)
+{
+	gsize n = str_len(s, len);
+
+	(void)arg;
+	trim(&s, &n);
+
+	/* wg-quick treats anything that isn't an address as a search domain */
+	return wg_validate_ip(s, n, NULL) || validate_hostname(s, n);
+}
+
+gint wg_validate_dns_list(const gchar * s, gssize len)
+{
+	return validate_list(s, len, validate_dns_token, FALSE);
+}
+
+enum {
+	SECTION_NONE,
+	SECTION_INTERFACE,
+	SECTION_PEER,
+};
+
+static gboolean validate_config_line(gint section, const gchar * key,
+				     gsize key_len, const gchar * val,
+				     gsize val_len)
+{
+	guint v;
+
+	if (section == SECTION_INTERFACE) {
+		if (tok_eq(key, key_len, "PrivateKey"))
+			return wg_validate_key(val, val_len);
+		if (tok_eq(key, key_len, "Address"))
+			return wg_validate_cidr_list(val, val_len, TRUE) > 0;
+		if (tok_eq(key, key_len, "DNS"))
+			return wg_validate_dns_list(val, val_len) > 0;
+		if (tok_eq(key, key_len, "ListenPort"))
+			return wg_validate_port(val, val_len, NULL);
+		if (tok_eq(key, key_len, "MTU"))
+			return parse_uint(val, val_len, 65535, NULL);
+
+		/* Handled by wg-quick, nothing for us to check */
+		return tok_eq(key, key_len, "FwMark")
+		    || tok_eq(key, key_len, "Table")
+		    || tok_eq(key, key_len, "SaveConfig")
+		    || tok_eq(key, key_len, "PreUp")
+		    || tok_eq(key, key_len, "PostUp")
+		    || tok_eq(key, key_len, "PreDown")
+		    || tok_eq(key, key_len, "PostDown");
+	}
+
+	if (section == SECTION_PEER) {
+		if (tok_eq(key, key_len, "PublicKey")
+		    || tok_eq(key, key_len, "PresharedKey"))
+			return wg_validate_key(val, val_len);
+		if (tok_eq(key, key_len, "Endpoint"))
+			return wg_parse_endpoint(val, val_len, NULL)
+			    != WG_ENDPOINT_INVALID;
+		if (tok_eq(key, key_len, "AllowedIPs"))
+			return val_len == 0
+			    || wg_validate_cidr_list(val, val_len, FALSE) > 0;
+		if (tok_eq(key, key_len, "PersistentKeepalive"))
+			return tok_eq(val, val_len, "off")
+			    || parse_uint(val, val_len, 65535, &v);
+	}
+
+	return FALSE;
+}
+
+/*
+ * Check a wg-quick style configuration file. On failure, err_line is set
+ * to the offending line (1-based), or to the section header of a section
+ * that is missing its key.
+ */
+gboolean wg_validate_config(const gchar * contents, gsize len,
+			    guint * err_line)
+{
+	const gchar *line, *eol, *end = contents + len;
+	gint section = SECTION_NONE;
+	gboolean has_interface = FALSE, has_key = TRUE;
+	guint lineno = 0, section_line = 0;
+
+	for (line = contents; line < end; line = eol + (eol < end)) {
+		const gchar *eq, *hash;
+		gsize n;
+
+		lineno++;
+
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+
+		n = eol - line;
+		if ((hash = memchr(line, '#', n)) != NULL)
+			n = hash - line;
+
+		trim(&line, &n);
+		if (n == 0)
+			continue;
+
+		if (line[0] == '[') {
+			/* The previous section must have had its key */
+			if (!has_key) {
+				lineno = section_line;
+				goto invalid;
+			}
+
+			if (tok_eq(line, n, "[Interface]") && !has_interface) {
+				section = SECTION_INTERFACE;
+				has_interface = TRUE;
+			} else if (tok_eq(line, n, "[Peer]")) {
+				section = SECTION_PEER;
+			} else {
+				goto invalid;
+			}
+
+			has_key = FALSE;
+			section_line = lineno;
+			continue;
+		}
+
+		if ((eq = memchr(line, '=', n)) == NULL)
+			goto invalid;
+
+		{
+			const gchar *key = line, *val = eq + 1;
+			gsize key_len = eq - line, val_len = n - key_len - 1;
+
+			trim(&key, &key_len);
+			trim(&val, &val_len);
+
+			if (!validate_config_line(section, key, key_len, val,
+						  val_len))
+				goto invalid;
+
+			if (tok_eq(key, key_len, section == SECTION_PEER ?
+				   "PublicKey" : "PrivateKey"))
+				has_key = TRUE;
+		}
+	}
+
+	if (has_interface && has_key)
+		return TRUE;
+
+	lineno = has_interface ? section_line : lineno;
+
+ invalid:
+	if (err_line)
+		*err_line = lineno;
+
+	return FALSE;
+}
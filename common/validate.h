@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __VALIDATE_H__
+#define __VALIDATE_H__
+
+#include <glib.h>
+
+/*
+ * None of the functions below allocate. Strings are passed as a pointer
+ * and a length (-1 meaning NUL-terminated), so they can be run directly
+ * on entry text or on a line inside a loaded configuration file.
+ */
+
+enum wg_endpoint_kind {
+	WG_ENDPOINT_INVALID = 0,
+	WG_ENDPOINT_IPV4,
+	WG_ENDPOINT_IPV6,
+	WG_ENDPOINT_HOSTNAME,
+};
+
+struct wg_endpoint {
+	enum wg_endpoint_kind kind;
+	/* Points into the validated string, without brackets */
+	const gchar *host;
+	gsize host_len;
+	guint16 port;
+};
+
+gboolean wg_validate_key(const gchar * s, gssize len);
+gboolean wg_validate_ip(const gchar * s, gssize len, gint * family);
+gboolean wg_validate_cidr(const gchar * s, gssize len, gboolean need_prefix);
+gint wg_validate_cidr_list(const gchar * s, gssize len, gboolean need_prefix);
+gint wg_validate_ip_list(const gchar * s, gssize len);
+gint wg_validate_dns_list(const gchar * s, gssize len);
+gboolean wg_validate_port(const gchar * s, gssize len, guint16 * port);
+enum wg_endpoint_kind wg_parse_endpoint(const gchar * s, gssize len,
+					struct wg_endpoint *ep);
+
+gboolean wg_validate_config(const gchar * contents, gsize len,
+			    guint * err_line);
+
+#endif
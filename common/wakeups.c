@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "wakeups.h"
+
+struct wakeup_stats {
+	guint count;
+	gint64 cpu_us;
+	gint64 max_cpu_us;
+};
+
+static const gchar *source_names[N_WAKEUP_SOURCES] = {
+	"startup", "blink", "dbus-filter", "dbus-reply", "status-frame",
+	"icon-theme", "stats", "history", "recovery", "resolver", "prober",
+	"mtu-probe", "speedtest", "prewarm",
+};
+
+static struct wakeup_stats stats[N_WAKEUP_SOURCES];
+static gint64 first_wakeup;
+static wakeup_clock clock_us = g_get_monotonic_time;
+
+static gint64 thread_cpu_us(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1)
+		return 0;
+
+	return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+void wakeup_begin(struct wakeup *w, enum wakeup_source source)
+{
+	if (first_wakeup == 0)
+		first_wakeup = clock_us();
+
+	w->source = source;
+	w->cpu_start = thread_cpu_us();
+}
+
+void wakeup_end(struct wakeup *w)
+{
+	struct wakeup_stats *st = &stats[w->source];
+	gint64 used = thread_cpu_us() - w->cpu_start;
+
+	st->count++;
+	st->cpu_us += used;
+	if (used > st->max_cpu_us)
+		st->max_cpu_us = used;
+}
+
+guint wakeup_total(void)
+{
+	guint i, total = 0;
+
+	for (i = 0; i < N_WAKEUP_SOURCES; i++)
+		total += stats[i].count;
+
+	return total;
+}
+
+/*
+ * Compare the average rate since the first wakeup with the budget from
+ * the environment. Without a budget, nothing is ever over it.
+ */
+gboolean wakeup_over_budget(void)
+{
+	const gchar *env = g_getenv(WAKEUP_BUDGET_ENV);
+	gint64 elapsed, budget;
+
+	if (env == NULL || first_wakeup == 0)
+		return FALSE;
+
+	budget = g_ascii_strtoll(env, NULL, 10);
+	if (budget <= 0)
+		return FALSE;
+
+	/* Don't extrapolate from the first minute, startup is busy */
+	elapsed = clock_us() - first_wakeup;
+	if (elapsed < 60 * G_USEC_PER_SEC)
+		return FALSE;
+
+	return (gint64) wakeup_total() * 3600 * G_USEC_PER_SEC >
+	    budget * elapsed;
+}
+
+gchar *wakeup_dump(void)
+{
+	GString *str = g_string_new("wakeups:");
+	gint64 elapsed = 0;
+	guint i;
+
+	if (first_wakeup)
+		elapsed = clock_us() - first_wakeup;
+
+	g_string_append_printf(str, " total=%u in %" G_GINT64_FORMAT "s",
+			       wakeup_total(), elapsed / G_USEC_PER_SEC);
+
+	for (i = 0; i < N_WAKEUP_SOURCES; i++)
+		g_string_append_printf(str, " %s=%u/%" G_GINT64_FORMAT
+				       "us(max %" G_GINT64_FORMAT "us)",
+				       source_names[i], stats[i].count,
+				       stats[i].cpu_us, stats[i].max_cpu_us);
+
+	if (wakeup_over_budget())
+		g_string_append(str, " OVER BUDGET");
+
+	return g_string_free(str, FALSE);
+}
+
+void wakeup_set_clock(wakeup_clock clock)
+{
+	clock_us = clock ? clock : g_get_monotonic_time;
+}
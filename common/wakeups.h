@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __WAKEUPS_H__
+#define __WAKEUPS_H__
+
+#include <glib.h>
+
+/* Environment variable with the allowed number of wakeups per hour */
+#define WAKEUP_BUDGET_ENV "WG_APPLET_WAKEUP_BUDGET"
+
+/*
+ * Every kind of main loop dispatch that ends up in our code. There are no
+ * gconf notifications among them, gconf is only read when needed.
+ */
+enum wakeup_source {
+	WAKEUP_STARTUP = 0,
+	WAKEUP_BLINK,
+	WAKEUP_DBUS_FILTER,
+	WAKEUP_DBUS_REPLY,
+	WAKEUP_STATUS_FRAME,
+	WAKEUP_ICON_THEME,
+	WAKEUP_STATS,
+	WAKEUP_HISTORY,
+	WAKEUP_RECOVERY,
+	WAKEUP_RESOLVER,
+	WAKEUP_PROBER,
+	WAKEUP_MTU_PROBE,
+	WAKEUP_SPEEDTEST,
+	WAKEUP_PREWARM,
+	N_WAKEUP_SOURCES
+};
+
+typedef gint64 (*wakeup_clock)(void);
+
+struct wakeup {
+	enum wakeup_source source;
+	gint64 cpu_start;
+};
+
+void wakeup_begin(struct wakeup *w, enum wakeup_source source);
+void wakeup_end(struct wakeup *w);
+
+guint wakeup_total(void);
+gboolean wakeup_over_budget(void);
+gchar *wakeup_dump(void);
+
+/* Where the time comes from, NULL for the monotonic clock */
+void wakeup_set_clock(wakeup_clock clock);
+
+#endif
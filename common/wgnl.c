@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include "wgnl.h"
+
+/* Large enough for any single message the kernel sends in a dump */
+#define WG_NL_BUF_SIZE 32768
+
+struct wg_nl {
+	int fd;
+	guint32 seq;
+	guint16 family;
+	/* Requests are built here and replies received into it */
+	guint8 *buf;
+};
+
+/* Called for every reply message belonging to a request */
+typedef int (*wg_nl_msg_cb)(const struct nlmsghdr * nlh, gpointer data);
+
+#define ATTR_TYPE(a) ((a)->nla_type & NLA_TYPE_MASK)
+#define ATTR_DATA(a) ((void *)((guint8 *)(a) + NLA_HDRLEN))
+#define ATTR_LEN(a) ((gsize)(a)->nla_len - NLA_HDRLEN)
+
+#define attr_for_each(a, head, len, rem) \
+	for (a = (head), rem = (len); attr_ok(a, rem); \
+	     rem -= NLA_ALIGN(a->nla_len), \
+	     a = (struct nlattr *)((guint8 *)a + NLA_ALIGN(a->nla_len)))
+
+static gboolean attr_ok(const struct nlattr *a, gssize rem)
+{
+	return rem >= (gssize) sizeof(*a) && a->nla_len >= sizeof(*a)
+	    && a->nla_len <= rem;
+}
+
+static guint16 attr_u16(const struct nlattr *a)
+{
+	guint16 v = 0;
+
+	if (ATTR_LEN(a) >= sizeof(v))
+		memcpy(&v, ATTR_DATA(a), sizeof(v));
+	return v;
+}
+
+static guint32 attr_u32(const struct nlattr *a)
+{
+	guint32 v = 0;
+
+	if (ATTR_LEN(a) >= sizeof(v))
+		memcpy(&v, ATTR_DATA(a), sizeof(v));
+	return v;
+}
+
+static guint64 attr_u64(const struct nlattr *a)
+{
+	guint64 v = 0;
+
+	if (ATTR_LEN(a) >= sizeof(v))
+		memcpy(&v, ATTR_DATA(a), sizeof(v));
+	return v;
+}
+
+static struct nlattr *attr_put(struct nlmsghdr *nlh, guint16 type,
+			       const void *data, gsize len)
+{
+	struct nlattr *a;
+	gsize off = NLMSG_ALIGN(nlh->nlmsg_len);
+
+	if (off + NLA_ALIGN(NLA_HDRLEN + len) > WG_NL_BUF_SIZE)
+		return NULL;
+
+	a = (struct nlattr *)((guint8 *)nlh + off);
+	a->nla_type = type;
+	a->nla_len = NLA_HDRLEN + len;
+	if (len)
+		memcpy(ATTR_DATA(a), data, len);
+
+	nlh->nlmsg_len = off + NLA_ALIGN(a->nla_len);
+	return a;
+}
+
+static struct nlattr *nest_start(struct nlmsghdr *nlh, guint16 type)
+{
+	return attr_put(nlh, type | NLA_F_NESTED, NULL, 0);
+}
+
+static void nest_end(struct nlmsghdr *nlh, struct nlattr *nest)
+{
+	nest->nla_len = (guint8 *)nlh + nlh->nlmsg_len - (guint8 *)nest;
+}
+
+static struct nlmsghdr *msg_start(struct wg_nl *nl, guint16 type,
+				  guint16 flags, guint8 cmd, guint8 version)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)nl->buf;
+	struct genlmsghdr *genl;
+
+	memset(nlh, 0, NLMSG_LENGTH(GENL_HDRLEN));
+	nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_REQUEST | flags;
+
+	genl = NLMSG_DATA(nlh);
+	genl->cmd = cmd;
+	genl->version = version;
+
+	return nlh;
+}
+
+static struct nlattr *msg_attrs(const struct nlmsghdr *nlh, gssize * len)
+{
+	*len = (gssize) nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	return (struct nlattr *)((guint8 *)NLMSG_DATA(nlh) + GENL_HDRLEN);
+}
+
+/*
+ * Send the request built in the buffer and feed the replies to cb until
+ * the kernel is done. Dumps end with NLMSG_DONE, everything else with
+ * the acknowledgement asked for here.
+ */
+static int nl_talk(struct wg_nl *nl, wg_nl_msg_cb cb, gpointer data)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)nl->buf;
+	gboolean dump = nlh->nlmsg_flags & NLM_F_DUMP;
+	guint32 seq = ++nl->seq;
+	int ret = 0;
+	ssize_t len;
+
+	if (!dump)
+		nlh->nlmsg_flags |= NLM_F_ACK;
+	nlh->nlmsg_seq = seq;
+
+	do {
+		len = send(nl->fd, nlh, nlh->nlmsg_len, 0);
+	} while (len < 0 && errno == EINTR);
+
+	if (len < 0)
+		return -errno;
+
+	for (;;) {
+		len = recv(nl->fd, nl->buf, WG_NL_BUF_SIZE, 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (len == 0)
+			return -ECONNRESET;
+
+		for (nlh = (struct nlmsghdr *)nl->buf; NLMSG_OK(nlh, len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_seq != seq)
+				continue;
+
+			if (nlh->nlmsg_type == NLMSG_DONE)
+				return ret;
+
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+				if (err->error || !dump)
+					return err->error ? err->error : ret;
+				continue;
+			}
+
+			/* Keep reading to the end so the socket stays in sync */
+			if (ret == 0 && cb)
+				ret = cb(nlh, data);
+		}
+	}
+}
+
+static int parse_family(const struct nlmsghdr *nlh, gpointer data)
+{
+	guint16 *family = data;
+	struct nlattr *a;
+	gssize len, rem;
+
+	attr_for_each(a, msg_attrs(nlh, &len), len, rem) {
+		if (ATTR_TYPE(a) == CTRL_ATTR_FAMILY_ID)
+			*family = attr_u16(a);
+	}
+
+	return 0;
+}
+
+struct wg_nl *wg_nl_open_fd(int fd, guint16 family)
+{
+	struct wg_nl *nl = g_new0(struct wg_nl, 1);
+
+	nl->fd = fd;
+	nl->family = family;
+	nl->buf = g_malloc(WG_NL_BUF_SIZE);
+
+	return nl;
+}
+
+/* NULL with errno set if there is no netlink or no WireGuard module */
+struct wg_nl *wg_nl_open(void)
+{
+	struct sockaddr_nl addr = {.nl_family = AF_NETLINK };
+	struct nlmsghdr *nlh;
+	struct wg_nl *nl;
+	guint16 family = 0;
+	int fd, ret;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (fd < 0)
+		return NULL;
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		ret = errno;
+		close(fd);
+		errno = ret;
+		return NULL;
+	}
+
+	nl = wg_nl_open_fd(fd, 0);
+
+	nlh = msg_start(nl, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY, 1);
+	attr_put(nlh, CTRL_ATTR_FAMILY_NAME, WG_GENL_NAME,
+		 sizeof(WG_GENL_NAME));
+
+	ret = nl_talk(nl, parse_family, &family);
+	if (ret == 0 && family == 0)
+		ret = -ENOENT;
+
+	if (ret < 0) {
+		wg_nl_close(nl);
+		errno = -ret;
+		return NULL;
+	}
+
+	nl->family = family;
+	return nl;
+}
+
+void wg_nl_close(struct wg_nl *nl)
+{
+	if (nl == NULL)
+		return;
+
+	close(nl->fd);
+	g_free(nl->buf);
+	g_free(nl);
+}
+
+struct dump_state {
+	struct wg_nl_device *dev;
+	struct wg_nl_peer *peer;
+	guint8 last_key[WG_KEY_LEN];
+	gboolean have_last;
+};
+
+static void parse_peer(struct dump_state *st, struct nlattr *head, gssize len)
+{
+	struct wg_nl_device *dev = st->dev;
+	struct wg_nl_peer *peer;
+	struct nlattr *a, *ip;
+	const guint8 *key = NULL;
+	gssize rem, iprem;
+
+	attr_for_each(a, head, len, rem) {
+		if (ATTR_TYPE(a) == WGPEER_A_PUBLIC_KEY
+		    && ATTR_LEN(a) == WG_KEY_LEN)
+			key = ATTR_DATA(a);
+	}
+
+	/*
+	 * Peers with many allowed IPs are split over several messages, and
+	 * each part repeats the key. Those parts are one peer.
+	 */
+	if (key && st->have_last && !memcmp(key, st->last_key, WG_KEY_LEN)) {
+		peer = st->peer;
+	} else {
+		peer = NULL;
+		if (dev->n_peers < dev->max_peers) {
+			peer = &dev->peers[dev->n_peers];
+			memset(peer, 0, sizeof(*peer));
+		}
+		dev->n_peers++;
+
+		st->have_last = key != NULL;
+		if (key)
+			memcpy(st->last_key, key, WG_KEY_LEN);
+	}
+
+	st->peer = peer;
+	if (peer == NULL)
+		return;
+
+	attr_for_each(a, head, len, rem) {
+		switch (ATTR_TYPE(a)) {
+		case WGPEER_A_PUBLIC_KEY:
+			if (ATTR_LEN(a) == WG_KEY_LEN)
+				memcpy(peer->public_key, ATTR_DATA(a),
+				       WG_KEY_LEN);
+			break;
+		case WGPEER_A_ENDPOINT:
+			if (ATTR_LEN(a) <= sizeof(peer->endpoint))
+				memcpy(&peer->endpoint, ATTR_DATA(a),
+				       ATTR_LEN(a));
+			break;
+		case WGPEER_A_LAST_HANDSHAKE_TIME:
+			/* struct __kernel_timespec, seconds come first */
+			peer->last_handshake = (gint64) attr_u64(a);
+			break;
+		case WGPEER_A_RX_BYTES:
+			peer->rx_bytes = attr_u64(a);
+			break;
+		case WGPEER_A_TX_BYTES:
+			peer->tx_bytes = attr_u64(a);
+			break;
+		case WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL:
+			peer->keepalive = attr_u16(a);
+			break;
+		case WGPEER_A_ALLOWEDIPS:
+			attr_for_each(ip, (struct nlattr *)ATTR_DATA(a),
+				      (gssize) ATTR_LEN(a), iprem)
+			    peer->n_allowed_ips++;
+			break;
+		}
+	}
+}
+
+static int parse_device(const struct nlmsghdr *nlh, gpointer data)
+{
+	struct dump_state *st = data;
+	struct wg_nl_device *dev = st->dev;
+	struct nlattr *a, *p;
+	gssize len, rem, prem;
+
+	attr_for_each(a, msg_attrs(nlh, &len), len, rem) {
+		switch (ATTR_TYPE(a)) {
+		case WGDEVICE_A_IFINDEX:
+			dev->ifindex = attr_u32(a);
+			break;
+		case WGDEVICE_A_IFNAME:
+			g_strlcpy(dev->ifname, ATTR_DATA(a),
+				  MIN(sizeof(dev->ifname), ATTR_LEN(a)));
+			break;
+		case WGDEVICE_A_PUBLIC_KEY:
+			if (ATTR_LEN(a) == WG_KEY_LEN)
+				memcpy(dev->public_key, ATTR_DATA(a),
+				       WG_KEY_LEN);
+			break;
+		case WGDEVICE_A_LISTEN_PORT:
+			dev->listen_port = attr_u16(a);
+			break;
+		case WGDEVICE_A_FWMARK:
+			dev->fwmark = attr_u32(a);
+			break;
+		case WGDEVICE_A_PEERS:
+			attr_for_each(p, (struct nlattr *)ATTR_DATA(a),
+				      (gssize) ATTR_LEN(a), prem)
+			    parse_peer(st, ATTR_DATA(p), ATTR_LEN(p));
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Read the state of one interface. Nothing is allocated; peers go into
+ * the array the caller set up in dev.
+ */
+int wg_nl_get_device(struct wg_nl *nl, const gchar * ifname,
+		     struct wg_nl_device *dev)
+{
+	struct dump_state st = {.dev = dev };
+	struct nlmsghdr *nlh;
+
+	dev->ifindex = 0;
+	dev->listen_port = 0;
+	dev->fwmark = 0;
+	dev->n_peers = 0;
+	memset(dev->public_key, 0, sizeof(dev->public_key));
+	g_strlcpy(dev->ifname, ifname, sizeof(dev->ifname));
+
+	nlh = msg_start(nl, nl->family, NLM_F_DUMP, WG_CMD_GET_DEVICE,
+			WG_GENL_VERSION);
+	if (!attr_put(nlh, WGDEVICE_A_IFNAME, ifname, strlen(ifname) + 1))
+		return -EINVAL;
+
+	return nl_talk(nl, parse_device, &st);
+}
+
+static gboolean put_peer(struct nlmsghdr *nlh,
+			 const struct wg_nl_peer_config *peer)
+{
+	const struct wg_nl_allowedip *ip;
+	struct nlattr *nest, *ips, *ipnest;
+	guint16 keepalive;
+	guint i;
+
+	if (!(nest = nest_start(nlh, 0)))
+		return FALSE;
+
+	if (!attr_put(nlh, WGPEER_A_PUBLIC_KEY, peer->public_key, WG_KEY_LEN))
+		return FALSE;
+
+	if (peer->flags
+	    && !attr_put(nlh, WGPEER_A_FLAGS, &peer->flags,
+			 sizeof(peer->flags)))
+		return FALSE;
+
+	if (peer->preshared_key
+	    && !attr_put(nlh, WGPEER_A_PRESHARED_KEY, peer->preshared_key,
+			 WG_KEY_LEN))
+		return FALSE;
+
+	if (peer->endpoint
+	    && !attr_put(nlh, WGPEER_A_ENDPOINT, peer->endpoint,
+			 peer->endpoint_len))
+		return FALSE;
+
+	if (peer->keepalive >= 0) {
+		keepalive = peer->keepalive;
+		if (!attr_put(nlh, WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL,
+			      &keepalive, sizeof(keepalive)))
+			return FALSE;
+	}
+
+	if (peer->n_allowed_ips) {
+		if (!(ips = nest_start(nlh, WGPEER_A_ALLOWEDIPS)))
+			return FALSE;
+
+		for (i = 0; i < peer->n_allowed_ips; i++) {
+			ip = &peer->allowed_ips[i];
+
+			if (!(ipnest = nest_start(nlh, 0))
+			    || !attr_put(nlh, WGALLOWEDIP_A_FAMILY,
+					 &ip->family, sizeof(ip->family))
+			    || !attr_put(nlh, WGALLOWEDIP_A_IPADDR, &ip->addr,
+					 ip->family == AF_INET6 ?
+					 sizeof(ip->addr.ip6) :
+					 sizeof(ip->addr.ip4))
+			    || !attr_put(nlh, WGALLOWEDIP_A_CIDR_MASK,
+					 &ip->cidr, sizeof(ip->cidr)))
+				return FALSE;
+
+			nest_end(nlh, ipnest);
+		}
+
+		nest_end(nlh, ips);
+	}
+
+	nest_end(nlh, nest);
+	return TRUE;
+}
+
+static struct nlattr *start_set_device(struct wg_nl *nl, const gchar * ifname,
+				       guint32 device_flags)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = msg_start(nl, nl->family, 0, WG_CMD_SET_DEVICE, WG_GENL_VERSION);
+
+	if (!attr_put(nlh, WGDEVICE_A_IFNAME, ifname, strlen(ifname) + 1))
+		return NULL;
+
+	if (device_flags
+	    && !attr_put(nlh, WGDEVICE_A_FLAGS, &device_flags,
+			 sizeof(device_flags)))
+		return NULL;
+
+	return nest_start(nlh, WGDEVICE_A_PEERS);
+}
+
+/*
+ * Change the peers of an interface. Peers that don't fit into one
+ * message are sent in further ones; device_flags (WGDEVICE_F_*) only go
+ * with the first, so WGDEVICE_F_REPLACE_PEERS doesn't undo earlier parts.
+ */
+int wg_nl_set_device(struct wg_nl *nl, const gchar * ifname,
+		     guint32 device_flags,
+		     const struct wg_nl_peer_config *peers, guint n_peers)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)nl->buf;
+	struct nlattr *nest;
+	guint32 len;
+	guint i = 0, in_msg = 0;
+	int ret;
+
+	if (!(nest = start_set_device(nl, ifname, device_flags)))
+		return -EINVAL;
+
+	while (i < n_peers) {
+		len = nlh->nlmsg_len;
+
+		if (put_peer(nlh, &peers[i])) {
+			i++;
+			in_msg++;
+			continue;
+		}
+
+		/* Doesn't fit, send what we have and start over */
+		nlh->nlmsg_len = len;
+		if (in_msg == 0)
+			return -EMSGSIZE;
+
+		nest_end(nlh, nest);
+		if ((ret = nl_talk(nl, NULL, NULL)) < 0)
+			return ret;
+
+		if (!(nest = start_set_device(nl, ifname, 0)))
+			return -EINVAL;
+		in_msg = 0;
+	}
+
+	nest_end(nlh, nest);
+	return nl_talk(nl, NULL, NULL);
+}
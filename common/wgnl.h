@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __WGNL_H__
+#define __WGNL_H__
+
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/wireguard.h>
+
+#include <glib.h>
+
+/*
+ * A small client for the kernel's "wireguard" generic netlink family.
+ * Functions returning int give 0 on success and a negative errno value
+ * on failure.
+ */
+
+struct wg_nl;
+
+struct wg_nl_peer {
+	guint8 public_key[WG_KEY_LEN];
+	/* ss_family is 0 when the peer has no endpoint yet */
+	struct sockaddr_storage endpoint;
+	/* Seconds since the epoch, 0 if there never was a handshake */
+	gint64 last_handshake;
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+	guint16 keepalive;
+	guint n_allowed_ips;
+};
+
+/*
+ * The caller provides room for max_peers peers. n_peers is the number of
+ * peers the interface has, which is more than max_peers when the dump
+ * did not fit; only the first max_peers are filled in then.
+ */
+struct wg_nl_device {
+	gchar ifname[IFNAMSIZ];
+	guint32 ifindex;
+	guint8 public_key[WG_KEY_LEN];
+	guint16 listen_port;
+	guint32 fwmark;
+	struct wg_nl_peer *peers;
+	guint max_peers;
+	guint n_peers;
+};
+
+struct wg_nl_allowedip {
+	guint16 family;
+	union {
+		struct in_addr ip4;
+		struct in6_addr ip6;
+	} addr;
+	guint8 cidr;
+};
+
+struct wg_nl_peer_config {
+	const guint8 *public_key;
+	/* NULL leaves the preshared key alone */
+	const guint8 *preshared_key;
+	/* NULL leaves the endpoint alone */
+	const struct sockaddr *endpoint;
+	socklen_t endpoint_len;
+	/* Seconds, 0 disables, -1 leaves it alone */
+	gint keepalive;
+	/* WGPEER_F_REMOVE_ME, WGPEER_F_REPLACE_ALLOWEDIPS */
+	guint32 flags;
+	const struct wg_nl_allowedip *allowed_ips;
+	guint n_allowed_ips;
+};
+
+struct wg_nl *wg_nl_open(void);
+struct wg_nl *wg_nl_open_fd(int fd, guint16 family);
+void wg_nl_close(struct wg_nl *nl);
+
+int wg_nl_get_device(struct wg_nl *nl, const gchar * ifname,
+		     struct wg_nl_device *dev);
+int wg_nl_set_device(struct wg_nl *nl, const gchar * ifname,
+		     guint32 device_flags,
+		     const struct wg_nl_peer_config *peers, guint n_peers);
+
+#endif
@@ -28,6 +28,9 @@
 #include <connui/connui-log.h>
 #include <icd/wireguard/libicd_wireguard_shared.h>
 
+#include "blob.h"
+#include "gckeys.h"
+#include "validate.h"
 #include "wizard.h"
 
 enum {
@@ -189,6 +192,7 @@ static void delete_config(GtkWidget * parent, GtkTreeView * tv)
 	gconf = gconf_client_get_default();
 	gconf_client_recursive_unset(gconf, gconf_cfg, 0, NULL);
 	gconf_client_remove_dir(gconf, gconf_cfg, NULL);
+	wg_blob_remove(NULL, sel_cfg);
 
 	g_free(sel_cfg);
 	g_free(gconf_cfg);
@@ -200,7 +204,7 @@ static void append_peer(gpointer elem, gpointer data)
 	struct wg_peer *peer;
 	struct wizard_data *w_data = data;
 	gchar *peername = elem;
-	gchar *gc_pubkey, *gc_psk, *gc_endpoint, *gc_ips;
+	gchar *gc_pubkey, *gc_psk, *gc_endpoint, *gc_ips, *gc_keepalive;
 	gchar *pubkey, *psk, *endpoint, *ips;
 
 /*
@@ -234,6 +238,11 @@ static void append_peer(gpointer elem, gpointer data)
 	g_free(gc_ips);
 	peer->allowed_ips = g_strdup(ips);
 
+	gc_keepalive = g_strjoin("/", peername, GC_PEER_KEEPALIVE, NULL);
+	peer->keepalive = gconf_client_get_int(w_data->gconf, gc_keepalive,
+					       NULL);
+	g_free(gc_keepalive);
+
 	//g_free(path);
 
 	g_ptr_array_add(w_data->peers, peer);
@@ -243,7 +252,7 @@ static struct wizard_data *fill_wizard_data_from_gconf(gchar * cfgname)
 {
 	struct wizard_data *w_data;
 	gchar *config_path;
-	gchar *g_privkey, *g_addr, *g_dns, *g_peers;
+	gchar *g_privkey, *g_addr, *g_dns, *g_mtu, *g_speedtest, *g_peers;
 
 	if (cfgname == NULL)
 		return NULL;
@@ -256,6 +265,8 @@ static struct wizard_data *fill_wizard_data_from_gconf(gchar * cfgname)
 	g_privkey = g_strjoin("/", config_path, GC_CFG_PRIVATEKEY, NULL);
 	g_addr = g_strjoin("/", config_path, GC_CFG_ADDRESS, NULL);
 	g_dns = g_strjoin("/", config_path, GC_CFG_DNS, NULL);
+	g_mtu = g_strjoin("/", config_path, GC_CFG_MTU, NULL);
+	g_speedtest = g_strjoin("/", config_path, GC_CFG_SPEEDTEST, NULL);
 
 	w_data->config_name = cfgname;
 
@@ -270,6 +281,13 @@ static struct wizard_data *fill_wizard_data_from_gconf(gchar * cfgname)
 	    gconf_client_get_string(w_data->gconf, g_dns, NULL);
 	g_free(g_dns);
 
+	w_data->mtu = gconf_client_get_int(w_data->gconf, g_mtu, NULL);
+	g_free(g_mtu);
+
+	w_data->speedtest_host =
+	    gconf_client_get_string(w_data->gconf, g_speedtest, NULL);
+	g_free(g_speedtest);
+
 	g_peers = g_strjoin("/", config_path, GC_PEERS, NULL);
 	if (gconf_client_dir_exists(w_data->gconf, g_peers, NULL)) {
 		GSList *peerlist =
@@ -296,6 +314,34 @@ static struct wizard_data *fill_wizard_data_from_gconf(gchar * cfgname)
 	return w_data;
 }
 
+static gboolean validate_loaded_config(const gchar *filename)
+{
+	gchar *contents, *msg;
+	gsize len;
+	guint line = 0;
+	GError *error = NULL;
+
+	if (!g_file_get_contents(filename, &contents, &len, &error)) {
+		ULOG_WARN("Unable to read %s: %s", filename, error->message);
+		hildon_banner_show_information(NULL, NULL,
+					       "Unable to read configuration");
+		g_error_free(error);
+		return FALSE;
+	}
+
+	if (wg_validate_config(contents, len, &line)) {
+		g_free(contents);
+		return TRUE;
+	}
+
+	msg = g_strdup_printf("Invalid configuration (line %u)", line);
+	hildon_banner_show_information(NULL, NULL, msg);
+	g_free(msg);
+	g_free(contents);
+
+	return FALSE;
+}
+
 static gchar *load_from_filesystem(GtkWidget *parent)
 {
 	GtkWidget *c;
@@ -313,7 +359,10 @@ static gchar *load_from_filesystem(GtkWidget *parent)
 		break;
 	}
 
-	/* TODO: Validate the configuration somehow */
+	if (ret != NULL && !validate_loaded_config(ret)) {
+		g_free(ret);
+		ret = NULL;
+	}
 
 	gtk_widget_hide(c);
 	gtk_widget_destroy(c);
@@ -331,6 +380,8 @@ static void save_loaded_config_to_gconf(const gchar *config_name)
 
 	gconf_client_add_dir(gconf, gc_path, GCONF_CLIENT_PRELOAD_NONE, NULL);
 	gconf_client_set_string(gconf, gc_cfg, config_name, NULL);
+	/* The file may change under us, it is read at connect time instead */
+	wg_blob_remove(gconf, bn);
 
 	g_free(bn);
 	g_free(gc_cfg);
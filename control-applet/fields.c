@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include "fields.h"
+#include "mtu.h"
+#include "validate.h"
+
+void wizard_field_init(struct wizard_field *field,
+		       struct wizard_data *w_data, gpointer entry,
+		       gboolean(*validate) (struct wizard_data *,
+					    const gchar *))
+{
+	wizard_field_reset(field);
+	field->w_data = w_data;
+	field->entry = entry;
+	field->validate = validate;
+	field->valid = FALSE;
+}
+
+/* Forget what was checked, so the next check runs again */
+void wizard_field_reset(struct wizard_field *field)
+{
+	if (field->source) {
+		g_source_remove(field->source);
+		field->source = 0;
+	}
+
+	g_free(field->text);
+	field->text = NULL;
+	field->checked = FALSE;
+}
+
+/* Validate text, unless it is what the field last validated */
+gboolean wizard_field_check(struct wizard_field *field, const gchar * text,
+			    struct validation_stats *st)
+{
+	if (field->checked && !g_strcmp0(field->text, text)) {
+		st->memo_hits++;
+		return field->valid;
+	}
+
+	st->validations++;
+	field->valid = field->validate(field->w_data, text);
+	g_free(field->text);
+	field->text = g_strdup(text);
+	field->checked = TRUE;
+
+	return field->valid;
+}
+
+gboolean wizard_fields_complete(const struct wizard_field *fields)
+{
+	gint i;
+
+	for (i = 0; i < N_FIELDS; i++) {
+		if (!fields[i].checked || !fields[i].valid)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean is_empty(const gchar * text)
+{
+	return !g_strcmp0(text, "") || !g_strcmp0(text, FIELD_OPTIONAL_TEXT);
+}
+
+gboolean wizard_validate_address(struct wizard_data *w_data,
+				 const gchar * text)
+{
+	(void)w_data;
+
+	/* This is in the form of 10.0.0.1/24, fd00::1/64 */
+	if (wg_validate_cidr_list(text, -1, TRUE) < 0) {
+		g_warning("Address is invalid");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean wizard_validate_dns(struct wizard_data *w_data, const gchar * text)
+{
+	(void)w_data;
+
+	/* Optional; addresses and search domains, as in an imported file */
+	if (is_empty(text))
+		return TRUE;
+
+	if (wg_validate_dns_list(text, -1) < 0) {
+		g_warning("DNS Address is invalid");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean wizard_validate_mtu(struct wizard_data *w_data, const gchar * text)
+{
+	(void)w_data;
+
+	if (wg_mtu_parse(text) < 0) {
+		g_warning("MTU is invalid");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean wizard_validate_speedtest(struct wizard_data *w_data,
+				   const gchar * text)
+{
+	(void)w_data;
+
+	/* Optional, but has to be an address if given */
+	if (is_empty(text))
+		return TRUE;
+
+	if (!wg_validate_ip(text, -1, NULL)) {
+		g_warning("Speed test host is invalid");
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __FIELDS_H__
+#define __FIELDS_H__
+
+#include <glib.h>
+
+/*
+ * Validation of the wizard's interface page, without GTK: each field
+ * remembers the text it last checked and whether that was valid, and the
+ * page is complete once every field was checked and found valid.
+ */
+
+/* What an empty optional field shows, and what an automatic MTU does */
+#define FIELD_OPTIONAL_TEXT "(optional)"
+#define FIELD_MTU_AUTO_TEXT "auto"
+
+enum wizard_field_id {
+	FIELD_PRIVKEY = 0,
+	FIELD_ADDRESS = 1,
+	FIELD_DNS = 2,
+	FIELD_MTU = 3,
+	FIELD_SPEEDTEST = 4,
+	N_FIELDS
+};
+
+struct wizard_data;
+
+/* Debounced, memoized validation state of a single entry */
+struct wizard_field {
+	struct wizard_data *w_data;
+	/* The GtkEntry the text comes from */
+	gpointer entry;
+	gboolean (*validate)(struct wizard_data * w_data, const gchar * text);
+
+	guint source;
+	/* What was last validated, and the result */
+	gchar *text;
+	gboolean checked;
+	gboolean valid;
+};
+
+struct validation_stats {
+	guint changes;
+	guint coalesced;
+	guint validations;
+	guint memo_hits;
+	guint spawns;
+	guint spawns_avoided;
+};
+
+void wizard_field_init(struct wizard_field *field,
+		       struct wizard_data *w_data, gpointer entry,
+		       gboolean(*validate) (struct wizard_data *,
+					    const gchar *));
+void wizard_field_reset(struct wizard_field *field);
+gboolean wizard_field_check(struct wizard_field *field, const gchar * text,
+			    struct validation_stats *st);
+gboolean wizard_fields_complete(const struct wizard_field *fields);
+
+gboolean wizard_validate_address(struct wizard_data *w_data,
+				 const gchar * text);
+gboolean wizard_validate_dns(struct wizard_data *w_data, const gchar * text);
+gboolean wizard_validate_mtu(struct wizard_data *w_data, const gchar * text);
+gboolean wizard_validate_speedtest(struct wizard_data *w_data,
+				   const gchar * text);
+
+#endif
@@ -26,7 +26,14 @@
 #include <hildon-cp-plugin/hildon-cp-plugin-interface.h>
 
 #include <icd/wireguard/libicd_wireguard_shared.h>
+#include "blob.h"
+#include "fields.h"
+#include "gckeys.h"
+#include "keepalive.h"
+#include "mtu.h"
 #include "pipeutil.h"
+#include "resolvcache.h"
+#include "validate.h"
 #include "wizard.h"
 
 static void free_peer(gpointer elem, gpointer data)
@@ -39,12 +46,33 @@ static void free_peer(gpointer elem, gpointer data)
 	g_free(peer->allowed_ips);
 }
 
+static void stop_field_validation(struct wizard_data *w_data)
+{
+	struct validation_stats *st = &w_data->vstats;
+	gint i;
+
+	for (i = 0; i < N_FIELDS; i++)
+		wizard_field_reset(&w_data->fields[i]);
+
+	g_message("%s: %u changes, %u validations, %u coalesced, "
+		  "%u memoized, %u spawns, %u spawns avoided", G_STRFUNC,
+		  st->changes, st->validations, st->coalesced, st->memo_hits,
+		  st->spawns, st->spawns_avoided);
+
+	g_free(w_data->memo_privkey);
+	g_free(w_data->memo_pubkey);
+	w_data->memo_privkey = NULL;
+	w_data->memo_pubkey = NULL;
+}
+
 static void on_assistant_close_cancel_wg(GtkWidget * widget, gpointer data)
 {
 	g_message("%s", G_STRFUNC);
 	(void)widget;
 	struct wizard_data *w_data = data;
 
+	stop_field_validation(w_data);
+
 	if (w_data->peers != NULL) {
 		g_ptr_array_foreach(w_data->peers, free_peer, NULL);
 		g_ptr_array_unref(w_data->peers);
@@ -101,7 +129,7 @@ static void save_peer(gpointer elem, gpointer data)
 	struct wg_peer *peer = elem;
 	struct wizard_data *w_data = data;
 	gchar *peer_name, *gconf_path, *gconf_pubkey, *gconf_psk, *gconf_ips,
-	    *gconf_endpoint;
+	    *gconf_endpoint, *gconf_keepalive;
 
 	w_data->peer_idx++;
 	peer_name = g_strdup_printf("peer%d", w_data->peer_idx);
@@ -139,6 +167,11 @@ static void save_peer(gpointer elem, gpointer data)
 	gconf_set_string(w_data->gconf, gconf_endpoint, peer->endpoint);
 	g_free(gconf_endpoint);
 
+	gconf_keepalive = g_strjoin("/", gconf_path, GC_PEER_KEEPALIVE, NULL);
+	gconf_client_set_int(w_data->gconf, gconf_keepalive, peer->keepalive,
+			     NULL);
+	g_free(gconf_keepalive);
+
 	g_free(gconf_path);
 }
 
@@ -152,7 +185,8 @@ static void on_assistant_apply_wg(GtkWidget * widget, gpointer data)
 		return;
 
 	w_data->gconf = gconf_client_get_default();
-	gchar *gconf_privkey, *gconf_addr, *gconf_dns, *gconf_peers;
+	gchar *gconf_privkey, *gconf_addr, *gconf_dns, *gconf_mtu, *gconf_peers;
+	gchar *gconf_speedtest;
 
 	w_data->config_name = gtk_entry_get_text(GTK_ENTRY(w_data->name_entry));
 	gchar *confname =
@@ -184,6 +218,26 @@ static void on_assistant_apply_wg(GtkWidget * widget, gpointer data)
 		gconf_client_unset(w_data->gconf, gconf_dns, NULL);
 	g_free(gconf_dns);
 
+	w_data->mtu = wg_mtu_parse(gtk_entry_get_text
+				   (GTK_ENTRY(w_data->mtu_entry)));
+
+	gconf_mtu = g_strjoin("/", confname, GC_CFG_MTU, NULL);
+	gconf_client_set_int(w_data->gconf, gconf_mtu, MAX(w_data->mtu, 0),
+			     NULL);
+	g_free(gconf_mtu);
+
+	w_data->speedtest_host =
+	    gtk_entry_get_text(GTK_ENTRY(w_data->speedtest_entry));
+
+	gconf_speedtest = g_strjoin("/", confname, GC_CFG_SPEEDTEST, NULL);
+	if (g_strcmp0(w_data->speedtest_host, "")
+	    && g_strcmp0(w_data->speedtest_host, "(optional)"))
+		gconf_set_string(w_data->gconf, gconf_speedtest,
+				 w_data->speedtest_host);
+	else
+		gconf_client_unset(w_data->gconf, gconf_speedtest, NULL);
+	g_free(gconf_speedtest);
+
 	gconf_peers = g_strjoin("/", confname, GC_PEERS, NULL);
 
 	/* Nuke old peers data */
@@ -203,6 +257,10 @@ static void on_assistant_apply_wg(GtkWidget * widget, gpointer data)
 
 	g_free(gconf_peers);
 
+	if (!wg_blob_compile(w_data->gconf, w_data->config_name))
+		g_warning("Config %s not compiled, it is parsed at connect time",
+			  w_data->config_name);
+
 	g_free(confname);
 	g_object_unref(w_data->gconf);
 }
@@ -254,107 +312,143 @@ static void wg_privkey_generate_cb(GtkWidget * widget, gpointer data)
 	g_strfreev(private_key);
 }
 
-static void validate_interface_cb(GtkWidget * widget, gpointer data)
-{
-	struct wizard_data *w_data = data;
-	GtkAssistant *assistant = GTK_ASSISTANT(w_data->assistant);
-	gint page_number;
-	GtkWidget *cur_page;
-	const gchar *dns_addr, *iface_addr, *privkey, *pubkey;
-	gchar **addr_toks;
-	gint64 subnet;
+/* Quiet period after the last keystroke before a field is validated */
+#define VALIDATE_DEBOUNCE_MS 250
 
-	page_number = gtk_assistant_get_current_page(assistant);
-	cur_page = gtk_assistant_get_nth_page(assistant, page_number);
+static void derive_pubkey(struct wizard_data *w_data, const gchar * privkey)
+{
+	gchar **pubkey, *pk = NULL;
+	gchar *cmd_pk[] = { "/usr/bin/wg", "pubkey", NULL };
 
-	/* Validate the optional DNS address */
-	dns_addr = gtk_entry_get_text(GTK_ENTRY(w_data->dnsaddr_entry));
-	if (g_strcmp0(dns_addr, "") && g_strcmp0(dns_addr, "(optional)")) {
-		if (!g_hostname_is_ip_address(dns_addr)) {
-			g_warning("DNS Address is invalid");
-			goto invalid;
-		}
+	/* Same private key as last time, no need to ask wg again */
+	if (!g_strcmp0(w_data->memo_privkey, privkey)) {
+		w_data->vstats.spawns_avoided++;
+		gtk_entry_set_text(GTK_ENTRY(w_data->pubkey_entry),
+				   w_data->memo_pubkey);
+		return;
 	}
 
-	/* 
-	 * This is in the form of 10.0.0.1/24, so we split it and do some
-	 * kind of validation
-	 */
-	iface_addr = gtk_entry_get_text(GTK_ENTRY(w_data->addr_entry));
-	addr_toks = g_strsplit(iface_addr, "/", 2);
-	if (g_strv_length(addr_toks) != 2) {
-		g_strfreev(addr_toks);
-		goto invalid;
-	}
+	w_data->vstats.spawns++;
 
-	if (!g_hostname_is_ip_address(addr_toks[0])) {
-		g_warning("Address is invalid");
-		g_strfreev(addr_toks);
-		goto invalid;
+	if (pipe_cmd(cmd_pk, (gchar *) privkey, &pk)) {
+		g_warning("Failed to calculate Wireguard public key");
+		if (pk != NULL)
+			g_free(pk);
+		return;
 	}
 
-	subnet = g_ascii_strtoll(addr_toks[1], NULL, 10);
+	if (pk == NULL)
+		return;
 
-	if (subnet < 16 || subnet > 30) {
-		g_warning("Subnet is invalid");
-		g_strfreev(addr_toks);
-		goto invalid;
-	}
+	pubkey = g_strsplit(pk, "\n", 2);
+	g_free(pk);
 
-	g_strfreev(addr_toks);
+	g_free(w_data->memo_privkey);
+	g_free(w_data->memo_pubkey);
+	w_data->memo_privkey = g_strdup(privkey);
+	w_data->memo_pubkey = g_strdup(pubkey[0]);
+
+	gtk_entry_set_text(GTK_ENTRY(w_data->pubkey_entry), pubkey[0]);
+	g_strfreev(pubkey);
+}
 
-	/* And finally we try to check if the keys are valid */
-	/* They're always 44 bytes encoded. */
-	privkey = gtk_entry_get_text(GTK_ENTRY(w_data->privkey_entry));
-	pubkey = gtk_entry_get_text(GTK_ENTRY(w_data->pubkey_entry));
+static gboolean validate_privkey(struct wizard_data *w_data,
+				 const gchar * privkey)
+{
+	gtk_entry_set_text(GTK_ENTRY(w_data->pubkey_entry), "");
 
-	if (strlen(privkey) != 44 || strlen(pubkey) != 44) {
-		g_warning("Keys are invalid");
-		goto invalid;
+	if (!wg_validate_key(privkey, -1)) {
+		g_warning("Private key is invalid");
+		return FALSE;
 	}
 
-	gtk_assistant_set_page_complete(assistant, cur_page, TRUE);
-	return;
+	derive_pubkey(w_data, privkey);
 
- invalid:
-	gtk_assistant_set_page_complete(assistant, cur_page, FALSE);
+	return wg_validate_key(gtk_entry_get_text
+			       (GTK_ENTRY(w_data->pubkey_entry)), -1);
 }
 
-static void validate_privkey_cb(GtkWidget * widget, gpointer data)
+static void run_field_validation(struct wizard_field *field)
 {
-	struct wizard_data *w_data = data;
-	const gchar *privkey;
-	gchar **pubkey, *pk = NULL;
-	gchar *cmd_pk[] = { "/usr/bin/wg", "pubkey", NULL };
+	wizard_field_check(field,
+			   gtk_entry_get_text(GTK_ENTRY(field->entry)),
+			   &field->w_data->vstats);
+}
 
-	privkey = gtk_entry_get_text(GTK_ENTRY(w_data->privkey_entry));
-	gtk_entry_set_text(GTK_ENTRY(w_data->pubkey_entry), "");
+static void update_local_page_complete(struct wizard_data *w_data)
+{
+	gtk_assistant_set_page_complete(GTK_ASSISTANT(w_data->assistant),
+					w_data->local_vbox,
+					wizard_fields_complete(w_data->fields));
+}
 
-	if (strlen(privkey) != 44)
-		return;
+static gboolean field_debounce_cb(gpointer data)
+{
+	struct wizard_field *field = data;
 
-	if (pipe_cmd(cmd_pk, (gchar *) privkey, &pk)) {
-		g_warning("Failed to calculate Wireguard public key");
-		if (pk != NULL)
-			g_free(pk);
-		return;
+	field->source = 0;
+	run_field_validation(field);
+	update_local_page_complete(field->w_data);
+
+	return FALSE;
+}
+
+static void field_changed_cb(GtkWidget * widget, gpointer data)
+{
+	(void)widget;
+	struct wizard_field *field = data;
+
+	field->w_data->vstats.changes++;
+
+	/* Don't let the page be finished before the new text is checked */
+	gtk_assistant_set_page_complete(GTK_ASSISTANT(field->w_data->assistant),
+					field->w_data->local_vbox, FALSE);
+
+	/* Typing or pasting restarts the quiet period of this field only */
+	if (field->source) {
+		field->w_data->vstats.coalesced++;
+		g_source_remove(field->source);
 	}
 
-	if (pk == NULL)
-		return;
+	field->source =
+	    g_timeout_add(VALIDATE_DEBOUNCE_MS, field_debounce_cb, field);
+}
 
-	pubkey = g_strsplit(pk, "\n", 2);
-	g_free(pk);
+static void setup_field(struct wizard_data *w_data, enum wizard_field_id id,
+			GtkWidget * entry,
+			gboolean(*validate) (struct wizard_data *,
+					     const gchar *))
+{
+	struct wizard_field *field = &w_data->fields[id];
 
-	gtk_entry_set_text(GTK_ENTRY(w_data->pubkey_entry), pubkey[0]);
-	g_strfreev(pubkey);
+	wizard_field_init(field, w_data, entry, validate);
+
+	g_signal_connect(G_OBJECT(entry), "changed",
+			 G_CALLBACK(field_changed_cb), field);
+}
+
+static void validate_fields_now(struct wizard_data *w_data)
+{
+	gint i;
+
+	for (i = 0; i < N_FIELDS; i++) {
+		if (w_data->fields[i].source) {
+			g_source_remove(w_data->fields[i].source);
+			w_data->fields[i].source = 0;
+		}
+		run_field_validation(&w_data->fields[i]);
+	}
+
+	update_local_page_complete(w_data);
 }
 
 static gint new_wizard_local_page(struct wizard_data *w_data)
 {
 	gint rv;
 	GtkWidget *vbox, *btn_generate;
-	GtkWidget *privkey_lbl, *pubkey_lbl, *addr_lbl, *dnsaddr_lbl;
+	GtkWidget *privkey_lbl, *pubkey_lbl, *addr_lbl, *dnsaddr_lbl, *mtu_lbl;
+	GtkWidget *speedtest_lbl;
+	gchar *mtu;
 
 	vbox = gtk_vbox_new(TRUE, 2);
 
@@ -380,8 +474,8 @@ static gint new_wizard_local_page(struct wizard_data *w_data)
 	g_signal_connect(G_OBJECT(btn_generate), "clicked",
 			 G_CALLBACK(wg_privkey_generate_cb), w_data);
 
-	g_signal_connect(G_OBJECT(w_data->privkey_entry), "changed",
-			 G_CALLBACK(validate_privkey_cb), w_data);
+	setup_field(w_data, FIELD_PRIVKEY, w_data->privkey_entry,
+		    validate_privkey);
 
 	/* Public key entry (insensitive) */
 	GtkWidget *hb1 = gtk_hbox_new(FALSE, 2);
@@ -407,8 +501,8 @@ static gint new_wizard_local_page(struct wizard_data *w_data)
 	gtk_box_pack_start(GTK_BOX(hb2), w_data->addr_entry, TRUE, TRUE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), hb2, TRUE, TRUE, 0);
 
-	g_signal_connect(G_OBJECT(w_data->addr_entry), "changed",
-			 G_CALLBACK(validate_interface_cb), w_data);
+	setup_field(w_data, FIELD_ADDRESS, w_data->addr_entry,
+		    wizard_validate_address);
 
 	/* DNS Address entry */
 	GtkWidget *hb3 = gtk_hbox_new(FALSE, 2);
@@ -420,29 +514,80 @@ static gint new_wizard_local_page(struct wizard_data *w_data)
 				   w_data->dns_address);
 	else
 		gtk_entry_set_text(GTK_ENTRY(w_data->dnsaddr_entry),
-				   "(optional)");
+				   FIELD_OPTIONAL_TEXT);
 
 	gtk_box_pack_start(GTK_BOX(hb3), dnsaddr_lbl, FALSE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(hb3), w_data->dnsaddr_entry, TRUE, TRUE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), hb3, TRUE, TRUE, 0);
 
-	g_signal_connect(G_OBJECT(w_data->dnsaddr_entry), "changed",
-			 G_CALLBACK(validate_interface_cb), w_data);
+	setup_field(w_data, FIELD_DNS, w_data->dnsaddr_entry,
+		    wizard_validate_dns);
+
+	/* MTU entry */
+	GtkWidget *hb4 = gtk_hbox_new(FALSE, 2);
+	mtu_lbl = gtk_label_new("MTU:");
+	w_data->mtu_entry = gtk_entry_new();
+
+	if (w_data->mtu > 0)
+		mtu = g_strdup_printf("%d", w_data->mtu);
+	else
+		mtu = g_strdup(FIELD_MTU_AUTO_TEXT);
+	gtk_entry_set_text(GTK_ENTRY(w_data->mtu_entry), mtu);
+	g_free(mtu);
+
+	gtk_box_pack_start(GTK_BOX(hb4), mtu_lbl, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hb4), w_data->mtu_entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hb4, TRUE, TRUE, 0);
+
+	setup_field(w_data, FIELD_MTU, w_data->mtu_entry,
+		    wizard_validate_mtu);
+
+	/* Speed test host entry */
+	GtkWidget *hb5 = gtk_hbox_new(FALSE, 2);
+	speedtest_lbl = gtk_label_new("Speed test host:");
+	w_data->speedtest_entry = gtk_entry_new();
+
+	if (w_data->speedtest_host)
+		gtk_entry_set_text(GTK_ENTRY(w_data->speedtest_entry),
+				   w_data->speedtest_host);
+	else
+		gtk_entry_set_text(GTK_ENTRY(w_data->speedtest_entry),
+				   FIELD_OPTIONAL_TEXT);
+
+	gtk_box_pack_start(GTK_BOX(hb5), speedtest_lbl, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hb5), w_data->speedtest_entry, TRUE, TRUE,
+			   0);
+	gtk_box_pack_start(GTK_BOX(vbox), hb5, TRUE, TRUE, 0);
+
+	setup_field(w_data, FIELD_SPEEDTEST, w_data->speedtest_entry,
+		    wizard_validate_speedtest);
 
 	gtk_widget_show_all(vbox);
 
+	w_data->local_vbox = vbox;
+
 	rv = gtk_assistant_append_page(GTK_ASSISTANT(w_data->assistant), vbox);
 	gtk_assistant_set_page_title(GTK_ASSISTANT(w_data->assistant), vbox,
 				     "Interface configuration");
 
-	if (w_data->private_key) {
-		validate_privkey_cb(NULL, w_data);
-		validate_interface_cb(NULL, w_data);
-	}
+	/*
+	 * The optional fields start out filled in, before their handlers
+	 * were connected; check them all once, so a new config only needs
+	 * a key and an address.
+	 */
+	validate_fields_now(w_data);
 
 	return rv;
 }
 
+static void set_keepalive_text(struct wizard_data *w_data, gint keepalive)
+{
+	gchar *text = wg_keepalive_to_string(keepalive);
+
+	gtk_entry_set_text(GTK_ENTRY(w_data->p_keepalive_entry), text);
+	g_free(text);
+}
+
 static void prev_peer_cb(GtkWidget * widget, gpointer data)
 {
 	struct wizard_data *w_data = data;
@@ -465,6 +610,7 @@ static void prev_peer_cb(GtkWidget * widget, gpointer data)
 	gtk_entry_set_text(GTK_ENTRY(w_data->p_endpoint_entry), peer->endpoint);
 	if (peer->allowed_ips != NULL)
 		gtk_entry_set_text(GTK_ENTRY(w_data->p_ips_entry), peer->allowed_ips);
+	set_keepalive_text(w_data, peer->keepalive);
 
 	gtk_widget_set_sensitive(w_data->p_del_btn, TRUE);
 }
@@ -482,6 +628,7 @@ static void next_peer_cb(GtkWidget * widget, gpointer data)
 		gtk_entry_set_text(GTK_ENTRY(w_data->p_psk_entry), "");
 		gtk_entry_set_text(GTK_ENTRY(w_data->p_endpoint_entry), "");
 		gtk_entry_set_text(GTK_ENTRY(w_data->p_ips_entry), "");
+		set_keepalive_text(w_data, WG_KEEPALIVE_ADAPTIVE);
 
 		gtk_widget_set_sensitive(widget, FALSE);
 		gtk_widget_set_sensitive(w_data->p_del_btn, FALSE);
@@ -495,6 +642,7 @@ static void next_peer_cb(GtkWidget * widget, gpointer data)
 	gtk_entry_set_text(GTK_ENTRY(w_data->p_psk_entry), peer->preshared_key);
 	gtk_entry_set_text(GTK_ENTRY(w_data->p_endpoint_entry), peer->endpoint);
 	gtk_entry_set_text(GTK_ENTRY(w_data->p_ips_entry), peer->allowed_ips);
+	set_keepalive_text(w_data, peer->keepalive);
 
 	if (w_data->peer_idx == w_data->peers->len - 1)
 		gtk_widget_set_sensitive(widget, FALSE);
@@ -515,14 +663,30 @@ static void del_peer_cb(GtkWidget * widget, gpointer data)
 	}
 }
 
+static void endpoint_resolved_cb(const gchar * host, GInetAddress * addr,
+				 gpointer data)
+{
+	(void)data;
+	gchar *msg;
+
+	if (addr != NULL)
+		return;
+
+	msg = g_strdup_printf("Unable to resolve %s", host);
+	hildon_banner_show_information(NULL, NULL, msg);
+	g_free(msg);
+}
+
 static void validate_peer_cb(GtkWidget * widget, gpointer data)
 {
 	(void)widget;
 	struct wizard_data *w_data = data;
 	struct wg_peer *peer;
 	const gchar *pubkey, *psk, *fendpoint, *fips;
-	gchar **endpoint;
-	gint64 port;
+	struct wg_endpoint ep;
+	gint keepalive;
+	gboolean keepalive_ok;
+	gchar *host;
 	GtkAssistant *assistant = GTK_ASSISTANT(w_data->assistant);
 	gint page_number;
 	GtkWidget *cur_page;
@@ -534,6 +698,10 @@ static void validate_peer_cb(GtkWidget * widget, gpointer data)
 	psk = gtk_entry_get_text(GTK_ENTRY(w_data->p_psk_entry));
 	fendpoint = gtk_entry_get_text(GTK_ENTRY(w_data->p_endpoint_entry));
 	fips = gtk_entry_get_text(GTK_ENTRY(w_data->p_ips_entry));
+	keepalive_ok =
+	    wg_keepalive_parse(gtk_entry_get_text
+			       (GTK_ENTRY(w_data->p_keepalive_entry)),
+			       &keepalive);
 
 	if (w_data->peers->len > 0) {
 		if (w_data->peers->pdata[w_data->peer_idx] != NULL) {
@@ -553,6 +721,9 @@ static void validate_peer_cb(GtkWidget * widget, gpointer data)
 			if (g_strcmp0(p->allowed_ips, fips))
 				same = FALSE;
 
+			if (!keepalive_ok || p->keepalive != keepalive)
+				same = FALSE;
+
 			gtk_assistant_set_page_complete(assistant, cur_page,
 							same);
 
@@ -569,70 +740,46 @@ static void validate_peer_cb(GtkWidget * widget, gpointer data)
 		return;
 	}
 
-	/* TODO: Better validation */
-	if (strlen(pubkey) != 44) {
+	if (!wg_validate_key(pubkey, -1)) {
 		hildon_banner_show_information(NULL, NULL, "Invalid pubkey");
 		goto invalid;
 	}
 
-	if (strlen(psk) != 44
-	    && (g_strcmp0(psk, "(optional)") && g_strcmp0("", psk))) {
+	if (g_strcmp0(psk, "(optional)") && g_strcmp0("", psk)
+	    && !wg_validate_key(psk, -1)) {
 		hildon_banner_show_information(NULL, NULL, "Invalid PSK");
 		goto invalid;
 	}
 
-	endpoint = g_strsplit(fendpoint, ":", 2);
-	if (g_strv_length(endpoint) != 2) {
+	switch (wg_parse_endpoint(fendpoint, -1, &ep)) {
+	case WG_ENDPOINT_IPV4:
+	case WG_ENDPOINT_IPV6:
+		break;
+	case WG_ENDPOINT_HOSTNAME:
+		/* Don't block on DNS, just warn if the name doesn't resolve */
+		host = g_strndup(ep.host, ep.host_len);
+		wg_resolv_cache_resolve(wg_resolv_cache_get_default(), host,
+					endpoint_resolved_cb, NULL);
+		g_free(host);
+		break;
+	default:
 		hildon_banner_show_information(NULL, NULL, "Invalid Endpoint");
-		g_strfreev(endpoint);
-		goto invalid;
-	}
-
-	/* TODO: Maybe support domains? */
-	if (!g_hostname_is_ip_address(endpoint[0])) {
-		hildon_banner_show_information(NULL, NULL,
-					       "Endpoint is not a valid IPv4");
-		g_strfreev(endpoint);
 		goto invalid;
 	}
 
-	port = g_ascii_strtoll(endpoint[1], NULL, 10);
-	if (port < 1 || port > 65535) {
+	/* Multiple ranges are allowed, i.e.: 0.0.0.0/0, ::/0 */
+	if (strlen(fips) > 0 && wg_validate_cidr_list(fips, -1, FALSE) < 0) {
 		hildon_banner_show_information(NULL, NULL,
-					       "Endpoint has an invalid port number");
-		g_strfreev(endpoint);
+					       "Allowed IPs are invalid");
 		goto invalid;
 	}
 
-	/* TODO: Support multiple, i.e.: 0.0.0.0/0, ::/0 */
-	/*
-	gchar **ips = g_strsplit(fips, "/", 2);
-	if (g_strv_length(ips) != 2) {
+	if (!keepalive_ok) {
 		hildon_banner_show_information(NULL, NULL,
-					       "Allowed IP is invalid");
-		g_strfreev(ips);
+					       "Keepalive is invalid");
 		goto invalid;
 	}
 
-	if (!g_hostname_is_ip_address(ips[0])) {
-		hildon_banner_show_information(NULL, NULL,
-					       "Allowed IP is invalid");
-		g_strfreev(ips);
-		goto invalid;
-	}
-
-	gint64 subnet = g_ascii_strtoll(ips[1], NULL, 10);
-
-	if (subnet != 0) {
-		if (subnet < 16 || subnet > 30) {
-			hildon_banner_show_information(NULL, NULL,
-						       "Allowed IP has invalid subnet");
-			g_strfreev(ips);
-			goto invalid;
-		}
-	}
-	*/
-
 	/* At this point, we consider the entries valid */
 	peer = NULL;
 	peer = g_new0(struct wg_peer, 1);
@@ -643,6 +790,7 @@ static void validate_peer_cb(GtkWidget * widget, gpointer data)
 		peer->allowed_ips = g_strdup(fips);
 	else
 		peer->allowed_ips = NULL;
+	peer->keepalive = keepalive;
 
 	if (w_data->peer_idx >= w_data->peers->len) {
 		g_ptr_array_add(w_data->peers, peer);
@@ -668,7 +816,7 @@ static gint new_wizard_peer_page(struct wizard_data *w_data)
 {
 	gint rv;
 	GtkWidget *vbox;
-	GtkWidget *pubkey_lbl, *psk_lbl, *endpoint_lbl, *ips_lbl;
+	GtkWidget *pubkey_lbl, *psk_lbl, *endpoint_lbl, *ips_lbl, *keepalive_lbl;
 	struct wg_peer *peer = NULL;
 
 	if (w_data->has_peers && w_data->peers->len > 0)
@@ -734,8 +882,21 @@ static gint new_wizard_peer_page(struct wizard_data *w_data)
 	gtk_box_pack_start(GTK_BOX(hb3), w_data->p_ips_entry, TRUE, TRUE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), hb3, TRUE, TRUE, 0);
 
-	/* Save/Delete/Previous/Next */
+	/* PersistentKeepalive entry, "auto" learns what the NAT needs */
 	GtkWidget *hb4 = gtk_hbox_new(FALSE, 2);
+	keepalive_lbl = gtk_label_new("Keepalive:");
+	w_data->p_keepalive_entry = gtk_entry_new();
+
+	set_keepalive_text(w_data, peer ? peer->keepalive :
+			   WG_KEEPALIVE_ADAPTIVE);
+
+	gtk_box_pack_start(GTK_BOX(hb4), keepalive_lbl, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hb4), w_data->p_keepalive_entry, TRUE, TRUE,
+			   0);
+	gtk_box_pack_start(GTK_BOX(vbox), hb4, TRUE, TRUE, 0);
+
+	/* Save/Delete/Previous/Next */
+	GtkWidget *hb5 = gtk_hbox_new(FALSE, 2);
 	w_data->p_save_btn = gtk_button_new_with_label("Save peer");
 	w_data->p_del_btn = gtk_button_new_with_label("Delete peer");
 
@@ -761,11 +922,11 @@ static gint new_wizard_peer_page(struct wizard_data *w_data)
 	g_signal_connect(G_OBJECT(w_data->p_next_btn), "clicked",
 			 G_CALLBACK(next_peer_cb), w_data);
 
-	gtk_box_pack_start(GTK_BOX(hb4), w_data->p_save_btn, TRUE, TRUE, 2);
-	gtk_box_pack_start(GTK_BOX(hb4), w_data->p_del_btn, TRUE, TRUE, 2);
-	gtk_box_pack_start(GTK_BOX(hb4), w_data->p_prev_btn, TRUE, TRUE, 2);
-	gtk_box_pack_start(GTK_BOX(hb4), w_data->p_next_btn, TRUE, TRUE, 2);
-	gtk_box_pack_start(GTK_BOX(vbox), hb4, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hb5), w_data->p_save_btn, TRUE, TRUE, 2);
+	gtk_box_pack_start(GTK_BOX(hb5), w_data->p_del_btn, TRUE, TRUE, 2);
+	gtk_box_pack_start(GTK_BOX(hb5), w_data->p_prev_btn, TRUE, TRUE, 2);
+	gtk_box_pack_start(GTK_BOX(hb5), w_data->p_next_btn, TRUE, TRUE, 2);
+	gtk_box_pack_start(GTK_BOX(vbox), hb5, TRUE, TRUE, 0);
 
 	gtk_widget_show_all(vbox);
 
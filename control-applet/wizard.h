@@ -18,6 +18,8 @@
 #ifndef __WIZARD_H__
 #define __WIZARD_H__
 
+#include "fields.h"
+
 enum wizard_button {
 	WIZARD_BUTTON_FINISH = 0,
 	WIZARD_BUTTON_PREVIOUS = 1,
@@ -31,6 +33,8 @@ struct wg_peer {
 	gchar *preshared_key;
 	gchar *endpoint;
 	gchar *allowed_ips;
+	/* Seconds, WG_KEEPALIVE_OFF or WG_KEEPALIVE_ADAPTIVE */
+	gint keepalive;
 };
 
 struct wizard_data {
@@ -46,10 +50,21 @@ struct wizard_data {
 	const gchar *private_key;
 	const gchar *address;
 	const gchar *dns_address;
+	/* WG_MTU_AUTO or the MTU to use */
+	gint mtu;
+	const gchar *speedtest_host;
 	GtkWidget *privkey_entry;
 	GtkWidget *pubkey_entry;
 	GtkWidget *addr_entry;
 	GtkWidget *dnsaddr_entry;
+	GtkWidget *mtu_entry;
+	GtkWidget *speedtest_entry;
+	GtkWidget *local_vbox;
+
+	struct wizard_field fields[N_FIELDS];
+	gchar *memo_privkey;
+	gchar *memo_pubkey;
+	struct validation_stats vstats;
 
 	GtkWidget *peers_chk;
 	gboolean has_peers;
@@ -61,6 +76,7 @@ struct wizard_data {
 	GtkWidget *p_psk_entry;
 	GtkWidget *p_endpoint_entry;
 	GtkWidget *p_ips_entry;
+	GtkWidget *p_keepalive_entry;
 
 	GtkWidget *p_save_btn;
 	GtkWidget *p_del_btn;
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+
+#include <glib.h>
+
+#include "connstats.h"
+
+static const gchar *state_names[] = {
+	"down", "connecting", "up",
+};
+
+static void histogram_init(struct conn_histogram *h, gint64 unit_us)
+{
+	memset(h, 0, sizeof(*h));
+	h->unit_us = unit_us;
+}
+
+static void histogram_add(struct conn_histogram *h, gint64 us)
+{
+	gint64 limit = h->unit_us;
+	guint i;
+
+	for (i = 0; i < CONN_HIST_BUCKETS - 1 && us >= limit; i++)
+		limit *= 2;
+
+	h->buckets[i]++;
+	h->count++;
+	h->sum_us += us;
+	h->max_us = MAX(h->max_us, us);
+}
+
+/* Upper bound of the bucket the median falls into */
+static gint64 histogram_median(const struct conn_histogram *h)
+{
+	gint64 limit = h->unit_us;
+	guint i, seen = 0;
+
+	for (i = 0; i < CONN_HIST_BUCKETS - 1; i++, limit *= 2) {
+		seen += h->buckets[i];
+		if (seen * 2 >= h->count)
+			return limit;
+	}
+
+	return h->max_us;
+}
+
+static void histogram_dump(GString * str, const gchar * name,
+			   const struct conn_histogram *h)
+{
+	guint i;
+
+	g_string_append_printf(str, " %s=%u/%" G_GINT64_FORMAT "ms"
+			       "(max %" G_GINT64_FORMAT "ms)[", name, h->count,
+			       h->count ? h->sum_us / h->count / 1000 : 0,
+			       h->max_us / 1000);
+
+	for (i = 0; i < CONN_HIST_BUCKETS; i++)
+		g_string_append_printf(str, i ? " %u" : "%u", h->buckets[i]);
+
+	g_string_append_c(str, ']');
+}
+
+static struct conn_config_stats *config_stats(struct conn_machine *cm,
+					      const gchar * config)
+{
+	struct conn_config_stats *st;
+
+	st = g_hash_table_lookup(cm->configs, config);
+	if (st == NULL) {
+		st = g_new0(struct conn_config_stats, 1);
+		histogram_init(&st->connect, CONN_CONNECT_UNIT_US);
+		histogram_init(&st->session, CONN_SESSION_UNIT_US);
+		g_hash_table_insert(cm->configs, g_strdup(config), st);
+	}
+
+	return st;
+}
+
+void conn_machine_init(struct conn_machine *cm, gint64 now)
+{
+	memset(cm, 0, sizeof(*cm));
+	cm->state = CONN_DOWN;
+	cm->entered = now;
+	cm->configs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					    g_free);
+}
+
+void conn_machine_clear(struct conn_machine *cm)
+{
+	if (cm->configs)
+		g_hash_table_destroy(cm->configs);
+	g_free(cm->config);
+	memset(cm, 0, sizeof(*cm));
+}
+
+/*
+ * Move to a new state. Leaving "connecting" for "up" is a connect, whose
+ * latency is recorded, and for "down" a failed attempt; leaving "up" ends
+ * a session. The time spent is charged to the config that was current
+ * when the state was entered.
+ */
+void conn_machine_transition(struct conn_machine *cm, enum conn_state to,
+			     const gchar * config, gint64 now)
+{
+	struct conn_config_stats *st;
+	gint64 spent = now - cm->entered;
+
+	if (to == cm->state)
+		return;
+
+	cm->transitions++;
+
+	if (cm->config) {
+		st = config_stats(cm, cm->config);
+
+		if (cm->state == CONN_CONNECTING && to == CONN_UP)
+			histogram_add(&st->connect, spent);
+		else if (cm->state == CONN_CONNECTING)
+			st->failed++;
+		else if (cm->state == CONN_UP) {
+			histogram_add(&st->session, spent);
+			st->sessions++;
+		}
+	}
+
+	/* A new attempt may be for another config than the last one */
+	if (to == CONN_CONNECTING || cm->state == CONN_DOWN) {
+		g_free(cm->config);
+		cm->config = g_strdup(config);
+		if (config && to == CONN_CONNECTING)
+			config_stats(cm, config)->attempts++;
+	}
+
+	cm->state = to;
+	cm->entered = now;
+}
+
+/* One line for the settings dialog, NULL if nothing was recorded */
+gchar *conn_machine_summary(struct conn_machine *cm, const gchar * config)
+{
+	struct conn_config_stats *st;
+	GString *str;
+
+	if (config == NULL
+	    || (st = g_hash_table_lookup(cm->configs, config)) == NULL)
+		return NULL;
+
+	str = g_string_new(NULL);
+	g_string_append_printf(str, "%u connects", st->connect.count);
+
+	if (st->connect.count)
+		g_string_append_printf(str, " in about %.1f s",
+				       (gdouble) histogram_median(&st->connect)
+				       / G_USEC_PER_SEC);
+	if (st->failed)
+		g_string_append_printf(str, ", %u failed", st->failed);
+
+	if (st->sessions)
+		g_string_append_printf(str, ", sessions last about %"
+				       G_GINT64_FORMAT " min",
+				       histogram_median(&st->session) /
+				       CONN_SESSION_UNIT_US);
+
+	return g_string_free(str, FALSE);
+}
+
+/* Everything recorded, one config per line, for collecting from syslog */
+gchar *conn_machine_dump(struct conn_machine *cm)
+{
+	struct conn_config_stats *st;
+	GHashTableIter iter;
+	gpointer key, value;
+	GString *str = g_string_new(NULL);
+
+	g_string_append_printf(str, "connection: %s for %" G_GINT64_FORMAT
+			       "s, %u transitions", state_names[cm->state],
+			       (g_get_monotonic_time() - cm->entered) /
+			       G_USEC_PER_SEC, cm->transitions);
+
+	g_hash_table_iter_init(&iter, cm->configs);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		st = value;
+		g_string_append_printf(str, "\n%s: attempts=%u failed=%u",
+				       (const gchar *)key, st->attempts,
+				       st->failed);
+		histogram_dump(str, "connect", &st->connect);
+		histogram_dump(str, "session", &st->session);
+	}
+
+	return g_string_free(str, FALSE);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __CONNSTATS_H__
+#define __CONNSTATS_H__
+
+#include <glib.h>
+
+/* Power of two buckets, the last one takes everything above */
+#define CONN_HIST_BUCKETS 10
+
+/* Width of the first bucket of connect latencies and of sessions */
+#define CONN_CONNECT_UNIT_US (G_USEC_PER_SEC / 4)
+#define CONN_SESSION_UNIT_US (60 * (gint64) G_USEC_PER_SEC)
+
+enum conn_state {
+	CONN_DOWN = 0,
+	CONN_CONNECTING,
+	CONN_UP,
+};
+
+struct conn_histogram {
+	gint64 unit_us;
+	guint buckets[CONN_HIST_BUCKETS];
+	guint count;
+	gint64 sum_us;
+	gint64 max_us;
+};
+
+struct conn_config_stats {
+	guint attempts;
+	guint failed;
+	guint sessions;
+	struct conn_histogram connect;
+	struct conn_histogram session;
+};
+
+struct conn_machine {
+	enum conn_state state;
+	/* Monotonic time the current state was entered */
+	gint64 entered;
+	gchar *config;
+	guint transitions;
+	/* config name -> struct conn_config_stats */
+	GHashTable *configs;
+};
+
+void conn_machine_init(struct conn_machine *cm, gint64 now);
+void conn_machine_clear(struct conn_machine *cm);
+void conn_machine_transition(struct conn_machine *cm, enum conn_state to,
+			     const gchar * config, gint64 now);
+
+gchar *conn_machine_summary(struct conn_machine *cm, const gchar * config);
+gchar *conn_machine_dump(struct conn_machine *cm);
+
+#endif
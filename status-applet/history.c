@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "history.h"
+
+#define HISTORY_MAGIC 0x57474831	/* "WGH1" */
+
+struct history_slot {
+	/* Minutes since the epoch this slot holds, stale if it doesn't match */
+	guint32 minute;
+	guint32 pad;
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+};
+
+struct history_file {
+	guint32 magic;
+	guint32 n_slots;
+	struct history_slot slots[HISTORY_SLOTS];
+};
+
+struct history {
+	struct history_file *file;
+};
+
+/* Escaped, so that two configs never share a file */
+static gchar *history_path(const gchar * config)
+{
+	gchar *name, *file, *path;
+
+	name = g_uri_escape_string(config, NULL, FALSE);
+	file = g_strconcat(name, ".history", NULL);
+	path = g_build_filename(g_get_user_cache_dir(), "wireguard", file,
+				NULL);
+
+	g_free(file);
+	g_free(name);
+	return path;
+}
+
+/*
+ * Map the history file of a config, creating it if needed. The file has
+ * a fixed size, so updates are plain stores into the mapping and
+ * survive the applet being restarted. Its blocks are allocated here,
+ * so a full disk fails the open rather than a store with SIGBUS later.
+ */
+struct history *history_open(const gchar * config)
+{
+	struct history_file *file;
+	struct history *h = NULL;
+	gchar *path, *dir;
+	struct stat st;
+	int fd, err;
+
+	path = history_path(config);
+	dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0700);
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		g_warning("Unable to open %s: %s", path, g_strerror(errno));
+		goto out;
+	}
+
+	if (fstat(fd, &st) < 0)
+		err = errno;
+	else if (st.st_size != sizeof(*file) && ftruncate(fd, 0) < 0)
+		err = errno;
+	else
+		err = posix_fallocate(fd, 0, sizeof(*file));
+
+	if (err) {
+		g_warning("Unable to size %s: %s", path, g_strerror(err));
+		close(fd);
+		/* Don't leave a short file to be mapped next time */
+		g_unlink(path);
+		goto out;
+	}
+
+	file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+		g_warning("Unable to map %s: %s", path, g_strerror(errno));
+		goto out;
+	}
+
+	/* New, truncated or from another layout, start over */
+	if (file->magic != HISTORY_MAGIC || file->n_slots != HISTORY_SLOTS) {
+		memset(file, 0, sizeof(*file));
+		file->magic = HISTORY_MAGIC;
+		file->n_slots = HISTORY_SLOTS;
+	}
+
+	h = g_new0(struct history, 1);
+	h->file = file;
+
+ out:
+	g_free(dir);
+	g_free(path);
+	return h;
+}
+
+void history_close(struct history *h)
+{
+	if (h == NULL)
+		return;
+
+	munmap(h->file, sizeof(*h->file));
+	g_free(h);
+}
+
+/* Add traffic to the minute now (seconds since the epoch) falls into */
+void history_add(struct history *h, gint64 now, guint64 rx, guint64 tx)
+{
+	guint32 minute = now / 60;
+	struct history_slot *slot = &h->file->slots[minute % HISTORY_SLOTS];
+
+	if (slot->minute != minute) {
+		slot->minute = minute;
+		slot->rx_bytes = 0;
+		slot->tx_bytes = 0;
+	}
+
+	slot->rx_bytes += rx;
+	slot->tx_bytes += tx;
+}
+
+/*
+ * Fill bytes with the traffic of the last n minutes up to now, oldest
+ * first. Minutes without data read as 0.
+ */
+void history_read(struct history *h, gint64 now, guint64 * bytes, guint n)
+{
+	guint32 minute = now / 60;
+	struct history_slot *slot;
+	guint i;
+
+	n = MIN(n, HISTORY_SLOTS);
+
+	for (i = 0; i < n; i++) {
+		guint32 m = minute - (n - 1 - i);
+
+		slot = &h->file->slots[m % HISTORY_SLOTS];
+		bytes[i] = slot->minute == m ?
+		    slot->rx_bytes + slot->tx_bytes : 0;
+	}
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <glib.h>
+
+/* One slot per minute for the last day, sampled as often */
+#define HISTORY_SLOTS 1440
+#define HISTORY_INTERVAL_S 60
+
+struct history;
+
+struct history *history_open(const gchar * config);
+void history_close(struct history *h);
+void history_add(struct history *h, gint64 now, guint64 rx, guint64 tx);
+void history_read(struct history *h, gint64 now, guint64 * bytes, guint n);
+
+#endif
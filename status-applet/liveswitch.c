@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <gconf/gconf-client.h>
+#include <gio/gio.h>
+#include <icd/wireguard/libicd_wireguard_shared.h>
+
+#include "blob.h"
+#include "liveswitch.h"
+#include "resolvcache.h"
+#include "validate.h"
+#include "wgnl.h"
+
+/* The per-config keys that make up the interface, as opposed to peers */
+static const gchar *interface_keys[] = {
+	GC_CFG_PRIVATEKEY, GC_CFG_ADDRESS, GC_CFG_DNS,
+	GC_CONFIG_FILE_OVERRIDE,
+};
+
+struct live_peer {
+	gchar *pubkey;
+	gchar *psk;
+	gchar *endpoint;
+	gchar *ips;
+};
+
+static void free_peer(gpointer data)
+{
+	struct live_peer *peer = data;
+
+	g_free(peer->pubkey);
+	g_free(peer->psk);
+	g_free(peer->endpoint);
+	g_free(peer->ips);
+	g_free(peer);
+}
+
+static gchar *config_string(GConfClient * gconf, const gchar * config,
+			    const gchar * key)
+{
+	gchar *path = g_strjoin("/", GC_WIREGUARD, config, key, NULL);
+	gchar *value = gconf_client_get_string(gconf, path, NULL);
+
+	g_free(path);
+	return value;
+}
+
+static gboolean same_interface(GConfClient * gconf, const gchar * from,
+			       const gchar * to)
+{
+	gchar *a, *b;
+	gboolean same = TRUE;
+	guint i;
+
+	for (i = 0; same && i < G_N_ELEMENTS(interface_keys); i++) {
+		a = config_string(gconf, from, interface_keys[i]);
+		b = config_string(gconf, to, interface_keys[i]);
+
+		/* File configs can't be compared key by key */
+		if (!strcmp(interface_keys[i], GC_CONFIG_FILE_OVERRIDE))
+			same = a == NULL && b == NULL;
+		else
+			same = !g_strcmp0(a, b);
+
+		g_free(a);
+		g_free(b);
+	}
+
+	return same;
+}
+
+/* public key -> struct live_peer */
+static GHashTable *load_peers(GConfClient * gconf, const gchar * config)
+{
+	GHashTable *peers = g_hash_table_new_full(g_str_hash, g_str_equal,
+						  NULL, free_peer);
+	struct live_peer *peer;
+	GSList *dirs, *iter;
+	gchar *path, *key;
+
+	path = g_strjoin("/", GC_WIREGUARD, config, GC_PEERS, NULL);
+	dirs = gconf_client_all_dirs(gconf, path, NULL);
+	g_free(path);
+
+	for (iter = dirs; iter; iter = iter->next) {
+		peer = g_new0(struct live_peer, 1);
+
+		key = g_strjoin("/", iter->data, GC_PEER_PUBKEY, NULL);
+		peer->pubkey = gconf_client_get_string(gconf, key, NULL);
+		g_free(key);
+		key = g_strjoin("/", iter->data, GC_PEER_PSK, NULL);
+		peer->psk = gconf_client_get_string(gconf, key, NULL);
+		g_free(key);
+		key = g_strjoin("/", iter->data, GC_PEER_ENDPOINT, NULL);
+		peer->endpoint = gconf_client_get_string(gconf, key, NULL);
+		g_free(key);
+		key = g_strjoin("/", iter->data, GC_PEER_IPS, NULL);
+		peer->ips = gconf_client_get_string(gconf, key, NULL);
+		g_free(key);
+
+		if (peer->pubkey)
+			g_hash_table_replace(peers, peer->pubkey, peer);
+		else
+			free_peer(peer);
+
+		g_free(iter->data);
+	}
+	g_slist_free(dirs);
+
+	return peers;
+}
+
+static gboolean same_peer(const struct live_peer *a, const struct live_peer *b)
+{
+	return !g_strcmp0(a->psk, b->psk) && !g_strcmp0(a->endpoint,
+							  b->endpoint)
+	    && !g_strcmp0(a->ips, b->ips);
+}
+
+static gboolean decode_key(const gchar * base64, guint8 * key)
+{
+	guchar *raw;
+	gsize len;
+
+	if (!wg_validate_key(base64, -1))
+		return FALSE;
+
+	raw = g_base64_decode(base64, &len);
+	if (len == WG_KEY_LEN)
+		memcpy(key, raw, WG_KEY_LEN);
+	g_free(raw);
+
+	return len == WG_KEY_LEN;
+}
+
+/* A literal endpoint from a compiled config, without parsing it again */
+static gboolean blob_endpoint(const struct wg_blob_peer *bp,
+			      struct sockaddr_storage *ss, socklen_t * len)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+
+	memset(ss, 0, sizeof(*ss));
+
+	if (bp->endpoint_kind == WG_ENDPOINT_IPV4) {
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(bp->port);
+		memcpy(&sin->sin_addr, bp->addr, sizeof(sin->sin_addr));
+		*len = sizeof(*sin);
+	} else if (bp->endpoint_kind == WG_ENDPOINT_IPV6) {
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(bp->port);
+		memcpy(&sin6->sin6_addr, bp->addr, sizeof(sin6->sin6_addr));
+		*len = sizeof(*sin6);
+	} else {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+struct live_change {
+	guint8 pubkey[WG_KEY_LEN];
+	guint8 psk[WG_KEY_LEN];
+	struct sockaddr_storage endpoint;
+	GArray *ips;
+};
+
+static void free_change(gpointer data)
+{
+	struct live_change *change = data;
+
+	if (change->ips)
+		g_array_free(change->ips, TRUE);
+	g_free(change);
+}
+
+static gboolean add_change(GArray * configs, GPtrArray * changes,
+			   const struct live_peer *peer,
+			   const struct wg_blob *blob, gboolean remove)
+{
+	struct live_change *change = g_new0(struct live_change, 1);
+	const struct wg_blob_peer *bp = NULL;
+	struct wg_nl_peer_config pc;
+	socklen_t len = 0;
+
+	g_ptr_array_add(changes, change);
+	memset(&pc, 0, sizeof(pc));
+	pc.keepalive = -1;
+
+	if (!decode_key(peer->pubkey, change->pubkey))
+		return FALSE;
+	pc.public_key = change->pubkey;
+
+	if (remove) {
+		pc.flags = WGPEER_F_REMOVE_ME;
+		g_array_append_val(configs, pc);
+		return TRUE;
+	}
+
+	if (blob)
+		bp = wg_blob_find_peer(blob, change->pubkey);
+
+	/* The compiled config has everything but hostnames ready */
+	if (bp) {
+		/*
+		 * Always set, all zero when the new config has none, so a key
+		 * the peer had before is cleared and not left in place.
+		 */
+		pc.preshared_key = bp->preshared_key;
+
+		if (bp->endpoint_kind == WG_ENDPOINT_HOSTNAME) {
+			if (!wg_resolv_cache_sockaddr
+			    (wg_resolv_cache_get_default(), peer->endpoint,
+			     &change->endpoint, &len))
+				return FALSE;
+		} else if (bp->endpoint_kind != WG_ENDPOINT_INVALID) {
+			blob_endpoint(bp, &change->endpoint, &len);
+		}
+
+		if (len) {
+			pc.endpoint = (struct sockaddr *)&change->endpoint;
+			pc.endpoint_len = len;
+		}
+
+		pc.flags = WGPEER_F_REPLACE_ALLOWEDIPS;
+		pc.allowed_ips = wg_blob_peer_ips(bp);
+		pc.n_allowed_ips = bp->n_ips;
+
+		g_array_append_val(configs, pc);
+		return TRUE;
+	}
+
+	/* An all zero key removes the one a peer had before */
+	if (peer->psk && !decode_key(peer->psk, change->psk))
+		return FALSE;
+	pc.preshared_key = change->psk;
+
+	if (peer->endpoint) {
+		if (!wg_resolv_cache_sockaddr(wg_resolv_cache_get_default(),
+					      peer->endpoint, &change->endpoint,
+					      &len))
+			return FALSE;
+		pc.endpoint = (struct sockaddr *)&change->endpoint;
+		pc.endpoint_len = len;
+	}
+
+	change->ips = wg_parse_allowed_ips(peer->ips);
+	if (change->ips == NULL)
+		return FALSE;
+
+	pc.flags = WGPEER_F_REPLACE_ALLOWEDIPS;
+	pc.allowed_ips = (struct wg_nl_allowedip *)change->ips->data;
+	pc.n_allowed_ips = change->ips->len;
+
+	g_array_append_val(configs, pc);
+	return TRUE;
+}
+
+/*
+ * Switch the running interface from one config to another without
+ * taking it down, like 'wg syncconf' does. This only works when both
+ * configs share the interface settings and differ in peers alone; only
+ * the peers that differ are touched. Returns 0 on success and a
+ * negative errno value when the caller has to reconnect instead.
+ * blob is the compiled form of to if the caller has it already.
+ */
+int live_switch(const gchar * from, const gchar * to,
+		const struct wg_blob *blob, const gchar * ifname)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	GHashTable *old_peers = NULL, *new_peers = NULL;
+	struct wg_blob *loaded = NULL;
+	GArray *configs;
+	GPtrArray *changes;
+	GHashTableIter iter;
+	struct live_peer *peer, *old;
+	struct wg_nl *nl;
+	gpointer value;
+	int ret = 0;
+
+	configs = g_array_new(FALSE, TRUE, sizeof(struct wg_nl_peer_config));
+	changes = g_ptr_array_new_with_free_func(free_change);
+
+	if (!same_interface(gconf, from, to)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	old_peers = load_peers(gconf, from);
+	new_peers = load_peers(gconf, to);
+	if (blob == NULL)
+		blob = loaded = wg_blob_load(gconf, to);
+
+	g_hash_table_iter_init(&iter, new_peers);
+	while (ret == 0 && g_hash_table_iter_next(&iter, NULL, &value)) {
+		peer = value;
+		old = g_hash_table_lookup(old_peers, peer->pubkey);
+		if (old && same_peer(old, peer))
+			continue;
+		if (!add_change(configs, changes, peer, blob, FALSE))
+			ret = -EAGAIN;
+	}
+
+	g_hash_table_iter_init(&iter, old_peers);
+	while (ret == 0 && g_hash_table_iter_next(&iter, NULL, &value)) {
+		peer = value;
+		if (g_hash_table_lookup(new_peers, peer->pubkey))
+			continue;
+		if (!add_change(configs, changes, peer, NULL, TRUE))
+			ret = -EAGAIN;
+	}
+
+	if (ret < 0 || configs->len == 0)
+		goto out;
+
+	nl = wg_nl_open();
+	if (nl == NULL) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = wg_nl_set_device(nl, ifname, 0,
+			       (struct wg_nl_peer_config *)configs->data,
+			       configs->len);
+	wg_nl_close(nl);
+
+ out:
+	if (old_peers)
+		g_hash_table_destroy(old_peers);
+	if (new_peers)
+		g_hash_table_destroy(new_peers);
+	g_ptr_array_free(changes, TRUE);
+	g_array_free(configs, TRUE);
+	wg_blob_free(loaded);
+	g_object_unref(gconf);
+
+	return ret;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+
+#include <gconf/gconf-client.h>
+#include <glib.h>
+
+#include "gckeys.h"
+#include "prewarm.h"
+#include "resolvcache.h"
+#include "validate.h"
+
+struct prewarm_entry {
+	/* Monotonic time of the last warm up */
+	gint64 time;
+	/* NULL for configs that come from a file */
+	struct wg_blob *blob;
+};
+
+static void free_entry(gpointer data)
+{
+	struct prewarm_entry *entry = data;
+
+	wg_blob_free(entry->blob);
+	g_free(entry);
+}
+
+void prewarm_init(struct prewarm *pw)
+{
+	memset(pw, 0, sizeof(*pw));
+	pw->configs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					    free_entry);
+}
+
+void prewarm_clear(struct prewarm *pw)
+{
+	if (pw->configs)
+		g_hash_table_destroy(pw->configs);
+	pw->configs = NULL;
+}
+
+static gboolean fresh(const struct prewarm_entry *entry, gint64 now)
+{
+	return entry
+	    && now - entry->time < PREWARM_TTL_S * (gint64) G_USEC_PER_SEC;
+}
+
+/* A config file is only read and checked, it isn't kept */
+static void check_file(const gchar * config, const gchar * path)
+{
+	gchar *contents;
+	gsize len;
+	guint line;
+
+	if (!g_file_get_contents(path, &contents, &len, NULL)) {
+		g_warning("%s: unable to read %s", config, path);
+		return;
+	}
+
+	if (!wg_validate_config(contents, len, &line))
+		g_warning("%s: %s is invalid at line %u", config, path, line);
+
+	g_free(contents);
+}
+
+static struct wg_blob *load_blob(const gchar * config)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	struct wg_blob *blob = NULL;
+	gchar *key, *file;
+
+	key = g_strjoin("/", GC_WIREGUARD, config, GC_CONFIG_FILE_OVERRIDE,
+			NULL);
+	file = gconf_client_get_string(gconf, key, NULL);
+	g_free(key);
+
+	if (file) {
+		check_file(config, file);
+		g_free(file);
+		goto out;
+	}
+
+	/*
+	 * Only ever read: compiling writes the blob and the config, which
+	 * is up to whoever saves it. Without a blob the switch reads gconf.
+	 */
+	blob = wg_blob_load(gconf, config);
+
+ out:
+	g_object_unref(gconf);
+	return blob;
+}
+
+/*
+ * Get a config ready for connecting: start lookups for its endpoints and
+ * load its compiled form. Done at most once per PREWARM_TTL_S. The
+ * lookups only fill this process's cache; the provider resolves the
+ * endpoints again itself and doesn't get any faster from them.
+ */
+void prewarm_config(struct prewarm *pw, const gchar * config,
+		    const gchar * const *endpoints, gint64 now)
+{
+	struct prewarm_entry *entry;
+
+	if (config == NULL)
+		return;
+
+	entry = g_hash_table_lookup(pw->configs, config);
+	if (fresh(entry, now))
+		return;
+
+	if (entry == NULL) {
+		entry = g_new0(struct prewarm_entry, 1);
+		g_hash_table_insert(pw->configs, g_strdup(config), entry);
+	}
+
+	wg_resolv_cache_prefetch(wg_resolv_cache_get_default(), endpoints);
+
+	wg_blob_free(entry->blob);
+	entry->blob = load_blob(config);
+	entry->time = now;
+	pw->warmed++;
+}
+
+/* The compiled config, if it was loaded; owned by pw */
+const struct wg_blob *prewarm_blob(struct prewarm *pw, const gchar * config)
+{
+	struct prewarm_entry *entry;
+
+	entry = g_hash_table_lookup(pw->configs, config ? config : "");
+	return entry ? entry->blob : NULL;
+}
+
+/* Count whether a connect that starts now found the config warm */
+gboolean prewarm_hit(struct prewarm *pw, const gchar * config, gint64 now)
+{
+	struct prewarm_entry *entry;
+
+	entry = g_hash_table_lookup(pw->configs, config ? config : "");
+
+	if (fresh(entry, now)) {
+		pw->hits++;
+		return TRUE;
+	}
+
+	pw->misses++;
+	return FALSE;
+}
+
+void prewarm_connected(struct prewarm *pw, gboolean warm, gint64 us)
+{
+	struct prewarm_latency *l = warm ? &pw->warm : &pw->cold;
+
+	l->count++;
+	l->sum_us += us;
+	l->max_us = MAX(l->max_us, us);
+}
+
+static void latency_dump(GString * str, const gchar * name,
+			 const struct prewarm_latency *l)
+{
+	g_string_append_printf(str, " %s=%u/%" G_GINT64_FORMAT "ms"
+			       "(max %" G_GINT64_FORMAT "ms)", name, l->count,
+			       l->count ? l->sum_us / l->count / 1000 : 0,
+			       l->max_us / 1000);
+}
+
+gchar *prewarm_dump(struct prewarm *pw)
+{
+	GString *str = g_string_new(NULL);
+
+	g_string_append_printf(str, "prewarm: %u warmed, %u hits, %u misses,"
+			       " connect", pw->warmed, pw->hits, pw->misses);
+	latency_dump(str, "warm", &pw->warm);
+	latency_dump(str, "cold", &pw->cold);
+
+	return g_string_free(str, FALSE);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __PREWARM_H__
+#define __PREWARM_H__
+
+#include <glib.h>
+
+#include "blob.h"
+#include "resolvcache.h"
+
+/*
+ * Work done ahead of a connect that looks likely, e.g. when the menu is
+ * opened: endpoint lookups, reading and checking the config. The lookups
+ * warm the applet's own resolver cache only, which the live switch and
+ * the prober use; nothing outside the applet sees them. Warm state is as
+ * good as the resolver's answers, so it ages out with them.
+ */
+#define PREWARM_TTL_S WG_RESOLV_POSITIVE_TTL
+
+struct prewarm_latency {
+	guint count;
+	gint64 sum_us;
+	gint64 max_us;
+};
+
+struct prewarm {
+	/* config name -> struct prewarm_entry */
+	GHashTable *configs;
+	guint warmed;
+	guint hits;
+	guint misses;
+	struct prewarm_latency warm;
+	struct prewarm_latency cold;
+};
+
+void prewarm_init(struct prewarm *pw);
+void prewarm_clear(struct prewarm *pw);
+
+void prewarm_config(struct prewarm *pw, const gchar * config,
+		    const gchar * const *endpoints, gint64 now);
+const struct wg_blob *prewarm_blob(struct prewarm *pw, const gchar * config);
+gboolean prewarm_hit(struct prewarm *pw, const gchar * config, gint64 now);
+void prewarm_connected(struct prewarm *pw, gboolean warm, gint64 us);
+
+gchar *prewarm_dump(struct prewarm *pw);
+
+#endif
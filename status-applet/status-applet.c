@@ -20,14 +20,38 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
 #include <dbus/dbus-glib-lowlevel.h>
 #include <gconf/gconf-client.h>
 #include <gtk/gtk.h>
 #include <hildon/hildon.h>
 #include <libhildondesktop/libhildondesktop.h>
 #include <libosso.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+#include <icd/dbus_api.h>
 #include <icd/wireguard/libicd_wireguard_shared.h>
 
+#include "connstats.h"
+#include "gckeys.h"
+#include "history.h"
+#include "keepalive.h"
+#include "liveswitch.h"
+#include "mtu.h"
+#include "prewarm.h"
+#include "prober.h"
+#include "resolvcache.h"
+#include "speedtest.h"
+#include "tunnels.h"
+#include "tunstats.h"
+#include "wakeups.h"
+#include "watchdog.h"
+
 /* Use this for debugging */
 #include <syslog.h>
 #define status_debug(...) syslog(1, __VA_ARGS__)
@@ -38,7 +62,65 @@
 
 #define SETTINGS_RESPONSE -69
 
-#define DBUS_SIGNAL "type='signal',interface='"ICD_WIREGUARD_DBUS_INTERFACE"',member='"ICD_WIREGUARD_SIGNAL_STATUSCHANGED"'"
+/* How long to wait for the provider to answer GetStatus */
+#define GETSTATUS_TIMEOUT_MS 5000
+/* And to say whether it could set the keepalives */
+#define SETKEEPALIVE_TIMEOUT_MS 5000
+
+/* StatusChanged bursts are folded into one UI update per frame */
+#define STATUS_FRAME_MS 16
+
+/*
+ * Tunnel statistics are polled only while the menu is on screen, every
+ * second while traffic flows and less often while it is idle.
+ */
+#define STATS_POLL_MIN_MS 1000
+#define STATS_POLL_MAX_MS 8000
+
+/* Height of the traffic history sparkline */
+#define SPARKLINE_HEIGHT 48
+
+/* File to append every received StatusChanged to, for replaying later */
+#define SIGNAL_TRACE_ENV "WG_APPLET_SIGNAL_TRACE"
+
+/* The provider owns a bus name equal to its interface name */
+#define DBUS_SIGNAL "type='signal',sender='"ICD_WIREGUARD_DBUS_INTERFACE"',path='"ICD_WIREGUARD_DBUS_PATH"',interface='"ICD_WIREGUARD_DBUS_INTERFACE"',member='"ICD_WIREGUARD_SIGNAL_STATUSCHANGED"'"
+#define MCE_DISPLAY_SIGNAL "type='signal',path='"MCE_SIGNAL_PATH"',interface='"MCE_SIGNAL_IF"',member='"MCE_DISPLAY_SIG"'"
+
+/*
+ * Anyone on the system bus could send this, so it only has the applet
+ * write its statistics to syslog in builds configured for it.
+ */
+#ifdef ENABLE_DEBUG_DUMP
+#define DEBUG_DUMP_PATH "/org/maemo/wireguard/applet"
+#define DEBUG_DUMP_IF "org.maemo.wireguard.applet"
+#define DEBUG_DUMP_SIG "DumpStats"
+#define DEBUG_DUMP_SIGNAL "type='signal',path='"DEBUG_DUMP_PATH"',interface='"DEBUG_DUMP_IF"',member='"DEBUG_DUMP_SIG"'"
+#endif
+
+/* BME tells about the charger, there is no header for it */
+#define BME_SERVICE "com.nokia.bme"
+#define BME_REQUEST_PATH "/com/nokia/bme/request"
+#define BME_REQUEST_IF "com.nokia.bme.request"
+#define BME_STATUS_INFO_REQ "status_info_req"
+#define BME_SIGNAL_PATH "/com/nokia/bme/signal"
+#define BME_SIGNAL_IF "com.nokia.bme.signal"
+#define BME_CHARGER_CONNECTED "charger_connected"
+#define BME_CHARGER_DISCONNECTED "charger_disconnected"
+/* Only the two charger signals, BME sends plenty of others */
+#define BME_SIGNAL(member) "type='signal',path='"BME_SIGNAL_PATH"',interface='"BME_SIGNAL_IF"',member='"member"'"
+
+#define ICD_STATE_SIGNAL "type='signal',path='"ICD_DBUS_API_PATH"',interface='"ICD_DBUS_API_INTERFACE"',member='"ICD_DBUS_API_STATE_SIG"'"
+
+/* How often and how long to look for the tunnel coming back after a move */
+#define RECOVERY_POLL_MS 250
+#define RECOVERY_MAX_S 30
+/* Keepalive set for a moment on peers that have none, to send one */
+#define KICK_KEEPALIVE_S 25
+/* Peers to make room for at first, more get fetched if there are */
+#define KICK_PEERS 16
+/* Without netlink, nudge each peer with a datagram to the discard port */
+#define KICK_PORT 9
 
 typedef struct _StatusAppletWireguard StatusAppletWireguard;
 typedef struct _StatusAppletWireguardClass StatusAppletWireguardClass;
@@ -50,6 +132,33 @@ typedef enum {
 	WIREGUARD_CONNECTED = 2,
 } WireguardConnState;
 
+/* Points in time recorded while the applet starts up */
+enum startup_mark {
+	STARTUP_INIT = 0,
+	STARTUP_SETTINGS,
+	STARTUP_VISIBLE,
+	STARTUP_STATUS_QUERY,
+	STARTUP_ICONS,
+	STARTUP_PREFETCH,
+	STARTUP_DIALOG,
+	STARTUP_FIRST_STATUS,
+	N_STARTUP_MARKS
+};
+
+struct signal_stats {
+	guint received;
+	guint merged;
+	guint unchanged;
+	guint ui_updates;
+};
+
+/* The config picker shows a label, but hands out the config name */
+enum selector_column {
+	SELECTOR_NAME = 0,
+	SELECTOR_LABEL,
+	N_SELECTOR_COLUMNS
+};
+
 typedef enum {
 	STATUS_ICON_NONE,
 	STATUS_ICON_CONNECTING,
@@ -68,9 +177,31 @@ struct _StatusAppletWireguardClass {
 struct _StatusAppletWireguardPrivate {
 	osso_context_t *osso;
 	DBusConnection *dbus;
+	DBusPendingCall *status_call;
+	gboolean status_known;
+	DBusPendingCall *keepalive_call;
+
+	guint status_source;
+	WireguardConnState pending_state;
+	gboolean pending_provider;
+	/* A signal about the tunnel on wg0 is waiting for the frame end */
+	gboolean primary_pending;
+	struct tunnel_set tunnels;
+	struct signal_stats sigstats;
+	FILE *signal_trace;
+	gint64 last_traced;
 
 	gchar *active_config;
 	GtkWidget *menu_button;
+	/* When a config switch that needs a reconnect was asked for */
+	gint64 switch_start;
+	/* Switched to live, and not in gconf until the tunnel is down */
+	gchar *live_config;
+	struct prewarm prewarm;
+	/* When the provider started connecting, and if it found things warm */
+	gint64 connect_start;
+	gboolean connect_warm;
+	struct wg_mtu_probe *mtu_probe;
 
 	WireguardConnState connection_state;
 
@@ -81,13 +212,72 @@ struct _StatusAppletWireguardPrivate {
 	GtkWidget *wg_chkbtn;
 	GtkWidget *config_btn;
 	GtkWidget *touch_selector;
+	GPtrArray *config_names;
+	gboolean selector_stale;
+	struct wg_prober *prober;
+	gint64 tap_time;
+	/* Probing and prewarming, once the dialog is on screen */
+	guint warm_source;
 
 	GdkPixbuf *pix18_wg_connected;
 	GdkPixbuf *pix18_wg_connecting;
 	GdkPixbuf *pix48_wg_disabled;
 	GdkPixbuf *pix48_wg_enabled;
+	gboolean icons_loaded;
+	gboolean menu_icons_loaded;
+
+	GtkWidget *menu_image;
+	GdkPixbuf *menu_image_pixbuf;
+
+	struct tun_stats *tun_stats;
+	struct tun_sample last_sample;
+	/* Rates and handshake age shown after the state, NULL if none */
+	gchar *stats_value;
+	guint stats_source;
+	guint stats_interval;
+
+	struct history *history;
+	gchar *history_config;
+	struct tun_sample history_sample;
+	guint history_source;
+	GtkWidget *sparkline;
+	guint64 sparkline_bytes[HISTORY_SLOTS];
+	GtkWidget *conn_label;
+	GtkWidget *tunnels_label;
+	GtkWidget *speedtest_btn;
+	struct wg_speedtest *speedtest;
+
+	struct conn_machine conn;
+
+	struct watchdog watchdog;
+	gboolean degraded;
+
+	struct wg_keepalive keepalive;
+	/* Whether a peer of the active config has an adaptive keepalive */
+	gboolean keepalive_adaptive;
+	gboolean on_battery;
+
+	/* The network the underlying IAP is on, NULL until one connects */
+	gchar *bearer;
+	guint bearer_changes;
+	gint64 bearer_changed;
+	gint64 bearer_changed_real;
+	struct tun_sample recovery_base;
+	gboolean endpoints_updated;
+	guint recovery_source;
+	guint recovered;
+	gint64 recovery_sum_us;
+	gint64 recovery_max_us;
+	/* Configs we failed over from, to the monotonic time it happened */
+	GHashTable *failed_configs;
 
 	CurStatusIcon current_status_icon;
+	guint blink_source;
+	gboolean display_off;
+
+	guint init_source;
+	enum startup_mark startup_step;
+	gint64 startup_trace[N_STARTUP_MARKS];
 };
 
 HD_DEFINE_PLUGIN_MODULE_WITH_PRIVATE(StatusAppletWireguard,
@@ -95,25 +285,443 @@ HD_DEFINE_PLUGIN_MODULE_WITH_PRIVATE(StatusAppletWireguard,
 				     HD_TYPE_STATUS_MENU_ITEM);
 #define GET_PRIVATE(x) status_applet_wireguard_get_instance_private(x)
 
+static void dump_debug_stats(StatusAppletWireguardPrivate * p)
+{
+	gchar *dump = wakeup_dump();
+	gchar **lines, **line;
+
+	status_debug("wg-sb: %s", dump);
+	g_free(dump);
+
+	dump = conn_machine_dump(&p->conn);
+	lines = g_strsplit(dump, "\n", -1);
+	for (line = lines; *line; line++)
+		status_debug("wg-sb: %s", *line);
+	g_strfreev(lines);
+	g_free(dump);
+
+	status_debug("wg-sb: keepalive: %us (held %us, failed %us), "
+		     "%u backoffs%s", wg_keepalive_current(&p->keepalive),
+		     p->keepalive.good, p->keepalive.failed,
+		     p->keepalive.backoffs,
+		     p->keepalive.battery ? ", battery profile" : "");
+
+	status_debug("wg-sb: network changes: %u, recovered from %u in %"
+		     G_GINT64_FORMAT "ms (max %" G_GINT64_FORMAT "ms)",
+		     p->bearer_changes, p->recovered,
+		     p->recovered ? p->recovery_sum_us / p->recovered / 1000 : 0,
+		     p->recovery_max_us / 1000);
+
+	dump = prewarm_dump(&p->prewarm);
+	status_debug("wg-sb: %s", dump);
+	g_free(dump);
+
+	dump = tunnel_set_dump(&p->tunnels);
+	status_debug("wg-sb: %s", dump);
+	g_free(dump);
+
+	status_debug("wg-sb: StatusChanged: %u received, %u merged, "
+		     "%u unchanged, %u UI updates", p->sigstats.received,
+		     p->sigstats.merged, p->sigstats.unchanged,
+		     p->sigstats.ui_updates);
+}
+
+static void trace_startup(StatusAppletWireguardPrivate * p,
+			  enum startup_mark mark)
+{
+	if (p->startup_trace[mark] == 0)
+		p->startup_trace[mark] = g_get_monotonic_time();
+}
+
+/* NULL-terminated array of the peer endpoints of a config */
+static GPtrArray *config_endpoints(const gchar * config)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	GPtrArray *endpoints = g_ptr_array_new_with_free_func(g_free);
+	GSList *peers, *iter;
+	gchar *peers_path, *key, *endpoint;
+
+	peers_path = g_strjoin("/", GC_WIREGUARD, config, GC_PEERS, NULL);
+	peers = gconf_client_all_dirs(gconf, peers_path, NULL);
+
+	for (iter = peers; iter; iter = iter->next) {
+		key = g_strjoin("/", iter->data, GC_PEER_ENDPOINT, NULL);
+		endpoint = gconf_client_get_string(gconf, key, NULL);
+		if (endpoint != NULL)
+			g_ptr_array_add(endpoints, endpoint);
+		g_free(key);
+		g_free(iter->data);
+	}
+	g_slist_free(peers);
+
+	g_ptr_array_add(endpoints, NULL);
+
+	g_free(peers_path);
+	g_object_unref(gconf);
+
+	return endpoints;
+}
+
+/*
+ * Look up the hostnames of all endpoints of a config at once, so nothing
+ * in this process later has to wait for them one after another: live
+ * switching, MTU probing and endpoint updates. The provider resolves
+ * names itself when it connects, and that is no faster for this.
+ */
+static void prefetch_endpoints(const gchar * config)
+{
+	GPtrArray *endpoints = config_endpoints(config);
+	guint started;
+
+	started = wg_resolv_cache_prefetch(wg_resolv_cache_get_default(),
+					   (const gchar * const *)
+					   endpoints->pdata);
+	status_debug("wg-sb: %s: %u lookups for %s", G_STRFUNC, started,
+		     config);
+
+	g_ptr_array_free(endpoints, TRUE);
+}
+
+/* Get a config ready for a connect that is likely to follow */
+static void warm_up(StatusAppletWireguardPrivate * p, const gchar * config)
+{
+	GPtrArray *endpoints;
+
+	if (config == NULL)
+		return;
+
+	endpoints = config_endpoints(config);
+	prewarm_config(&p->prewarm, config,
+		       (const gchar * const *)endpoints->pdata,
+		       g_get_monotonic_time());
+	g_ptr_array_free(endpoints, TRUE);
+}
+
+/* The provider's method, as changing the interface takes CAP_NET_ADMIN */
+static DBusMessage *new_provider_call(const gchar * method)
+{
+	return dbus_message_new_method_call(ICD_WIREGUARD_DBUS_INTERFACE,
+					    ICD_WIREGUARD_DBUS_PATH,
+					    ICD_WIREGUARD_DBUS_INTERFACE,
+					    method);
+}
+
+/* Nothing can be done about it failing, so nothing waits for a reply */
+static void set_tunnel_mtu(StatusAppletWireguardPrivate * p, guint mtu)
+{
+	dbus_uint32_t value = mtu;
+	DBusMessage *msg;
+
+	if (p->dbus == NULL)
+		return;
+
+	msg = new_provider_call(ICD_WIREGUARD_METHOD_SETMTU);
+	if (msg == NULL)
+		return;
+
+	dbus_message_set_no_reply(msg, TRUE);
+	if (dbus_message_append_args(msg, DBUS_TYPE_UINT32, &value,
+				     DBUS_TYPE_INVALID))
+		dbus_connection_send(p->dbus, msg, NULL);
+	dbus_message_unref(msg);
+
+	status_debug("wg-sb: %s: MTU %u", G_STRFUNC, mtu);
+}
+
+static void mtu_probe_done_cb(gint mtu, gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+
+	p->mtu_probe = NULL;
+	set_tunnel_mtu(p, mtu);
+}
+
+/*
+ * Give the tunnel the MTU its config asks for. In auto mode that is what
+ * the path to the first endpoint we have an address for takes, right
+ * away from what the kernel knows and then refined by probing.
+ */
+static void apply_mtu(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	GConfClient *gconf = gconf_client_get_default();
+	struct sockaddr_storage ss;
+	socklen_t len = 0;
+	GPtrArray *endpoints;
+	gchar *key, *file;
+	gint mtu;
+	guint i;
+
+	wg_mtu_probe_cancel(p->mtu_probe);
+	p->mtu_probe = NULL;
+
+	if (p->active_config == NULL) {
+		g_object_unref(gconf);
+		return;
+	}
+
+	/* Config files carry their own MTU */
+	key = g_strjoin("/", GC_WIREGUARD, p->active_config,
+			GC_CONFIG_FILE_OVERRIDE, NULL);
+	file = gconf_client_get_string(gconf, key, NULL);
+	g_free(key);
+
+	key = g_strjoin("/", GC_WIREGUARD, p->active_config, GC_CFG_MTU, NULL);
+	mtu = gconf_client_get_int(gconf, key, NULL);
+	g_free(key);
+	g_object_unref(gconf);
+
+	if (file) {
+		g_free(file);
+		return;
+	}
+
+	if (mtu != WG_MTU_AUTO) {
+		set_tunnel_mtu(p, mtu);
+		return;
+	}
+
+	endpoints = config_endpoints(p->active_config);
+	for (i = 0; endpoints->pdata[i] && len == 0; i++)
+		if (!wg_resolv_cache_sockaddr(wg_resolv_cache_get_default(),
+					      endpoints->pdata[i], &ss, &len))
+			len = 0;
+	g_ptr_array_free(endpoints, TRUE);
+
+	if (len == 0)
+		return;
+
+	mtu = wg_mtu_path((struct sockaddr *)&ss, len);
+	if (mtu > 0)
+		set_tunnel_mtu(p, wg_mtu_for_link(mtu, ss.ss_family));
+
+	p->mtu_probe = wg_mtu_probe_start((struct sockaddr *)&ss, len,
+					  mtu_probe_done_cb, self);
+}
+
+static void cancel_keepalive_call(StatusAppletWireguardPrivate * p)
+{
+	if (p->keepalive_call) {
+		dbus_pending_call_cancel(p->keepalive_call);
+		dbus_pending_call_unref(p->keepalive_call);
+		p->keepalive_call = NULL;
+	}
+}
+
+/*
+ * A provider that can't set the keepalives leaves its own in place, and
+ * handshakes at an interval never set would teach the adaptive one
+ * nonsense, so it isn't learnt then.
+ */
+static void keepalive_reply_cb(DBusPendingCall * pending, gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	DBusMessage *msg;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_DBUS_REPLY);
+
+	msg = dbus_pending_call_steal_reply(pending);
+	dbus_pending_call_unref(p->keepalive_call);
+	p->keepalive_call = NULL;
+
+	if (msg && dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_ERROR) {
+		status_debug("wg-sb: %s: %s", G_STRFUNC,
+			     dbus_message_get_error_name(msg));
+		p->keepalive_adaptive = FALSE;
+	}
+
+	if (msg)
+		dbus_message_unref(msg);
+	wakeup_end(&w);
+}
+
+/*
+ * Have the provider give the peers of the active config the keepalive
+ * they are configured with, the adaptive ones the interval learnt so
+ * far. Config files carry their own keepalives.
+ */
+static void apply_keepalive(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	const struct wg_blob_peer *bp = NULL;
+	const struct wg_blob *blob;
+	struct wg_blob *loaded = NULL;
+	GConfClient *gconf;
+	GPtrArray *keys;
+	GArray *seconds;
+	DBusMessage *msg;
+	dbus_uint32_t value;
+	gchar **key_data;
+	dbus_uint32_t *seconds_data;
+
+	cancel_keepalive_call(p);
+	p->keepalive_adaptive = FALSE;
+
+	if (p->active_config == NULL || p->dbus == NULL)
+		return;
+
+	blob = prewarm_blob(&p->prewarm, p->active_config);
+	if (blob == NULL) {
+		gconf = gconf_client_get_default();
+		blob = loaded = wg_blob_load(gconf, p->active_config);
+		g_object_unref(gconf);
+	}
+
+	if (blob == NULL)
+		return;
+
+	keys = g_ptr_array_new_with_free_func(g_free);
+	seconds = g_array_new(FALSE, FALSE, sizeof(dbus_uint32_t));
+
+	while ((bp = wg_blob_next_peer(blob, bp))) {
+		if (bp->keepalive == WG_KEEPALIVE_OFF)
+			continue;
+
+		if (bp->keepalive == WG_KEEPALIVE_ADAPTIVE) {
+			value = wg_keepalive_current(&p->keepalive);
+			p->keepalive_adaptive = TRUE;
+		} else {
+			value = bp->keepalive;
+		}
+
+		g_ptr_array_add(keys, g_base64_encode(bp->public_key,
+						      WG_KEY_LEN));
+		g_array_append_val(seconds, value);
+	}
+
+	msg = keys->len ? new_provider_call(ICD_WIREGUARD_METHOD_SETKEEPALIVE)
+	    : NULL;
+	key_data = (gchar **) keys->pdata;
+	seconds_data = (dbus_uint32_t *) seconds->data;
+
+	if (msg && dbus_message_append_args(msg, DBUS_TYPE_ARRAY,
+					    DBUS_TYPE_STRING, &key_data,
+					    (int)keys->len, DBUS_TYPE_ARRAY,
+					    DBUS_TYPE_UINT32, &seconds_data,
+					    (int)seconds->len,
+					    DBUS_TYPE_INVALID)
+	    && dbus_connection_send_with_reply(p->dbus, msg,
+					       &p->keepalive_call,
+					       SETKEEPALIVE_TIMEOUT_MS)
+	    && p->keepalive_call) {
+		if (!dbus_pending_call_set_notify(p->keepalive_call,
+						  keepalive_reply_cb, self,
+						  NULL))
+			cancel_keepalive_call(p);
+
+		status_debug("wg-sb: %s: %u peers, adaptive %us", G_STRFUNC,
+			     keys->len, wg_keepalive_current(&p->keepalive));
+	} else if (keys->len) {
+		status_debug("wg-sb: OOM at %s:%s", G_STRFUNC, G_STRLOC);
+		p->keepalive_adaptive = FALSE;
+	}
+
+	if (msg)
+		dbus_message_unref(msg);
+	g_ptr_array_free(keys, TRUE);
+	g_array_free(seconds, TRUE);
+	wg_blob_free(loaded);
+}
+
+/*
+ * Try to move the running tunnel to another config by changing only its
+ * peers, and return whether that worked. If not, the provider reconnects
+ * once the active config changes, and the time until it is up again is
+ * logged.
+ */
+static gboolean switch_config(StatusAppletWireguard * self,
+			      const gchar * from, const gchar * to)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	gint64 start = g_get_monotonic_time();
+	int ret;
+
+	/* Nothing is running, the next connect just uses the new config */
+	if (p->connection_state != WIREGUARD_CONNECTED || p->provider_connected)
+		return FALSE;
+
+	ret = live_switch(from, to, prewarm_blob(&p->prewarm, to), WG_IFNAME);
+
+	if (ret == 0) {
+		prewarm_connected(&p->prewarm,
+				  prewarm_hit(&p->prewarm, to, start),
+				  g_get_monotonic_time() - start);
+		status_debug("wg-sb: %s: %s -> %s live in %" G_GINT64_FORMAT
+			     "us", G_STRFUNC, from, to,
+			     g_get_monotonic_time() - start);
+		p->switch_start = 0;
+		/* The interface stays, but the new config may want another MTU */
+		apply_mtu(self);
+		apply_keepalive(self);
+		return TRUE;
+	}
+
+	status_debug("wg-sb: %s: %s -> %s needs a reconnect: %s", G_STRFUNC,
+		     from, to, g_strerror(-ret));
+	p->switch_start = start;
+	return FALSE;
+}
+
+/*
+ * The provider reconnects whenever the active config in gconf changes,
+ * so a config switched to live is only written there once the tunnel
+ * is down, or the applet goes away.
+ */
+static void save_live_config(StatusAppletWireguardPrivate * p)
+{
+	GConfClient *gconf;
+
+	if (p->live_config == NULL)
+		return;
+
+	gconf = gconf_client_get_default();
+	gconf_client_set_string(gconf, GC_WIREGUARD_ACTIVE, p->live_config,
+				NULL);
+	g_object_unref(gconf);
+
+	g_free(p->live_config);
+	p->live_config = NULL;
+}
+
 static void save_settings(StatusAppletWireguard * self)
 {
 	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
 	GConfClient *gconf = gconf_client_get_default();
 	gboolean new_systemwide_enabled;
-	gchar *saved_config;
+	gchar *saved_config, *new_config, *running;
 
 	saved_config =
 	    gconf_client_get_string(gconf, GC_WIREGUARD_ACTIVE, NULL);
 	if (saved_config == NULL)
 		goto out;
 
-	p->active_config =
+	new_config =
 	    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
 						   (p->touch_selector));
+	if (new_config != NULL) {
+		g_free(p->active_config);
+		p->active_config = new_config;
+	}
 
-	if (g_strcmp0(saved_config, p->active_config))
-		gconf_client_set_string(gconf, GC_WIREGUARD_ACTIVE,
-					p->active_config, NULL);
+	/* The tunnel may run a config gconf doesn't know about yet */
+	running = p->live_config ? p->live_config : saved_config;
+
+	if (g_strcmp0(running, p->active_config)) {
+		tunnel_set_rename(&p->tunnels, running, p->active_config);
+		if (switch_config(self, running, p->active_config)) {
+			g_free(p->live_config);
+			p->live_config = g_strcmp0(saved_config,
+						   p->active_config) ?
+			    g_strdup(p->active_config) : NULL;
+		} else {
+			g_free(p->live_config);
+			p->live_config = NULL;
+			gconf_client_set_string(gconf, GC_WIREGUARD_ACTIVE,
+						p->active_config, NULL);
+		}
+		prefetch_endpoints(p->active_config);
+	}
 
 	new_systemwide_enabled =
 	    hildon_check_button_get_active(HILDON_CHECK_BUTTON(p->wg_chkbtn));
@@ -125,6 +733,7 @@ static void save_settings(StatusAppletWireguard * self)
 	}
 
  out:
+	g_free(saved_config);
 	g_object_unref(gconf);
 }
 
@@ -134,6 +743,10 @@ static void execute_cp_plugin(GtkWidget * btn, StatusAppletWireguard * self)
 	GtkWidget *toplevel = gtk_widget_get_toplevel(GTK_WIDGET(self));
 	gtk_widget_hide(toplevel);
 
+	/* Only needed for this, so don't pay for it at startup */
+	if (p->osso == NULL)
+		p->osso = osso_initialize("wg-sb", VERSION, FALSE, NULL);
+
 	if (osso_cp_plugin_execute
 	    (p->osso, "control-applet-wireguard.so", self, TRUE)
 	    == OSSO_ERROR) {
@@ -152,220 +765,1872 @@ static void set_buttons_sensitivity(StatusAppletWireguard * obj, gboolean state)
 	}
 }
 
-static void status_menu_clicked_cb(GtkWidget * btn,
-				   StatusAppletWireguard * self)
+static void load_config_names(StatusAppletWireguardPrivate * p)
 {
-	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
-	GtkWidget *toplevel = gtk_widget_get_toplevel(btn);
 	GConfClient *gconf = gconf_client_get_default();
-	GtkSizeGroup *size_group;
-
-	gtk_widget_hide(toplevel);
-
-	p->settings_dialog = hildon_dialog_new_with_buttons("Wireguard",
-							    GTK_WINDOW
-							    (toplevel),
-							    GTK_DIALOG_MODAL |
-							    GTK_DIALOG_DESTROY_WITH_PARENT,
-							    "Settings",
-							    SETTINGS_RESPONSE,
-							    GTK_STOCK_SAVE,
-							    GTK_RESPONSE_ACCEPT,
-							    NULL);
-
-	p->wg_chkbtn =
-	    hildon_check_button_new(HILDON_SIZE_FINGER_HEIGHT |
-				    HILDON_SIZE_AUTO_WIDTH);
-
-	gtk_button_set_label(GTK_BUTTON(p->wg_chkbtn),
-			     "Enable system-wide tunneling");
-
-	size_group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
-	p->touch_selector = hildon_touch_selector_new_text();
+	GSList *configs, *iter;
 
-	p->config_btn = hildon_picker_button_new(HILDON_SIZE_FINGER_HEIGHT, 0);
-	hildon_picker_button_set_selector(HILDON_PICKER_BUTTON(p->config_btn),
-					  HILDON_TOUCH_SELECTOR
-					  (p->touch_selector));
-	hildon_button_set_title(HILDON_BUTTON(p->config_btn),
-				"Current configuration");
-	hildon_button_set_alignment(HILDON_BUTTON(p->config_btn), 0.0, 0.5, 1.0,
-				    1.0);
+	if (p->config_names)
+		g_ptr_array_free(p->config_names, TRUE);
 
-	/* Fill the selector with available configs */
-	hildon_check_button_set_active(HILDON_CHECK_BUTTON(p->wg_chkbtn),
-				       gconf_client_get_bool(gconf,
-							     GC_WIREGUARD_SYSTEM,
-							     NULL));
+	p->config_names = g_ptr_array_new_with_free_func(g_free);
 
-	GSList *configs, *iter;
 	configs = gconf_client_all_dirs(gconf, GC_WIREGUARD, NULL);
-
-	/* Counter for figuring out the active config */
-	int i = -1;
 	for (iter = configs; iter; iter = iter->next) {
-		i++;
-		hildon_touch_selector_append_text(HILDON_TOUCH_SELECTOR
-						  (p->touch_selector),
-						  g_path_get_basename
-						  (iter->data));
-
-        if (p->active_config == NULL) {
-            status_debug("status_menu_clicked_cb: p->active_config == NULL");
-        } else {
-		if (!strcmp(g_path_get_basename(iter->data), p->active_config))
-			hildon_touch_selector_set_active(HILDON_TOUCH_SELECTOR
-							 (p->touch_selector), 0,
-							 i);
-        }
-
+		g_ptr_array_add(p->config_names, g_path_get_basename(iter->data));
 		g_free(iter->data);
 	}
-	g_slist_free(iter);
 	g_slist_free(configs);
+	g_object_unref(gconf);
 
-	hildon_button_add_title_size_group(HILDON_BUTTON(p->config_btn),
-					   size_group);
+	p->selector_stale = TRUE;
+}
 
-	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
-			   p->wg_chkbtn, TRUE, TRUE, 0);
-	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
-			   p->config_btn, TRUE, TRUE, 0);
+/*
+ * The control panel plugin runs to completion in execute_cp_plugin(), and
+ * configs may be added or removed, or the system-wide switch flipped in
+ * there. Catch up once it returns.
+ */
+static void reload_after_cp_plugin(StatusAppletWireguardPrivate * p)
+{
+	GConfClient *gconf = gconf_client_get_default();
 
-	/* Make the buttons insensitive when provider is connected. */
-	set_buttons_sensitivity(self, !p->provider_connected);
+	p->systemwide_enabled =
+	    gconf_client_get_bool(gconf, GC_WIREGUARD_SYSTEM, NULL);
+	g_object_unref(gconf);
 
-	gtk_widget_show_all(p->settings_dialog);
-	switch (gtk_dialog_run(GTK_DIALOG(p->settings_dialog))) {
-	case GTK_RESPONSE_ACCEPT:
-		save_settings(self);
-		break;
-	case SETTINGS_RESPONSE:
-		execute_cp_plugin(btn, self);
-	default:
-		break;
-	}
+	load_config_names(p);
+}
 
-	g_object_unref(gconf);
-	gtk_widget_hide_all(p->settings_dialog);
-	gtk_widget_destroy(p->settings_dialog);
+static void settings_dialog_destroyed_cb(GtkWidget * dialog, gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	(void)dialog;
 
+	p->settings_dialog = NULL;
 	p->wg_chkbtn = NULL;
 	p->config_btn = NULL;
+	p->touch_selector = NULL;
+	p->sparkline = NULL;
+	p->conn_label = NULL;
+	p->tunnels_label = NULL;
+	p->speedtest_btn = NULL;
 }
 
-static void set_status_icon(gpointer obj, GdkPixbuf * pixbuf)
+/* Traffic of the last day of the config picked in the selector */
+static gboolean sparkline_expose_cb(GtkWidget * widget, GdkEventExpose * ev,
+				    StatusAppletWireguard * self)
 {
-	hd_status_plugin_item_set_status_area_icon(HD_STATUS_PLUGIN_ITEM(obj),
-						   pixbuf);
-}
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	guint64 *bytes = p->sparkline_bytes;
+	guint64 max = 0, col;
+	struct history *h;
+	gchar *config;
+	gint width, height, x;
+	guint i, from, to;
+	cairo_t *cr;
 
-static int blink_status_icon(gpointer obj)
-{
-	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(obj);
-	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
+	(void)ev;
 
-	if (p->connection_state != WIREGUARD_CONNECTING)
+	config =
+	    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
+						   (p->touch_selector));
+	if (config == NULL)
 		return FALSE;
 
-	switch (p->current_status_icon) {
-	case STATUS_ICON_NONE:
-	case STATUS_ICON_CONNECTED:
-		set_status_icon(obj, p->pix18_wg_connecting);
-		p->current_status_icon = STATUS_ICON_CONNECTING;
-		break;
-	case STATUS_ICON_CONNECTING:
-		set_status_icon(obj, p->pix18_wg_connected);
-		p->current_status_icon = STATUS_ICON_CONNECTED;
-		break;
+	if (p->history && !g_strcmp0(config, p->history_config)) {
+		history_read(p->history, g_get_real_time() / G_USEC_PER_SEC,
+			     bytes, HISTORY_SLOTS);
+	} else if ((h = history_open(config))) {
+		history_read(h, g_get_real_time() / G_USEC_PER_SEC, bytes,
+			     HISTORY_SLOTS);
+		history_close(h);
+	} else {
+		memset(bytes, 0, sizeof(p->sparkline_bytes));
 	}
+	g_free(config);
 
-	return TRUE;
-}
+	for (i = 0; i < HISTORY_SLOTS; i++)
+		max = MAX(max, bytes[i]);
+	if (max == 0)
+		return FALSE;
 
-static void status_applet_wireguard_set_icons(StatusAppletWireguard * self)
-{
-	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(self);
-	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
-	GdkPixbuf *menu_pixbuf = NULL;
+	width = widget->allocation.width;
+	height = widget->allocation.height;
 
-	switch (p->connection_state) {
-	case WIREGUARD_NOT_CONNECTED:
-		menu_pixbuf = p->pix48_wg_disabled;
-		hildon_button_set_value(HILDON_BUTTON(p->menu_button),
-					"Disconnected");
-		set_status_icon(self, NULL);
-		p->current_status_icon = STATUS_ICON_NONE;
+	cr = gdk_cairo_create(widget->window);
+	gdk_cairo_set_source_color(cr, &widget->style->fg[GTK_STATE_NORMAL]);
+	cairo_set_line_width(cr, 1.0);
+
+	/* One column per pixel, showing the busiest minute it covers */
+	for (x = 0; x < width; x++) {
+		from = (guint64) x * HISTORY_SLOTS / width;
+		to = MAX(from + 1, (guint64) (x + 1) * HISTORY_SLOTS / width);
+
+		for (col = 0, i = from; i < to; i++)
+			col = MAX(col, bytes[i]);
+
+		if (x == 0)
+			cairo_move_to(cr, x + 0.5,
+				      height - (gdouble) col * height / max);
+		else
+			cairo_line_to(cr, x + 0.5,
+				      height - (gdouble) col * height / max);
+	}
+
+	cairo_stroke(cr);
+	cairo_destroy(cr);
+
+	return FALSE;
+}
+
+/* What the last probe of a config found, NULL if it wasn't probed */
+static gchar *latency_text(StatusAppletWireguardPrivate * p,
+			   const gchar * config)
+{
+	const struct wg_probe_result *res;
+
+	res = p->prober && config ? wg_prober_lookup(p->prober, config) : NULL;
+	if (res == NULL)
+		return NULL;
+
+	if (res->rtt_us >= 0)
+		return g_strdup_printf("Latency %" G_GINT64_FORMAT " ms",
+				       (res->rtt_us + 500) / 1000);
+
+	return g_strdup(res->unmeasured ? "Latency unmeasured" :
+			"Unreachable");
+}
+
+/* How connecting with the highlighted config went so far */
+static void update_conn_label(StatusAppletWireguardPrivate * p)
+{
+	gchar *config, *summary, *latency, *text;
+
+	config =
+	    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
+						   (p->touch_selector));
+	summary = conn_machine_summary(&p->conn, config);
+	latency = latency_text(p, config);
+
+	text = g_strjoin("\n", summary ? summary : "No connections yet",
+			 latency, NULL);
+	gtk_label_set_text(GTK_LABEL(p->conn_label), text);
+
+	g_free(text);
+	g_free(latency);
+	g_free(summary);
+	g_free(config);
+}
+
+static const gchar *state_label(enum conn_state state)
+{
+	switch (state) {
+	case CONN_CONNECTING:
+		return "Connecting";
+	case CONN_UP:
+		return "Connected";
+	default:
+		return "Disconnected";
+	}
+}
+
+/* One row per tunnel that is not down, hidden when there are none */
+static void update_tunnel_rows(StatusAppletWireguardPrivate * p)
+{
+	GString *rows;
+	struct tunnel *t;
+	guint i;
+
+	if (p->tunnels_label == NULL)
+		return;
+
+	rows = g_string_new(NULL);
+	for (i = 0; i < p->tunnels.tunnels->len; i++) {
+		t = tunnel_set_nth(&p->tunnels, i);
+		if (t->state == CONN_DOWN)
+			continue;
+
+		g_string_append_printf(rows, "%s%s: %s%s", rows->len ? "\n" : "",
+				       *t->config ? t->config : "Wireguard",
+				       state_label(t->state),
+				       t->provider ? " (provider)" : "");
+	}
+
+	gtk_label_set_text(GTK_LABEL(p->tunnels_label), rows->str);
+	gtk_widget_set_visible(p->tunnels_label, rows->len > 0);
+	g_string_free(rows, TRUE);
+}
+
+static void selector_changed_cb(HildonTouchSelector * selector, gint column,
+				StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	gchar *config;
+
+	(void)selector;
+	(void)column;
+
+	gtk_widget_queue_draw(p->sparkline);
+	update_conn_label(p);
+
+	/* Picking a config is a hint it is about to be used */
+	if (gtk_widget_get_visible(p->settings_dialog)) {
+		config =
+		    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
+							   (p->touch_selector));
+		warm_up(p, config);
+		g_free(config);
+	}
+}
+
+/* The speed test host of a config, which has to be an address */
+static gboolean speedtest_address(const gchar * config,
+				  struct sockaddr_storage *ss, socklen_t * len)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+	struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+	gboolean found = TRUE;
+	gchar *key, *host;
+
+	key = g_strjoin("/", GC_WIREGUARD, config, GC_CFG_SPEEDTEST, NULL);
+	host = gconf_client_get_string(gconf, key, NULL);
+	g_free(key);
+	g_object_unref(gconf);
+
+	if (host == NULL)
+		return FALSE;
+
+	memset(ss, 0, sizeof(*ss));
+	if (inet_pton(AF_INET, host, &sin->sin_addr) == 1) {
+		sin->sin_family = AF_INET;
+		*len = sizeof(*sin);
+	} else if (inet_pton(AF_INET6, host, &sin6->sin6_addr) == 1) {
+		sin6->sin6_family = AF_INET6;
+		*len = sizeof(*sin6);
+	} else {
+		found = FALSE;
+	}
+
+	g_free(host);
+	return found;
+}
+
+static void speedtest_done_cb(const struct wg_speedtest_result *r,
+			      gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	gchar *value;
+
+	p->speedtest = NULL;
+
+	status_debug("wg-sb: speed test: down %.1f Mbit/s, up %.1f Mbit/s, "
+		     "process cpu %.0f%%, %s", r->down_mbps, r->up_mbps,
+		     r->cpu_percent, r->error ? g_strerror(-r->error) : "ok");
+
+	if (r->down_bytes == 0 && r->up_bytes == 0)
+		value = g_strdup_printf("Failed: %s",
+					r->error ? g_strerror(-r->error) :
+					"nothing came through");
+	else
+		value = g_strdup_printf("Down %.1f, up %.1f Mbit/s, "
+					"process CPU %.0f%%", r->down_mbps,
+					r->up_mbps, r->cpu_percent);
+
+	if (p->speedtest_btn)
+		hildon_button_set_value(HILDON_BUTTON(p->speedtest_btn), value);
+	g_free(value);
+}
+
+/*
+ * Measure the tunnel against the discard and chargen services of the
+ * host set for the active config, which traffic reaches through wg0.
+ */
+static void speedtest_clicked_cb(GtkWidget * btn, StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	const gchar *value = "Running";
+	struct sockaddr_storage ss;
+	socklen_t len;
+
+	if (p->speedtest)
+		return;
+
+	if (p->connection_state != WIREGUARD_CONNECTED) {
+		value = "Connect first";
+	} else if (!speedtest_address(p->active_config, &ss, &len)) {
+		value = "No test host set for this configuration";
+	} else {
+		p->speedtest = wg_speedtest_start((struct sockaddr *)&ss, len,
+						  WG_SPEEDTEST_DISCARD_PORT,
+						  WG_SPEEDTEST_CHARGEN_PORT,
+						  WG_SPEEDTEST_SECONDS,
+						  speedtest_done_cb, self);
+		if (p->speedtest == NULL)
+			value = "Unable to start";
+	}
+
+	hildon_button_set_value(HILDON_BUTTON(btn), value);
+}
+
+/* Measured configs by latency, the others by name after them */
+static gint compare_latency(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return wg_prober_compare(data, *(const gchar **)a, *(const gchar **)b);
+}
+
+/*
+ * Configs whose peers only got UDP probes that nobody answered are not
+ * ranked, and say so, rather than look like they were measured slow.
+ */
+static gchar *selector_label(StatusAppletWireguardPrivate * p,
+			     const gchar * config)
+{
+	const struct wg_probe_result *res;
+
+	res = p->prober ? wg_prober_lookup(p->prober, config) : NULL;
+	if (res && res->rtt_us < 0 && res->unmeasured)
+		return g_strdup_printf("%s (unmeasured)", config);
+
+	return g_strdup(config);
+}
+
+/* Fill the selector, fastest configs first, and select the given one */
+static void fill_selector(StatusAppletWireguardPrivate * p,
+			  const gchar * select)
+{
+	HildonTouchSelector *selector = HILDON_TOUCH_SELECTOR(p->touch_selector);
+	GtkListStore *store;
+	gchar *label;
+	guint i;
+
+	if (p->selector_stale) {
+		if (p->prober)
+			g_ptr_array_sort_with_data(p->config_names,
+						   compare_latency, p->prober);
+
+		store =
+		    GTK_LIST_STORE(hildon_touch_selector_get_model(selector, 0));
+		gtk_list_store_clear(store);
+		for (i = 0; i < p->config_names->len; i++) {
+			label = selector_label(p, p->config_names->pdata[i]);
+			gtk_list_store_insert_with_values(store, NULL, i,
+							  SELECTOR_NAME,
+							  p->config_names->
+							  pdata[i],
+							  SELECTOR_LABEL, label,
+							  -1);
+			g_free(label);
+		}
+		p->selector_stale = FALSE;
+	}
+
+	for (i = 0; select && i < p->config_names->len; i++) {
+		if (!strcmp(p->config_names->pdata[i], select)) {
+			hildon_touch_selector_set_active(selector, 0, i);
+			break;
+		}
+	}
+}
+
+static void probes_done_cb(gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	gchar *current;
+
+	p->selector_stale = TRUE;
+
+	/* Re-sort right away if the user is looking at the list */
+	if (p->settings_dialog && gtk_widget_get_visible(p->settings_dialog)) {
+		current =
+		    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
+							   (p->touch_selector));
+		fill_selector(p, current);
+		update_conn_label(p);
+		g_free(current);
+	}
+}
+
+/* Measure the configs whose latency isn't known or is out of date */
+static void probe_configs(StatusAppletWireguardPrivate * p, gpointer self)
+{
+	GPtrArray *endpoints;
+	const gchar *name;
+	guint i, j;
+
+	if (p->prober == NULL)
+		p->prober = wg_prober_new();
+
+	for (i = 0; i < p->config_names->len; i++) {
+		name = p->config_names->pdata[i];
+		if (wg_prober_is_fresh(p->prober, name))
+			continue;
+
+		endpoints = config_endpoints(name);
+		for (j = 0; endpoints->pdata[j]; j++)
+			wg_prober_add(p->prober, name, endpoints->pdata[j]);
+		g_ptr_array_free(endpoints, TRUE);
+	}
+
+	wg_prober_run(p->prober, probes_done_cb, self);
+}
+
+/*
+ * Probing the configs and warming up the likely ones reads gconf and
+ * loads blobs, so it waits until the dialog is on screen.
+ */
+static gboolean dialog_warm_cb(gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	gchar *highlighted;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_PREWARM);
+	p->warm_source = 0;
+
+	if (p->settings_dialog && gtk_widget_get_visible(p->settings_dialog)) {
+		probe_configs(p, data);
+
+		/* A connect may follow, with the active or the highlighted one */
+		warm_up(p, p->active_config);
+		highlighted =
+		    hildon_touch_selector_get_current_text(HILDON_TOUCH_SELECTOR
+							   (p->touch_selector));
+		if (g_strcmp0(highlighted, p->active_config))
+			warm_up(p, highlighted);
+		g_free(highlighted);
+	}
+
+	wakeup_end(&w);
+	return FALSE;
+}
+
+static gboolean settings_dialog_mapped_cb(GtkWidget * dialog,
+					  GdkEvent * event, gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	(void)dialog;
+	(void)event;
+
+	if (p->tap_time) {
+		status_debug("wg-sb: tap-to-visible %" G_GINT64_FORMAT "us",
+			     g_get_monotonic_time() - p->tap_time);
+		p->tap_time = 0;
+		dump_debug_stats(p);
+	}
+
+	/* Idle, so the first frame is drawn before any of that */
+	if (p->warm_source == 0)
+		p->warm_source = g_idle_add(dialog_warm_cb, data);
+
+	return FALSE;
+}
+
+/*
+ * The dialog is built once and then only hidden and shown again, as
+ * building the Hildon widgets is most of the time a tap takes.
+ */
+static void build_settings_dialog(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	GtkSizeGroup *size_group;
+	GtkListStore *store;
+	GtkCellRenderer *renderer;
+	HildonTouchSelectorColumn *column;
+
+	if (p->settings_dialog)
+		return;
+
+	p->settings_dialog = hildon_dialog_new_with_buttons("Wireguard", NULL,
+							    GTK_DIALOG_MODAL,
+							    "Settings",
+							    SETTINGS_RESPONSE,
+							    GTK_STOCK_SAVE,
+							    GTK_RESPONSE_ACCEPT,
+							    NULL);
+
+	p->wg_chkbtn =
+	    hildon_check_button_new(HILDON_SIZE_FINGER_HEIGHT |
+				    HILDON_SIZE_AUTO_WIDTH);
+
+	gtk_button_set_label(GTK_BUTTON(p->wg_chkbtn),
+			     "Enable system-wide tunneling");
+
+	size_group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	store = gtk_list_store_new(N_SELECTOR_COLUMNS, G_TYPE_STRING,
+				   G_TYPE_STRING);
+	renderer = gtk_cell_renderer_text_new();
+	p->touch_selector = hildon_touch_selector_new();
+	column =
+	    hildon_touch_selector_append_column(HILDON_TOUCH_SELECTOR
+						(p->touch_selector),
+						GTK_TREE_MODEL(store), renderer,
+						"text", SELECTOR_LABEL, NULL);
+	hildon_touch_selector_column_set_text_column(column, SELECTOR_NAME);
+	g_object_unref(store);
+
+	p->config_btn = hildon_picker_button_new(HILDON_SIZE_FINGER_HEIGHT, 0);
+	hildon_picker_button_set_selector(HILDON_PICKER_BUTTON(p->config_btn),
+					  HILDON_TOUCH_SELECTOR
+					  (p->touch_selector));
+	hildon_button_set_title(HILDON_BUTTON(p->config_btn),
+				"Current configuration");
+	hildon_button_set_alignment(HILDON_BUTTON(p->config_btn), 0.0, 0.5, 1.0,
+				    1.0);
+
+	hildon_button_add_title_size_group(HILDON_BUTTON(p->config_btn),
+					   size_group);
+	g_object_unref(size_group);
+
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->wg_chkbtn, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->config_btn, TRUE, TRUE, 0);
+
+	p->sparkline = gtk_drawing_area_new();
+	gtk_widget_set_size_request(p->sparkline, -1, SPARKLINE_HEIGHT);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->sparkline, FALSE, FALSE, 0);
+
+	p->conn_label = gtk_label_new(NULL);
+	gtk_misc_set_alignment(GTK_MISC(p->conn_label), 0.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->conn_label, FALSE, FALSE, 0);
+
+	p->tunnels_label = gtk_label_new(NULL);
+	gtk_misc_set_alignment(GTK_MISC(p->tunnels_label), 0.0, 0.5);
+	gtk_widget_set_no_show_all(p->tunnels_label, TRUE);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->tunnels_label, FALSE, FALSE, 0);
+
+	p->speedtest_btn =
+	    hildon_button_new_with_text(HILDON_SIZE_FINGER_HEIGHT,
+					HILDON_BUTTON_ARRANGEMENT_VERTICAL,
+					"Speed test", NULL);
+	hildon_button_set_alignment(HILDON_BUTTON(p->speedtest_btn), 0.0, 0.5,
+				    1.0, 1.0);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(p->settings_dialog)->vbox),
+			   p->speedtest_btn, FALSE, FALSE, 0);
+
+	g_signal_connect(p->sparkline, "expose-event",
+			 G_CALLBACK(sparkline_expose_cb), self);
+	g_signal_connect(p->touch_selector, "changed",
+			 G_CALLBACK(selector_changed_cb), self);
+	g_signal_connect(p->speedtest_btn, "clicked",
+			 G_CALLBACK(speedtest_clicked_cb), self);
+
+	g_signal_connect(p->settings_dialog, "delete-event",
+			 G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+	g_signal_connect(p->settings_dialog, "map-event",
+			 G_CALLBACK(settings_dialog_mapped_cb), self);
+	g_signal_connect(p->settings_dialog, "destroy",
+			 G_CALLBACK(settings_dialog_destroyed_cb), self);
+
+	p->selector_stale = TRUE;
+}
+
+/*
+ * Bring the dialog in line with what we know, without asking gconf; the
+ * config names are read at startup, unless the tap came first.
+ */
+static void refresh_settings_dialog(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->config_names == NULL)
+		load_config_names(p);
+
+	if (p->active_config == NULL)
+		status_debug("%s: p->active_config == NULL", G_STRFUNC);
+
+	fill_selector(p, p->active_config);
+	update_conn_label(p);
+	update_tunnel_rows(p);
+
+	hildon_check_button_set_active(HILDON_CHECK_BUTTON(p->wg_chkbtn),
+				       p->systemwide_enabled);
+
+	/* Make the buttons insensitive when provider is connected. */
+	set_buttons_sensitivity(self, !p->provider_connected);
+}
+
+static void status_menu_clicked_cb(GtkWidget * btn,
+				   StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	GtkWidget *toplevel = gtk_widget_get_toplevel(btn);
+
+	p->tap_time = g_get_monotonic_time();
+
+	gtk_widget_hide(toplevel);
+
+	build_settings_dialog(self);
+	refresh_settings_dialog(self);
+
+	gtk_window_set_transient_for(GTK_WINDOW(p->settings_dialog),
+				     GTK_WINDOW(toplevel));
+
+	gtk_widget_show_all(p->settings_dialog);
+	switch (gtk_dialog_run(GTK_DIALOG(p->settings_dialog))) {
+	case GTK_RESPONSE_ACCEPT:
+		save_settings(self);
+		break;
+	case SETTINGS_RESPONSE:
+		execute_cp_plugin(btn, self);
+		reload_after_cp_plugin(p);
+	default:
+		break;
+	}
+
+	if (p->settings_dialog)
+		gtk_widget_hide(p->settings_dialog);
+}
+
+static void set_status_icon(gpointer obj, GdkPixbuf * pixbuf)
+{
+	hd_status_plugin_item_set_status_area_icon(HD_STATUS_PLUGIN_ITEM(obj),
+						   pixbuf);
+}
+
+static int blink_status_icon(gpointer obj)
+{
+	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(obj);
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
+	struct wakeup w;
+	int ret = TRUE;
+
+	wakeup_begin(&w, WAKEUP_BLINK);
+
+	if (tunnel_set_state(&p->tunnels) != CONN_CONNECTING) {
+		p->blink_source = 0;
+		ret = FALSE;
+		goto out;
+	}
+
+	switch (p->current_status_icon) {
+	case STATUS_ICON_NONE:
+	case STATUS_ICON_CONNECTED:
+		set_status_icon(obj, p->pix18_wg_connecting);
+		p->current_status_icon = STATUS_ICON_CONNECTING;
+		break;
+	case STATUS_ICON_CONNECTING:
+		set_status_icon(obj, p->pix18_wg_connected);
+		p->current_status_icon = STATUS_ICON_CONNECTED;
+		break;
+	}
+
+ out:
+	wakeup_end(&w);
+	return ret;
+}
+
+/*
+ * There is only ever one blink timer. Repeated CONNECTING transitions
+ * keep the running one, and it is not run at all while the display is
+ * off, since nobody can see it.
+ */
+static void start_blink(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->blink_source || p->display_off)
+		return;
+
+	p->blink_source = g_timeout_add_seconds(1, blink_status_icon, self);
+}
+
+static void stop_blink(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->blink_source) {
+		g_source_remove(p->blink_source);
+		p->blink_source = 0;
+	}
+}
+
+/*
+ * The menu button keeps a single GtkImage; only its pixbuf changes with
+ * the state. Nothing is shown before the 48px icons were loaded.
+ */
+static void update_menu_image(StatusAppletWireguardPrivate * p)
+{
+	GdkPixbuf *pixbuf;
+
+	if (!p->menu_icons_loaded)
+		return;
+
+	switch (tunnel_set_state(&p->tunnels)) {
+	case CONN_DOWN:
+		pixbuf = p->pix48_wg_disabled;
+		break;
+	case CONN_UP:
+		pixbuf = p->pix48_wg_enabled;
+		break;
+	default:
+		/* Keep whatever was shown before */
+		return;
+	}
+
+	if (p->menu_image == NULL) {
+		p->menu_image = gtk_image_new();
+		hildon_button_set_image(HILDON_BUTTON(p->menu_button),
+					p->menu_image);
+		hildon_button_set_image_position(HILDON_BUTTON(p->menu_button),
+						 0);
+	}
+
+	if (p->menu_image_pixbuf != pixbuf) {
+		gtk_image_set_from_pixbuf(GTK_IMAGE(p->menu_image), pixbuf);
+		p->menu_image_pixbuf = pixbuf;
+	}
+}
+
+/*
+ * The menu value is built here only, from the tunnel set, the watchdog
+ * verdict and the last counters, so none of them overwrites the others.
+ */
+static void update_menu_value(StatusAppletWireguardPrivate * p)
+{
+	guint up = tunnel_set_count(&p->tunnels, CONN_UP);
+	GString *value;
+
+	switch (tunnel_set_state(&p->tunnels)) {
+	case CONN_DOWN:
+		value = g_string_new("Disconnected");
+		break;
+	case CONN_CONNECTING:
+		value = g_string_new("Connecting");
+		break;
+	default:
+		value = g_string_new(NULL);
+		if (up > 1)
+			g_string_printf(value, "%u connected%s", up,
+					p->degraded ? ", degraded" : "");
+		else
+			g_string_assign(value, p->degraded ? "Degraded" :
+					"Connected");
+		if (p->stats_value)
+			g_string_append_printf(value, ", %s", p->stats_value);
+		break;
+	}
+
+	hildon_button_set_value(HILDON_BUTTON(p->menu_button), value->str);
+	g_string_free(value, TRUE);
+}
+
+static void show_tunnel_stats(StatusAppletWireguardPrivate * p,
+			      const struct tun_sample *s)
+{
+	const struct tun_sample *last = &p->last_sample;
+	GString *value = g_string_new(NULL);
+	gint64 elapsed = s->time - last->time;
+	gchar *rx, *tx;
+
+	if (last->time && elapsed > 0 && s->rx_bytes >= last->rx_bytes
+	    && s->tx_bytes >= last->tx_bytes) {
+		rx = g_format_size((s->rx_bytes - last->rx_bytes) *
+				   G_USEC_PER_SEC / elapsed);
+		tx = g_format_size((s->tx_bytes - last->tx_bytes) *
+				   G_USEC_PER_SEC / elapsed);
+		g_string_append_printf(value, "%s/s down, %s/s up", rx, tx);
+		g_free(rx);
+		g_free(tx);
+	}
+
+	if (s->last_handshake)
+		g_string_append_printf(value, "%shandshake %" G_GINT64_FORMAT
+				       " s ago", value->len ? ", " : "",
+				       MAX(0, g_get_real_time() /
+					   G_USEC_PER_SEC -
+					   s->last_handshake));
+
+	g_free(p->stats_value);
+	p->stats_value = g_string_free(value, value->len == 0);
+	update_menu_value(p);
+}
+
+static gboolean stats_poll_cb(gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	struct tun_sample s;
+	guint interval;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_STATS);
+
+	if (p->tun_stats == NULL)
+		p->tun_stats = tun_stats_new(WG_IFNAME);
+
+	interval = p->stats_interval;
+
+	if (tun_stats_sample(p->tun_stats, &s)) {
+		show_tunnel_stats(p, &s);
+
+		/* Back off while nothing moves, speed up again on traffic */
+		if (p->last_sample.time && s.rx_bytes == p->last_sample.rx_bytes
+		    && s.tx_bytes == p->last_sample.tx_bytes)
+			interval = MIN(interval * 2, STATS_POLL_MAX_MS);
+		else
+			interval = STATS_POLL_MIN_MS;
+
+		p->last_sample = s;
+	} else {
+		interval = STATS_POLL_MAX_MS;
+	}
+
+	wakeup_end(&w);
+
+	if (interval == p->stats_interval && p->stats_source)
+		return TRUE;
+
+	p->stats_interval = interval;
+	p->stats_source = g_timeout_add(interval, stats_poll_cb, data);
+	return FALSE;
+}
+
+static void stop_stats_poll(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->stats_source) {
+		g_source_remove(p->stats_source);
+		p->stats_source = 0;
+	}
+
+	g_free(p->stats_value);
+	p->stats_value = NULL;
+}
+
+/* Nobody looks at the numbers unless the menu is open */
+static void start_stats_poll(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->stats_source || p->connection_state != WIREGUARD_CONNECTED
+	    || !gtk_widget_get_mapped(p->menu_button))
+		return;
+
+	memset(&p->last_sample, 0, sizeof(p->last_sample));
+	p->stats_interval = STATS_POLL_MIN_MS;
+	stats_poll_cb(self);
+}
+
+static guint get_failover_timeout(void)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	GConfValue *value;
+	guint timeout = WATCHDOG_FAILOVER_S;
+
+	value = gconf_client_get(gconf, GC_WIREGUARD_FAILOVER_TIMEOUT, NULL);
+	if (value && value->type == GCONF_VALUE_INT)
+		timeout = MAX(0, gconf_value_get_int(value));
+
+	if (value)
+		gconf_value_free(value);
+	g_object_unref(gconf);
+
+	return timeout;
+}
+
+/*
+ * The config after the active one in the failover list, skipping the
+ * ones that went stale on us within the backoff window.
+ */
+static gchar *next_failover_config(StatusAppletWireguardPrivate * p,
+				   gint64 now)
+{
+	GConfClient *gconf = gconf_client_get_default();
+	GSList *list, *iter;
+	gchar *next = NULL;
+	gpointer failed;
+	gint active;
+	guint i, len;
+
+	list = gconf_client_get_list(gconf, GC_WIREGUARD_FAILOVER,
+				     GCONF_VALUE_STRING, NULL);
+	g_object_unref(gconf);
+
+	len = g_slist_length(list);
+	active = g_slist_position(list, g_slist_find_custom(list,
+							    p->active_config,
+							    (GCompareFunc)
+							    g_strcmp0));
+
+	/* Once around the list, beginning after the active config */
+	for (i = 1; i <= len && next == NULL; i++) {
+		iter = g_slist_nth(list, (active + i) % len);
+
+		if (!g_strcmp0(iter->data, p->active_config))
+			continue;
+
+		failed = g_hash_table_lookup(p->failed_configs, iter->data);
+		if (failed == NULL || now - *(gint64 *) failed >
+		    (gint64) WATCHDOG_BACKOFF_MAX_S * G_USEC_PER_SEC)
+			next = g_strdup(iter->data);
+	}
+
+	g_slist_foreach(list, (GFunc) g_free, NULL);
+	g_slist_free(list);
+
+	return next;
+}
+
+static void failover(StatusAppletWireguard * self, gint64 now)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	GConfClient *gconf;
+	gint64 *failed_at;
+	gchar *next;
+
+	watchdog_failed_over(&p->watchdog, now);
+
+	if (p->failed_configs == NULL)
+		p->failed_configs = g_hash_table_new_full(g_str_hash,
+							  g_str_equal, g_free,
+							  g_free);
+
+	next = next_failover_config(p, now);
+	if (next == NULL) {
+		status_debug("wg-sb: %s: nothing to fail over to", G_STRFUNC);
+		return;
+	}
+
+	if (p->active_config) {
+		failed_at = g_new(gint64, 1);
+		*failed_at = now;
+		g_hash_table_replace(p->failed_configs,
+				     g_strdup(p->active_config), failed_at);
+	}
+
+	status_debug("wg-sb: %s: %s is stale, switching to %s", G_STRFUNC,
+		     p->active_config, next);
+
+	gconf = gconf_client_get_default();
+	gconf_client_set_string(gconf, GC_WIREGUARD_ACTIVE, next, NULL);
+	g_object_unref(gconf);
+	g_free(p->live_config);
+	p->live_config = NULL;
+
+	tunnel_set_rename(&p->tunnels, p->active_config, next);
+	g_free(p->active_config);
+	p->active_config = next;
+	prefetch_endpoints(next);
+}
+
+static void watch_tunnel(StatusAppletWireguard * self,
+			 const struct tun_sample *s)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	enum watchdog_verdict verdict;
+	gboolean degraded;
+
+	verdict = watchdog_feed(&p->watchdog, s, s->time);
+
+	degraded = verdict != WATCHDOG_HEALTHY;
+	if (degraded != p->degraded) {
+		p->degraded = degraded;
+		update_menu_value(p);
+	}
+
+	/* In provider mode, the config is not ours to change */
+	if (verdict == WATCHDOG_FAILOVER && !p->provider_connected)
+		failover(self, s->time);
+}
+
+/* Learn how long the keepalive interval can get from the handshakes */
+static void tune_keepalive(StatusAppletWireguard * self,
+			   const struct tun_sample *s)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	gboolean ok;
+
+	if (!p->keepalive_adaptive || s->last_handshake == 0)
+		return;
+
+	ok = g_get_real_time() / G_USEC_PER_SEC - s->last_handshake <
+	    WATCHDOG_STALE_S;
+
+	if (wg_keepalive_feed(&p->keepalive, ok, s->time))
+		apply_keepalive(self);
+}
+
+/* The long keepalive profile is for when nobody is looking */
+static void update_power_profile(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (wg_keepalive_set_battery(&p->keepalive,
+				     p->on_battery && p->display_off,
+				     g_get_monotonic_time())
+	    && p->keepalive_adaptive
+	    && p->connection_state == WIREGUARD_CONNECTED)
+		apply_keepalive(self);
+}
+
+static gboolean history_cb(gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	struct tun_sample *last = &p->history_sample;
+	struct tun_sample s;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_HISTORY);
+
+	if (p->tun_stats == NULL)
+		p->tun_stats = tun_stats_new(WG_IFNAME);
+
+	/* The file follows the active config, the one being connected */
+	if (p->active_config && g_strcmp0(p->active_config, p->history_config)) {
+		history_close(p->history);
+		g_free(p->history_config);
+		p->history = history_open(p->active_config);
+		p->history_config = g_strdup(p->active_config);
+		last->time = 0;
+	}
+
+	if (tun_stats_sample(p->tun_stats, &s)) {
+		/* Counters restart with the interface */
+		if (p->history && last->time && s.rx_bytes >= last->rx_bytes
+		    && s.tx_bytes >= last->tx_bytes)
+			history_add(p->history,
+				    g_get_real_time() / G_USEC_PER_SEC,
+				    s.rx_bytes - last->rx_bytes,
+				    s.tx_bytes - last->tx_bytes);
+		*last = s;
+
+		watch_tunnel(data, &s);
+		tune_keepalive(data, &s);
+	}
+
+	wakeup_end(&w);
+	return TRUE;
+}
+
+static void stop_history(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->history_source) {
+		g_source_remove(p->history_source);
+		p->history_source = 0;
+	}
+}
+
+static void start_history(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->history_source)
+		return;
+
+	p->history_sample.time = 0;
+	p->degraded = FALSE;
+	watchdog_reset(&p->watchdog, get_failover_timeout(),
+		       g_get_monotonic_time());
+	history_cb(self);
+	p->history_source = g_timeout_add_seconds(HISTORY_INTERVAL_S,
+						  history_cb, self);
+}
+
+static void status_applet_wireguard_set_icons(StatusAppletWireguard * self)
+{
+	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(self);
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
+
+	/* The icon is up if any tunnel is */
+	switch (tunnel_set_state(&p->tunnels)) {
+	case CONN_DOWN:
+		set_status_icon(self, NULL);
+		p->current_status_icon = STATUS_ICON_NONE;
+		stop_blink(sa);
 		break;
-	case WIREGUARD_CONNECTING:
-		hildon_button_set_value(HILDON_BUTTON(p->menu_button),
-					"Connecting");
+	case CONN_CONNECTING:
 		set_status_icon(self, p->pix18_wg_connecting);
 		p->current_status_icon = STATUS_ICON_CONNECTING;
-		g_timeout_add_seconds(1, blink_status_icon, sa);
+		start_blink(sa);
 		break;
-	case WIREGUARD_CONNECTED:
-		menu_pixbuf = p->pix48_wg_enabled;
-		hildon_button_set_value(HILDON_BUTTON(p->menu_button),
-					"Connected");
+	case CONN_UP:
 		set_status_icon(self, p->pix18_wg_connected);
 		p->current_status_icon = STATUS_ICON_CONNECTED;
+		stop_blink(sa);
 		break;
 	default:
-		g_critical("%s: Invalid connection_state", G_STRLOC);
+		g_critical("%s: Invalid tunnel state", G_STRLOC);
 		break;
 	};
 
-	if (menu_pixbuf) {
-		hildon_button_set_image(HILDON_BUTTON(p->menu_button),
-					gtk_image_new_from_pixbuf(menu_pixbuf));
-		hildon_button_set_image_position(HILDON_BUTTON(p->menu_button),
-						 0);
+	/* Counters and history are those of the tunnel on wg0 */
+	if (p->connection_state == WIREGUARD_CONNECTED) {
+		start_stats_poll(sa);
+		start_history(sa);
+	} else {
+		stop_stats_poll(sa);
+		stop_history(sa);
+	}
+
+	update_menu_value(p);
+	update_menu_image(p);
+	update_tunnel_rows(p);
+}
+
+static WireguardConnState parse_state(const gchar * status)
+{
+	if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_CONNECTED))
+		return WIREGUARD_CONNECTED;
+	else if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_STARTED))
+		return WIREGUARD_CONNECTING;
+	else if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED))
+		return WIREGUARD_NOT_CONNECTED;
+
+	return WIREGUARD_NOT_CONNECTED;
+}
+
+static enum conn_state conn_state(WireguardConnState state)
+{
+	switch (state) {
+	case WIREGUARD_CONNECTING:
+		return CONN_CONNECTING;
+	case WIREGUARD_CONNECTED:
+		return CONN_UP;
+	default:
+		return CONN_DOWN;
+	}
+}
+
+/* Connect latency, split by whether the config was prewarmed */
+static void track_connect(StatusAppletWireguardPrivate * p,
+			  WireguardConnState state)
+{
+	gint64 now = g_get_monotonic_time();
+
+	switch (state) {
+	case WIREGUARD_CONNECTING:
+		p->connect_start = now;
+		p->connect_warm = prewarm_hit(&p->prewarm, p->active_config,
+					      now);
+		break;
+	case WIREGUARD_CONNECTED:
+		if (p->connect_start)
+			prewarm_connected(&p->prewarm, p->connect_warm,
+					  now - p->connect_start);
+		p->connect_start = 0;
+		break;
+	default:
+		p->connect_start = 0;
+		break;
+	}
+}
+
+/* Returns TRUE if the UI was updated */
+static gboolean apply_status(gpointer obj, WireguardConnState state,
+			     gboolean provider)
+{
+	/* Either show or hide status icon */
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+
+	trace_startup(p, STARTUP_FIRST_STATUS);
+
+	/* Repeats of what is shown already cost nothing */
+	if (state == p->connection_state && provider == p->provider_connected) {
+		p->sigstats.unchanged++;
+		return FALSE;
+	}
+
+	p->sigstats.ui_updates++;
+
+	if (state != p->connection_state) {
+		conn_machine_transition(&p->conn, conn_state(state),
+					p->active_config,
+					g_get_monotonic_time());
+		track_connect(p, state);
+
+		if (state == WIREGUARD_CONNECTED) {
+			apply_mtu(obj);
+			apply_keepalive(obj);
+		} else {
+			wg_mtu_probe_cancel(p->mtu_probe);
+			p->mtu_probe = NULL;
+			save_live_config(p);
+		}
+	}
+
+	if (state == WIREGUARD_CONNECTED && p->switch_start) {
+		status_debug("wg-sb: config switch by reconnect took %"
+			     G_GINT64_FORMAT "us",
+			     g_get_monotonic_time() - p->switch_start);
+		p->switch_start = 0;
+	}
+
+	p->connection_state = state;
+	p->provider_connected = provider;
+
+	set_buttons_sensitivity(obj, !provider);
+	status_applet_wireguard_set_icons(obj);
+	return TRUE;
+}
+
+/* What GetStatus replied, which is about the tunnel on wg0 */
+static void update_status(gpointer obj, const gchar * status,
+			  const gchar * mode)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+	WireguardConnState state = parse_state(status);
+	gboolean provider =
+	    !g_strcmp0(mode, ICD_WIREGUARD_SIGNALS_STATUS_MODE_PROVIDER);
+
+	tunnel_set_update(&p->tunnels, p->active_config, conn_state(state),
+			  provider);
+	apply_status(obj, state, provider);
+}
+
+static gboolean status_frame_cb(gpointer obj)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+	gboolean changed, shown = FALSE;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_STATUS_FRAME);
+
+	p->status_source = 0;
+	changed = tunnel_set_flush(&p->tunnels);
+
+	if (p->primary_pending) {
+		p->primary_pending = FALSE;
+		shown = apply_status(obj, p->pending_state,
+				     p->pending_provider);
+	}
+
+	/* Only another tunnel changed, which shows in the icon and rows */
+	if (changed && !shown) {
+		p->sigstats.ui_updates++;
+		status_applet_wireguard_set_icons(obj);
+	}
+
+	wakeup_end(&w);
+	return FALSE;
+}
+
+/*
+ * One line per signal: microseconds since the previous one, state, mode
+ * and the config if the signal named one. The gaps keep the original
+ * timing when wg-mock-provider --replay plays the trace back.
+ */
+static void record_signal(StatusAppletWireguardPrivate * p,
+			  const gchar * status, const gchar * mode,
+			  const gchar * config)
+{
+	gint64 now = g_get_monotonic_time();
+
+	fprintf(p->signal_trace, "%" G_GINT64_FORMAT " %s %s%s%s\n",
+		p->last_traced ? now - p->last_traced : 0,
+		status ? status : "-", mode ? mode : "-",
+		config ? " " : "", config ? config : "");
+	fflush(p->signal_trace);
+	p->last_traced = now;
+}
+
+static void open_signal_trace(StatusAppletWireguardPrivate * p)
+{
+	const gchar *path = g_getenv(SIGNAL_TRACE_ENV);
+
+	if (path == NULL || *path == '\0')
+		return;
+
+	p->signal_trace = fopen(path, "a");
+	if (p->signal_trace == NULL)
+		g_warning("Unable to open signal trace %s", path);
+}
+
+/*
+ * StatusChanged carries the state and the mode, and may carry the config
+ * of the tunnel it is about. Without one, it is about the tunnel on wg0.
+ */
+static guint get_status_args(DBusMessage * msg, const gchar ** args,
+			     guint n_args)
+{
+	DBusMessageIter iter;
+	guint n = 0;
+
+	if (!dbus_message_iter_init(msg, &iter))
+		return 0;
+
+	do {
+		if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+			break;
+		dbus_message_iter_get_basic(&iter, &args[n++]);
+	} while (n < n_args && dbus_message_iter_next(&iter));
+
+	return n;
+}
+
+static int handle_running(gpointer obj, DBusMessage * msg)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+	const gchar *args[3] = { NULL, NULL, NULL };
+	const gchar *status, *mode, *config;
+	WireguardConnState state;
+	gboolean provider;
+
+	get_status_args(msg, args, G_N_ELEMENTS(args));
+	status = args[0];
+	mode = args[1];
+	config = args[2] && *args[2] ? args[2] : p->active_config;
+
+	/* Anything GetStatus replies after this is older news */
+	p->status_known = TRUE;
+	p->sigstats.received++;
+
+	if (p->signal_trace)
+		record_signal(p, status, mode,
+			      args[2] && *args[2] ? args[2] : NULL);
+
+	/*
+	 * Only the last state of a burst matters. Remember it and update
+	 * the UI once the frame is over.
+	 */
+	state = parse_state(status);
+	provider = !g_strcmp0(mode, ICD_WIREGUARD_SIGNALS_STATUS_MODE_PROVIDER);
+	tunnel_set_stage(&p->tunnels, config, conn_state(state), provider);
+
+	if (!g_strcmp0(config, p->active_config)) {
+		p->pending_state = state;
+		p->pending_provider = provider;
+		p->primary_pending = TRUE;
+	}
+
+	if (p->status_source)
+		p->sigstats.merged++;
+	else
+		p->status_source =
+		    g_timeout_add(STATUS_FRAME_MS, status_frame_cb, obj);
+
+	/* Leave the signal to anyone else on the session bus connection */
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static int handle_display(gpointer obj, DBusMessage * msg)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+	const gchar *state = NULL;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &state,
+				   DBUS_TYPE_INVALID))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	/* Dimmed still counts as on, the icon is visible */
+	p->display_off = !g_strcmp0(state, MCE_DISPLAY_OFF_STRING);
+
+	if (p->display_off)
+		stop_blink(obj);
+	else if (tunnel_set_state(&p->tunnels) == CONN_CONNECTING)
+		start_blink(obj);
+
+	update_power_profile(obj);
+
+	/* Other plugins on this connection want to see this too */
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/*
+ * Set the endpoints of all peers with a hostname that resolves by now,
+ * if all of them do. Returns FALSE while some are still being looked up.
+ */
+static gboolean update_endpoints(StatusAppletWireguardPrivate * p)
+{
+	struct wg_resolv_cache *cache = wg_resolv_cache_get_default();
+	const struct wg_blob_peer *bp = NULL;
+	const struct wg_blob *blob;
+	struct wg_blob *loaded = NULL;
+	struct wg_nl_peer_config pc;
+	struct sockaddr_storage *addrs;
+	GConfClient *gconf;
+	GArray *peers;
+	gchar *endpoint;
+	struct wg_nl *nl;
+	gboolean done = TRUE;
+	socklen_t len = 0;
+	guint n = 0;
+	int ret;
+
+	blob = prewarm_blob(&p->prewarm, p->active_config);
+	if (blob == NULL && p->active_config) {
+		gconf = gconf_client_get_default();
+		blob = loaded = wg_blob_load(gconf, p->active_config);
+		g_object_unref(gconf);
+	}
+
+	/* Config files are resolved by the provider */
+	if (blob == NULL)
+		return TRUE;
+
+	peers = g_array_new(FALSE, TRUE, sizeof(struct wg_nl_peer_config));
+	addrs = g_new0(struct sockaddr_storage, blob->header->n_peers);
+
+	while (done && (bp = wg_blob_next_peer(blob, bp))) {
+		if (bp->endpoint_kind != WG_ENDPOINT_HOSTNAME)
+			continue;
+
+		endpoint = g_strdup_printf("%s:%u", wg_blob_peer_host(bp),
+					   bp->port);
+		done = wg_resolv_cache_sockaddr(cache, endpoint, &addrs[n],
+						&len);
+		g_free(endpoint);
+
+		memset(&pc, 0, sizeof(pc));
+		pc.public_key = bp->public_key;
+		pc.endpoint = (struct sockaddr *)&addrs[n++];
+		pc.endpoint_len = len;
+		pc.keepalive = -1;
+		pc.flags = WGPEER_F_UPDATE_ONLY;
+		g_array_append_val(peers, pc);
+	}
+
+	if (done && peers->len) {
+		nl = wg_nl_open();
+		ret = nl ? wg_nl_set_device(nl, WG_IFNAME, 0,
+					    (struct wg_nl_peer_config *)
+					    peers->data, peers->len) : -errno;
+		if (nl)
+			wg_nl_close(nl);
+
+		status_debug("wg-sb: %s: %u peers: %s", G_STRFUNC, peers->len,
+			     ret < 0 ? g_strerror(-ret) : "ok");
+	}
+
+	g_free(addrs);
+	g_array_free(peers, TRUE);
+	wg_blob_free(loaded);
+
+	return done;
+}
+
+/*
+ * Have every peer send a keepalive right away. Any authenticated packet
+ * tells the peer where we are now, and one on an expired session starts
+ * a handshake. The kernel sends one when a keepalive gets switched on,
+ * so switch it off and on again, and back off for peers without one.
+ *
+ * Both reading and setting the device over netlink take CAP_NET_ADMIN,
+ * which hildon-desktop doesn't have. Returns FALSE when it can't.
+ */
+static gboolean kick_tunnel_nl(void)
+{
+	struct wg_nl_peer_config pc;
+	struct wg_nl_device dev;
+	struct wg_nl *nl;
+	GArray *peers;
+	guint i;
+	int ret;
+
+	nl = wg_nl_open();
+	if (nl == NULL) {
+		status_debug("wg-sb: %s: %s", G_STRFUNC, g_strerror(errno));
+		return FALSE;
+	}
+
+	memset(&dev, 0, sizeof(dev));
+	dev.max_peers = KICK_PEERS;
+	dev.peers = g_new0(struct wg_nl_peer, dev.max_peers);
+
+	ret = wg_nl_get_device(nl, WG_IFNAME, &dev);
+	if (ret >= 0 && dev.n_peers > dev.max_peers) {
+		dev.max_peers = dev.n_peers;
+		dev.peers = g_renew(struct wg_nl_peer, dev.peers,
+				    dev.max_peers);
+		ret = wg_nl_get_device(nl, WG_IFNAME, &dev);
+	}
+	if (ret < 0) {
+		status_debug("wg-sb: %s: %s", G_STRFUNC, g_strerror(-ret));
+		g_free(dev.peers);
+		wg_nl_close(nl);
+		return FALSE;
+	}
+
+	peers = g_array_new(FALSE, TRUE, sizeof(struct wg_nl_peer_config));
+
+	for (i = 0; i < MIN(dev.n_peers, dev.max_peers); i++) {
+		memset(&pc, 0, sizeof(pc));
+		pc.public_key = dev.peers[i].public_key;
+		pc.flags = WGPEER_F_UPDATE_ONLY;
+
+		pc.keepalive = 0;
+		g_array_append_val(peers, pc);
+
+		pc.keepalive = dev.peers[i].keepalive ?
+		    dev.peers[i].keepalive : KICK_KEEPALIVE_S;
+		g_array_append_val(peers, pc);
+
+		if (dev.peers[i].keepalive == 0) {
+			pc.keepalive = 0;
+			g_array_append_val(peers, pc);
+		}
+	}
+
+	if (dev.n_peers > dev.max_peers)
+		status_debug("wg-sb: %s: only %u of %u peers", G_STRFUNC,
+			     dev.max_peers, dev.n_peers);
+
+	ret = wg_nl_set_device(nl, WG_IFNAME, 0,
+			       (struct wg_nl_peer_config *)peers->data,
+			       peers->len);
+	status_debug("wg-sb: %s: %u peers: %s", G_STRFUNC, dev.n_peers,
+		     ret < 0 ? g_strerror(-ret) : "ok");
+
+	g_array_free(peers, TRUE);
+	g_free(dev.peers);
+	wg_nl_close(nl);
+
+	return ret >= 0;
+}
+
+/*
+ * An address the tunnel routes to this allowed IP: the first one in the
+ * network, the host itself, or one from the documentation ranges for a
+ * default route, which no one answers but still goes out to the peer.
+ */
+static socklen_t kick_address(const struct wg_nl_allowedip *ip,
+			      struct sockaddr_storage *ss)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+	guint i;
+
+	memset(ss, 0, sizeof(*ss));
+
+	if (ip->family == AF_INET) {
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(KICK_PORT);
+		if (ip->cidr == 0)
+			inet_pton(AF_INET, "192.0.2.1", &sin->sin_addr);
+		else if (ip->cidr >= 32)
+			sin->sin_addr = ip->addr.ip4;
+		else
+			sin->sin_addr.s_addr =
+			    htonl((ntohl(ip->addr.ip4.s_addr) &
+				   ~0U << (32 - ip->cidr)) + 1);
+		return sizeof(*sin);
+	}
+
+	if (ip->family == AF_INET6) {
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(KICK_PORT);
+		if (ip->cidr == 0) {
+			inet_pton(AF_INET6, "2001:db8::1", &sin6->sin6_addr);
+			return sizeof(*sin6);
+		}
+
+		sin6->sin6_addr = ip->addr.ip6;
+		if (ip->cidr >= 128)
+			return sizeof(*sin6);
+
+		for (i = ip->cidr; i < 128; i++)
+			sin6->sin6_addr.s6_addr[i / 8] &= ~(0x80 >> (i % 8));
+		sin6->sin6_addr.s6_addr[15] |= 1;
+		return sizeof(*sin6);
 	}
+
+	return 0;
 }
 
-static int handle_running(gpointer obj, DBusMessage * msg)
+/*
+ * Without netlink, send a byte into the tunnel for every peer of the
+ * active config. The kernel has to encrypt it for that peer, and starts
+ * a handshake to do so if the session is gone.
+ */
+static void kick_tunnel_udp(StatusAppletWireguardPrivate * p)
+{
+	const struct wg_blob_peer *bp = NULL;
+	const struct wg_blob *blob;
+	struct wg_blob *loaded = NULL;
+	struct sockaddr_storage ss;
+	GConfClient *gconf;
+	const char byte = 0;
+	socklen_t len;
+	guint sent = 0;
+	int fds[2] = { -1, -1 };
+	int *fd;
+
+	blob = prewarm_blob(&p->prewarm, p->active_config);
+	if (blob == NULL && p->active_config) {
+		gconf = gconf_client_get_default();
+		blob = loaded = wg_blob_load(gconf, p->active_config);
+		g_object_unref(gconf);
+	}
+
+	if (blob == NULL) {
+		status_debug("wg-sb: %s: no peers to kick", G_STRFUNC);
+		return;
+	}
+
+	while ((bp = wg_blob_next_peer(blob, bp))) {
+		if (bp->n_ips == 0)
+			continue;
+
+		len = kick_address(wg_blob_peer_ips(bp), &ss);
+		if (len == 0)
+			continue;
+
+		fd = &fds[ss.ss_family == AF_INET6];
+		if (*fd < 0) {
+			*fd = socket(ss.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+			if (*fd < 0)
+				continue;
+			/* Takes CAP_NET_RAW as well, the routes do without */
+			setsockopt(*fd, SOL_SOCKET, SO_BINDTODEVICE, WG_IFNAME,
+				   strlen(WG_IFNAME));
+		}
+
+		if (sendto(*fd, &byte, 1, 0, (struct sockaddr *)&ss, len) == 1)
+			sent++;
+	}
+
+	status_debug("wg-sb: %s: %u of %u peers", G_STRFUNC, sent,
+		     blob->header->n_peers);
+
+	if (fds[0] >= 0)
+		close(fds[0]);
+	if (fds[1] >= 0)
+		close(fds[1]);
+	wg_blob_free(loaded);
+}
+
+static void kick_tunnel(StatusAppletWireguardPrivate * p)
+{
+	if (!kick_tunnel_nl())
+		kick_tunnel_udp(p);
+}
+
+static void stop_recovery(StatusAppletWireguardPrivate * p)
+{
+	if (p->recovery_source) {
+		g_source_remove(p->recovery_source);
+		p->recovery_source = 0;
+	}
+}
+
+/*
+ * After a move, set the endpoints once they are looked up again, and
+ * time how long it takes until something comes through the tunnel.
+ * Without traffic or a handshake there is nothing to tell by.
+ */
+static gboolean recovery_cb(gpointer data)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(data);
+	gint64 now = g_get_monotonic_time();
+	struct tun_sample s;
+	struct wakeup w;
+	gint64 took;
+
+	wakeup_begin(&w, WAKEUP_RECOVERY);
+
+	if (!p->endpoints_updated)
+		p->endpoints_updated = update_endpoints(p);
+
+	if (tun_stats_sample(p->tun_stats, &s)
+	    && (s.rx_bytes > p->recovery_base.rx_bytes
+		|| s.last_handshake * G_USEC_PER_SEC >=
+		p->bearer_changed_real)) {
+		took = now - p->bearer_changed;
+		p->recovered++;
+		p->recovery_sum_us += took;
+		p->recovery_max_us = MAX(p->recovery_max_us, took);
+		status_debug("wg-sb: tunnel back %" G_GINT64_FORMAT
+			     "ms after the network changed", took / 1000);
+		goto stop;
+	}
+
+	if (now - p->bearer_changed <
+	    RECOVERY_MAX_S * (gint64) G_USEC_PER_SEC) {
+		wakeup_end(&w);
+		return TRUE;
+	}
+
+	status_debug("wg-sb: nothing through the tunnel %ds after the "
+		     "network changed", RECOVERY_MAX_S);
+
+ stop:
+	p->recovery_source = 0;
+	wakeup_end(&w);
+	return FALSE;
+}
+
+/* The tunnel runs over another network now, get it moving again */
+static void network_changed(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	p->bearer_changes++;
+
+	/* Names may resolve differently here, and the NAT is another one */
+	wg_resolv_cache_expire(wg_resolv_cache_get_default());
+	wg_keepalive_reset(&p->keepalive, g_get_monotonic_time());
+
+	if (p->connection_state != WIREGUARD_CONNECTED)
+		return;
+
+	if (p->tun_stats == NULL)
+		p->tun_stats = tun_stats_new(WG_IFNAME);
+
+	p->bearer_changed = g_get_monotonic_time();
+	p->bearer_changed_real = g_get_real_time();
+	if (!tun_stats_sample(p->tun_stats, &p->recovery_base))
+		memset(&p->recovery_base, 0, sizeof(p->recovery_base));
+
+	kick_tunnel(p);
+	apply_keepalive(self);
+	apply_mtu(self);
+
+	prefetch_endpoints(p->active_config);
+	p->endpoints_updated = FALSE;
+
+	stop_recovery(p);
+	p->recovery_source = g_timeout_add(RECOVERY_POLL_MS, recovery_cb, self);
+}
+
+static int handle_iap_state(gpointer obj, DBusMessage * msg)
 {
-	/* Either show or hide status icon */
 	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
-	const gchar *status = NULL;
-	const gchar *mode = NULL;
+	const gchar *service_type, *service_id, *network_type, *error;
+	dbus_uint32_t service_attrs, network_attrs, state;
+	const guchar *network_id;
+	int id_len;
+	gchar *id, *bearer;
+
+	/* The other forms of the signal are about scans */
+	if (!dbus_message_get_args(msg, NULL,
+				   DBUS_TYPE_STRING, &service_type,
+				   DBUS_TYPE_UINT32, &service_attrs,
+				   DBUS_TYPE_STRING, &service_id,
+				   DBUS_TYPE_STRING, &network_type,
+				   DBUS_TYPE_UINT32, &network_attrs,
+				   DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE,
+				   &network_id, &id_len,
+				   DBUS_TYPE_STRING, &error,
+				   DBUS_TYPE_UINT32, &state, DBUS_TYPE_INVALID))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	if (state != ICD_STATE_CONNECTED)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	id = g_base64_encode(network_id, id_len);
+	bearer = g_strconcat(network_type, "/", id, NULL);
+	g_free(id);
+
+	/* Only a change counts; the state request at startup gives the first */
+	if (p->bearer && strcmp(p->bearer, bearer)) {
+		status_debug("wg-sb: network changed from %s to %s",
+			     p->bearer, bearer);
+		network_changed(obj);
+	}
 
-	dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &status,
-			      DBUS_TYPE_STRING, &mode, DBUS_TYPE_INVALID);
+	g_free(p->bearer);
+	p->bearer = bearer;
 
-	if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_CONNECTED))
-		p->connection_state = WIREGUARD_CONNECTED;
-	else if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_STARTED))
-		p->connection_state = WIREGUARD_CONNECTING;
-	else if (!g_strcmp0(status, ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED))
-		p->connection_state = WIREGUARD_NOT_CONNECTED;
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static int handle_charger(gpointer obj, DBusMessage * msg)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+
+	if (dbus_message_has_member(msg, BME_CHARGER_CONNECTED))
+		p->on_battery = FALSE;
+	else if (dbus_message_has_member(msg, BME_CHARGER_DISCONNECTED))
+		p->on_battery = TRUE;
 	else
-		p->connection_state = WIREGUARD_NOT_CONNECTED;
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-	if (!g_strcmp0(mode, ICD_WIREGUARD_SIGNALS_STATUS_MODE_PROVIDER)) {
-		p->provider_connected = TRUE;
-		set_buttons_sensitivity(obj, FALSE);
-	} else {
-		p->provider_connected = FALSE;
-		set_buttons_sensitivity(obj, TRUE);
-	}
+	update_power_profile(obj);
 
-	status_applet_wireguard_set_icons(obj);
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
 
-	return 0;
+#ifdef ENABLE_DEBUG_DUMP
+/* The dump leaves out its own wakeup, which is still going on */
+static int handle_debug_dump(gpointer obj, DBusMessage * msg)
+{
+	(void)msg;
+
+	dump_debug_stats(GET_PRIVATE(obj));
+	return DBUS_HANDLER_RESULT_HANDLED;
 }
+#endif
 
+/*
+ * The connection is shared with every other plugin in hildon-desktop, so
+ * most messages seen here are for someone else. Only the ones handled
+ * here count as our wakeups.
+ */
 static int on_icd_signal(DBusConnection * dbus, DBusMessage * msg, gpointer obj)
 {
 	(void)dbus;
+	int (*handler)(gpointer obj, DBusMessage * msg);
+	struct wakeup w;
+	int ret;
 
 	if (dbus_message_is_signal
 	    (msg, ICD_WIREGUARD_DBUS_INTERFACE,
-	     ICD_WIREGUARD_SIGNAL_STATUSCHANGED))
-		return handle_running(obj, msg);
+	     ICD_WIREGUARD_SIGNAL_STATUSCHANGED)
+	    && dbus_message_has_path(msg, ICD_WIREGUARD_DBUS_PATH))
+		handler = handle_running;
+	else if (dbus_message_is_signal(msg, MCE_SIGNAL_IF, MCE_DISPLAY_SIG))
+		handler = handle_display;
+	else if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_SIGNAL
+		 && dbus_message_has_interface(msg, BME_SIGNAL_IF))
+		handler = handle_charger;
+	else if (dbus_message_is_signal(msg, ICD_DBUS_API_INTERFACE,
+					ICD_DBUS_API_STATE_SIG))
+		handler = handle_iap_state;
+#ifdef ENABLE_DEBUG_DUMP
+	else if (dbus_message_is_signal(msg, DEBUG_DUMP_IF, DEBUG_DUMP_SIG))
+		handler = handle_debug_dump;
+#endif
+	else
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	wakeup_begin(&w, WAKEUP_DBUS_FILTER);
+	ret = handler(obj, msg);
+	wakeup_end(&w);
+
+	return ret;
+}
+
+/* BME answers with one of the charger signals */
+static void request_charger_state(StatusAppletWireguardPrivate * p)
+{
+	DBusMessage *msg;
 
-	return 1;
+	msg = dbus_message_new_method_call(BME_SERVICE, BME_REQUEST_PATH,
+					   BME_REQUEST_IF,
+					   BME_STATUS_INFO_REQ);
+	if (msg == NULL)
+		return;
+
+	dbus_message_set_no_reply(msg, TRUE);
+	dbus_connection_send(p->dbus, msg, NULL);
+	dbus_message_unref(msg);
+}
+
+/*
+ * ICD answers with a state_sig for every connection it has, which tells
+ * what network we are on before it changes the first time.
+ */
+static void request_iap_state(StatusAppletWireguardPrivate * p)
+{
+	DBusMessage *msg;
+
+	msg = dbus_message_new_method_call(ICD_DBUS_API_INTERFACE,
+					   ICD_DBUS_API_PATH,
+					   ICD_DBUS_API_INTERFACE,
+					   ICD_DBUS_API_STATE_REQ);
+	if (msg == NULL)
+		return;
+
+	dbus_message_set_no_reply(msg, TRUE);
+	dbus_connection_send(p->dbus, msg, NULL);
+	dbus_message_unref(msg);
 }
 
 static void setup_dbus_matching(StatusAppletWireguard * self)
@@ -379,23 +2644,93 @@ static void setup_dbus_matching(StatusAppletWireguard * self)
 
 	dbus_connection_setup_with_g_main(p->dbus, NULL);
 
-	if (p->dbus)
+	if (p->dbus) {
 		dbus_bus_add_match(p->dbus, DBUS_SIGNAL, NULL);
+		dbus_bus_add_match(p->dbus, MCE_DISPLAY_SIGNAL, NULL);
+		dbus_bus_add_match(p->dbus, BME_SIGNAL(BME_CHARGER_CONNECTED),
+				   NULL);
+		dbus_bus_add_match(p->dbus,
+				   BME_SIGNAL(BME_CHARGER_DISCONNECTED), NULL);
+		dbus_bus_add_match(p->dbus, ICD_STATE_SIGNAL, NULL);
+#ifdef ENABLE_DEBUG_DUMP
+		dbus_bus_add_match(p->dbus, DEBUG_DUMP_SIGNAL, NULL);
+#endif
+	}
 
 	if (!dbus_connection_add_filter
 	    (p->dbus, (DBusHandleMessageFunction) on_icd_signal, self, NULL)) {
 		status_debug("wg-sb: Failed to add dbus filter");
 		return;
 	}
+
+	request_charger_state(p);
+	request_iap_state(p);
+}
+
+static void handle_provider_status(DBusPendingCall * pending, gpointer obj)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(obj);
+	DBusMessage *msg;
+	const gchar *status = NULL, *mode = NULL;
+
+	msg = dbus_pending_call_steal_reply(pending);
+	dbus_pending_call_unref(p->status_call);
+	p->status_call = NULL;
+
+	if (msg == NULL) {
+		status_debug("wg-sb: %s: method reply is NULL", G_STRFUNC);
+		return;
+	}
+
+	/* Also covers the provider not answering within the timeout */
+	if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_ERROR) {
+		status_debug("wg-sb: %s: %s", G_STRFUNC,
+			     dbus_message_get_error_name(msg));
+		dbus_message_unref(msg);
+		return;
+	}
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &status,
+				   DBUS_TYPE_STRING, &mode,
+				   DBUS_TYPE_INVALID)) {
+		status_debug("wg-sb: %s: reply has too few arguments",
+			     G_STRFUNC);
+		dbus_message_unref(msg);
+		return;
+	}
+
+	if (!p->status_known) {
+		p->status_known = TRUE;
+		update_status(obj, status, mode);
+	}
+
+	dbus_message_unref(msg);
+}
+
+static void provider_status_reply_cb(DBusPendingCall * pending,
+				     gpointer obj)
+{
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_DBUS_REPLY);
+	handle_provider_status(pending, obj);
+	wakeup_end(&w);
 }
 
+/*
+ * Ask the provider for its status without waiting for it. Until the
+ * reply or the first StatusChanged signal arrives, we show the neutral
+ * "Disconnected" state the private struct starts out with. The signal
+ * match is up before this runs; a signal that came first is newer than
+ * any reply, so there is nothing left to ask.
+ */
 static void get_provider_status(StatusAppletWireguard * self)
 {
 	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
 	DBusMessage *msg;
-	DBusMessageIter args;
-	DBusPendingCall *pending;
-	const gchar *status, *mode;
+
+	if (p->dbus == NULL || p->status_known)
+		return;
 
 	msg = dbus_message_new_method_call(ICD_WIREGUARD_DBUS_INTERFACE,
 					   ICD_WIREGUARD_DBUS_PATH,
@@ -404,121 +2739,240 @@ static void get_provider_status(StatusAppletWireguard * self)
 
 	if (msg == NULL) {
 		status_debug("wg-sb: %s: msg == NULL", G_STRFUNC);
-		goto noprovider;
+		return;
 	}
 
-	if (!dbus_connection_send_with_reply(p->dbus, msg, &pending, -1)) {
+	if (!dbus_connection_send_with_reply(p->dbus, msg, &p->status_call,
+					     GETSTATUS_TIMEOUT_MS)) {
 		status_debug("wg-sb: OOM at %s:%s", G_STRFUNC, G_STRLOC);
-		goto noprovider;
+		dbus_message_unref(msg);
+		return;
 	}
 
-	if (pending == NULL) {
+	dbus_message_unref(msg);
+
+	if (p->status_call == NULL) {
 		status_debug("wg-sb: %s: pending == NULL", G_STRFUNC);
-		goto noprovider;
+		return;
 	}
 
-	dbus_connection_flush(p->dbus);
-	dbus_message_unref(msg);
+	if (!dbus_pending_call_set_notify(p->status_call,
+					  provider_status_reply_cb, self,
+					  NULL)) {
+		status_debug("wg-sb: OOM at %s:%s", G_STRFUNC, G_STRLOC);
+		dbus_pending_call_cancel(p->status_call);
+		dbus_pending_call_unref(p->status_call);
+		p->status_call = NULL;
+	}
+}
 
-	dbus_pending_call_block(pending);
-	msg = dbus_pending_call_steal_reply(pending);
-	dbus_pending_call_unref(pending);
+static void load_settings(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	GConfClient *gconf;
 
-	if (msg == NULL) {
-		status_debug("wg-sb: %s: method reply is NULL", G_STRFUNC);
-		goto noprovider;
-	}
+	/* Get current config; make sure to keep this up to date */
+	gconf = gconf_client_get_default();
 
-	if (!dbus_message_iter_init(msg, &args)) {
-		status_debug("wg-sb: %s: reply has no arguments", G_STRFUNC);
-		dbus_message_unref(msg);
-		goto noprovider;
-	}
+	p->active_config =
+	    gconf_client_get_string(gconf, GC_WIREGUARD_ACTIVE, NULL);
+	p->systemwide_enabled =
+	    gconf_client_get_bool(gconf, GC_WIREGUARD_SYSTEM, NULL);
 
-	dbus_message_iter_get_basic(&args, &status);
+	g_object_unref(gconf);
 
-	if (!dbus_message_iter_next(&args)) {
-		status_debug("wg-sb: %s: reply has too few arguments",
-			     G_STRFUNC);
-		dbus_message_unref(msg);
-		goto noprovider;
+	if (p->active_config == NULL)
+		p->active_config = g_strdup("Default");
+}
+
+static GdkPixbuf *load_icon(const gchar * name, gint size)
+{
+	GError *error = NULL;
+	GdkPixbuf *pixbuf;
+
+	pixbuf = gtk_icon_theme_load_icon(gtk_icon_theme_get_default(), name,
+					  size, 0, &error);
+	if (pixbuf == NULL) {
+		status_debug("wg-sb: Unable to load %s: %s", name,
+			     error->message);
+		g_error_free(error);
 	}
 
-	dbus_message_iter_get_basic(&args, &mode);
-	dbus_message_unref(msg);
+	return pixbuf;
+}
 
-	if (!g_strcmp0(ICD_WIREGUARD_SIGNALS_STATUS_MODE_PROVIDER, mode))
-		p->provider_connected = TRUE;
-	else
-		p->provider_connected = FALSE;
+static void unload_icons(StatusAppletWireguardPrivate * p)
+{
+	if (p->pix18_wg_connected)
+		g_object_unref(p->pix18_wg_connected);
+	if (p->pix18_wg_connecting)
+		g_object_unref(p->pix18_wg_connecting);
+	if (p->pix48_wg_disabled)
+		g_object_unref(p->pix48_wg_disabled);
+	if (p->pix48_wg_enabled)
+		g_object_unref(p->pix48_wg_enabled);
+
+	p->pix18_wg_connected = NULL;
+	p->pix18_wg_connecting = NULL;
+	p->pix48_wg_disabled = NULL;
+	p->pix48_wg_enabled = NULL;
+	p->icons_loaded = FALSE;
+	p->menu_icons_loaded = FALSE;
+}
 
-	if (!g_strcmp0(ICD_WIREGUARD_SIGNALS_STATUS_STATE_CONNECTED, status)) {
-		p->connection_state = WIREGUARD_CONNECTED;
-		p->current_status_icon = STATUS_ICON_CONNECTED;
-	} else
-	    if (!g_strcmp0(ICD_WIREGUARD_SIGNALS_STATUS_STATE_STARTED, status))
-	{
-		p->connection_state = WIREGUARD_CONNECTING;
-		p->current_status_icon = STATUS_ICON_CONNECTING;
-	} else {
-		/* ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED */
-		p->connection_state = WIREGUARD_NOT_CONNECTED;
-		p->current_status_icon = STATUS_ICON_NONE;
-	}
+/*
+ * The status area icons are visible right away, so load these early. A
+ * theme change before the startup step already loaded them.
+ */
+static void load_icons(StatusAppletWireguard * self)
+{
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+
+	if (p->icons_loaded)
+		return;
 
-	return;
+	p->icons_loaded = TRUE;
+	p->pix18_wg_connected = load_icon("statusarea_wireguard_connected", 18);
+	p->pix18_wg_connecting =
+	    load_icon("statusarea_wireguard_connecting", 18);
 
- noprovider:
-	p->connection_state = WIREGUARD_NOT_CONNECTED;
-	p->provider_connected = FALSE;
-	p->current_status_icon = STATUS_ICON_NONE;
+	/* Whatever state we are in was shown without icons so far */
+	status_applet_wireguard_set_icons(self);
 }
 
-static void status_applet_wireguard_init(StatusAppletWireguard * self)
+/* The menu icons are only seen once the status menu is opened */
+static void load_menu_icons(StatusAppletWireguardPrivate * p)
 {
-	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(self);
-	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
-	DBusError err;
-	GConfClient *gconf;
-	GtkIconTheme *theme;
+	if (p->menu_icons_loaded)
+		return;
 
-	p->osso = osso_initialize("wg-sb", VERSION, FALSE, NULL);
+	p->pix48_wg_disabled = load_icon("statusarea_wireguard_disabled", 48);
+	p->pix48_wg_enabled = load_icon("statusarea_wireguard_enabled", 48);
+	p->menu_icons_loaded = TRUE;
 
-	dbus_error_init(&err);
+	update_menu_image(p);
+}
 
-	/* Dbus setup for icd provider */
-	setup_dbus_matching(self);
+static void menu_button_mapped_cb(GtkWidget * widget, gpointer data)
+{
+	(void)widget;
+	load_menu_icons(GET_PRIVATE(data));
+	start_stats_poll(data);
+}
+
+static void menu_button_unmapped_cb(GtkWidget * widget, gpointer data)
+{
+	(void)widget;
+	stop_stats_poll(data);
+}
 
-	/* Check if we're connected to a provider */
-	get_provider_status(self);
+static void icon_theme_changed_cb(GtkIconTheme * theme, gpointer data)
+{
+	StatusAppletWireguard *self = STATUS_APPLET_WIREGUARD(data);
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	struct wakeup w;
+	(void)theme;
 
-	/* Get current config; make sure to keep this up to date */
-	gconf = gconf_client_get_default();
+	wakeup_begin(&w, WAKEUP_ICON_THEME);
 
-	p->active_config =
-	    gconf_client_get_string(gconf, GC_WIREGUARD_ACTIVE, NULL);
-	p->systemwide_enabled =
-	    gconf_client_get_bool(gconf, GC_WIREGUARD_SYSTEM, NULL);
+	unload_icons(p);
+	load_icons(self);
 
-	g_object_unref(gconf);
+	/* Old pixbuf is gone; make sure the image gets the new one */
+	p->menu_image_pixbuf = NULL;
+	if (gtk_widget_get_mapped(p->menu_button))
+		load_menu_icons(p);
 
-	if (p->active_config == NULL)
-		p->active_config = "Default";
+	wakeup_end(&w);
+}
 
-	/* Icons */
-	theme = gtk_icon_theme_get_default();
-	p->pix18_wg_connected =
-	    gtk_icon_theme_load_icon(theme, "statusarea_wireguard_connected",
-				     18, 0, NULL);
-	p->pix18_wg_connecting =
-	    gtk_icon_theme_load_icon(theme, "statusarea_wireguard_connecting",
-				     18, 0, NULL);
-	p->pix48_wg_disabled =
-	    gtk_icon_theme_load_icon(theme, "statusarea_wireguard_disabled", 48,
-				     0, NULL);
-	p->pix48_wg_enabled =
-	    gtk_icon_theme_load_icon(theme, "statusarea_wireguard_enabled", 48,
-				     0, NULL);
+static void dump_startup_trace(StatusAppletWireguardPrivate * p)
+{
+	static const gchar *names[N_STARTUP_MARKS] = {
+		"init", "settings", "visible", "status-query", "icons",
+		"prefetch", "dialog", "first-status",
+	};
+	GString *str = g_string_new("wg-sb: startup:");
+	gint i;
+
+	for (i = 0; i < N_STARTUP_MARKS; i++) {
+		if (p->startup_trace[i] == 0)
+			g_string_append_printf(str, " %s=pending", names[i]);
+		else
+			g_string_append_printf(str, " %s=+%" G_GINT64_FORMAT
+					       "us", names[i],
+					       p->startup_trace[i] -
+					       p->startup_trace[STARTUP_INIT]);
+	}
+
+	status_debug("%s", str->str);
+	g_string_free(str, TRUE);
+}
+
+/*
+ * Everything that isn't needed to put the button on screen is done from
+ * a low priority idle source, one step per dispatch, so hildon-desktop
+ * can finish starting up in between.
+ */
+static gboolean deferred_init_cb(gpointer obj)
+{
+	StatusAppletWireguard *self = STATUS_APPLET_WIREGUARD(obj);
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(self);
+	enum startup_mark step = p->startup_step++;
+	struct wakeup w;
+
+	wakeup_begin(&w, WAKEUP_STARTUP);
+
+	switch (step) {
+	case STARTUP_STATUS_QUERY:
+		/* Ask if we're connected to a provider, the reply comes later */
+		get_provider_status(self);
+		break;
+	case STARTUP_ICONS:
+		load_icons(self);
+		break;
+	case STARTUP_PREFETCH:
+		prefetch_endpoints(p->active_config);
+		break;
+	case STARTUP_DIALOG:
+		build_settings_dialog(self);
+		load_config_names(p);
+		break;
+	default:
+		p->init_source = 0;
+		dump_startup_trace(p);
+		wakeup_end(&w);
+		return FALSE;
+	}
+
+	trace_startup(p, step);
+	wakeup_end(&w);
+	return TRUE;
+}
+
+static void status_applet_wireguard_init(StatusAppletWireguard * self)
+{
+	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(self);
+	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
+
+	trace_startup(p, STARTUP_INIT);
+	conn_machine_init(&p->conn, p->startup_trace[STARTUP_INIT]);
+	prewarm_init(&p->prewarm);
+	tunnel_set_init(&p->tunnels);
+	p->on_battery = TRUE;
+	wg_keepalive_reset(&p->keepalive, p->startup_trace[STARTUP_INIT]);
+
+	open_signal_trace(p);
+
+	/*
+	 * Status signals and the status reply are about the active config,
+	 * or name none and mean it. It has to be known before either comes.
+	 */
+	load_settings(self);
+	trace_startup(p, STARTUP_SETTINGS);
+
+	/* Dbus setup for icd provider, so no StatusChanged gets lost */
+	setup_dbus_matching(self);
 
 	/* Gtk items */
 	p->menu_button =
@@ -534,9 +2988,21 @@ static void status_applet_wireguard_init(StatusAppletWireguard * self)
 
 	g_signal_connect(p->menu_button, "clicked",
 			 G_CALLBACK(status_menu_clicked_cb), self);
+	g_signal_connect(p->menu_button, "map",
+			 G_CALLBACK(menu_button_mapped_cb), self);
+	g_signal_connect(p->menu_button, "unmap",
+			 G_CALLBACK(menu_button_unmapped_cb), self);
+	g_signal_connect(gtk_icon_theme_get_default(), "changed",
+			 G_CALLBACK(icon_theme_changed_cb), self);
 
 	gtk_container_add(GTK_CONTAINER(sa), p->menu_button);
 	gtk_widget_show_all(GTK_WIDGET(sa));
+
+	trace_startup(p, STARTUP_VISIBLE);
+
+	p->startup_step = STARTUP_STATUS_QUERY;
+	p->init_source = g_idle_add_full(G_PRIORITY_LOW, deferred_init_cb, sa,
+					 NULL);
 }
 
 static void status_applet_wireguard_finalize(GObject * obj)
@@ -544,8 +3010,61 @@ static void status_applet_wireguard_finalize(GObject * obj)
 	StatusAppletWireguard *sa = STATUS_APPLET_WIREGUARD(obj);
 	StatusAppletWireguardPrivate *p = GET_PRIVATE(sa);
 
+	if (p->init_source) {
+		g_source_remove(p->init_source);
+		p->init_source = 0;
+	}
+
+	if (p->status_source) {
+		g_source_remove(p->status_source);
+		p->status_source = 0;
+	}
+
+	if (p->warm_source) {
+		g_source_remove(p->warm_source);
+		p->warm_source = 0;
+	}
+
+	stop_blink(sa);
+	stop_stats_poll(sa);
+	stop_recovery(p);
+	wg_mtu_probe_cancel(p->mtu_probe);
+	wg_speedtest_cancel(p->speedtest);
+	stop_history(sa);
+	history_close(p->history);
+	save_live_config(p);
+	g_free(p->history_config);
+	g_free(p->bearer);
+	tun_stats_free(p->tun_stats);
+
+	if (p->failed_configs)
+		g_hash_table_destroy(p->failed_configs);
+	dump_debug_stats(p);
+
+	if (p->signal_trace) {
+		fclose(p->signal_trace);
+		p->signal_trace = NULL;
+	}
+
+	if (p->status_call) {
+		dbus_pending_call_cancel(p->status_call);
+		dbus_pending_call_unref(p->status_call);
+		p->status_call = NULL;
+	}
+	cancel_keepalive_call(p);
+
 	if (p->dbus) {
 		dbus_bus_remove_match(p->dbus, DBUS_SIGNAL, NULL);
+		dbus_bus_remove_match(p->dbus, MCE_DISPLAY_SIGNAL, NULL);
+		dbus_bus_remove_match(p->dbus, BME_SIGNAL(BME_CHARGER_CONNECTED),
+				      NULL);
+		dbus_bus_remove_match(p->dbus,
+				      BME_SIGNAL(BME_CHARGER_DISCONNECTED),
+				      NULL);
+		dbus_bus_remove_match(p->dbus, ICD_STATE_SIGNAL, NULL);
+#ifdef ENABLE_DEBUG_DUMP
+		dbus_bus_remove_match(p->dbus, DEBUG_DUMP_SIGNAL, NULL);
+#endif
 		dbus_connection_remove_filter(p->dbus,
 					      (DBusHandleMessageFunction)
 					      on_icd_signal, sa);
@@ -553,6 +3072,28 @@ static void status_applet_wireguard_finalize(GObject * obj)
 		p->dbus = NULL;
 	}
 
+	if (p->settings_dialog) {
+		g_signal_handlers_disconnect_by_func(p->settings_dialog,
+						     settings_dialog_destroyed_cb,
+						     sa);
+		gtk_widget_destroy(p->settings_dialog);
+		p->settings_dialog = NULL;
+	}
+
+	if (p->config_names)
+		g_ptr_array_free(p->config_names, TRUE);
+
+	wg_prober_free(p->prober);
+	conn_machine_clear(&p->conn);
+	prewarm_clear(&p->prewarm);
+	tunnel_set_clear(&p->tunnels);
+
+	g_signal_handlers_disconnect_by_func(gtk_icon_theme_get_default(),
+					     icon_theme_changed_cb, sa);
+	unload_icons(p);
+
+	g_free(p->active_config);
+
 	if (p->osso)
 		osso_deinitialize(p->osso);
 
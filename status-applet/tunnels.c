@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+
+#include <glib.h>
+
+#include "tunnels.h"
+
+static const gchar *const state_names[] = {
+	[CONN_DOWN] = "down",
+	[CONN_CONNECTING] = "connecting",
+	[CONN_UP] = "up",
+};
+
+void tunnel_set_init(struct tunnel_set *ts)
+{
+	memset(ts, 0, sizeof(*ts));
+	ts->tunnels = g_array_new(FALSE, TRUE, sizeof(struct tunnel));
+	/* Keys are the config names owned by the array */
+	ts->index = g_hash_table_new(g_str_hash, g_str_equal);
+	ts->dirty = g_array_new(FALSE, FALSE, sizeof(guint));
+}
+
+void tunnel_set_clear(struct tunnel_set *ts)
+{
+	guint i;
+
+	if (ts->tunnels == NULL)
+		return;
+
+	for (i = 0; i < ts->tunnels->len; i++)
+		g_free(tunnel_set_nth(ts, i)->config);
+
+	g_hash_table_destroy(ts->index);
+	g_array_free(ts->tunnels, TRUE);
+	g_array_free(ts->dirty, TRUE);
+	memset(ts, 0, sizeof(*ts));
+}
+
+/* The index of the tunnel running config, added as down if it is new */
+static guint tunnel_index(struct tunnel_set *ts, const gchar * config)
+{
+	struct tunnel t = { 0 };
+	guint i;
+
+	if (config == NULL)
+		config = "";
+
+	i = GPOINTER_TO_UINT(g_hash_table_lookup(ts->index, config));
+	if (i)
+		return i - 1;
+
+	t.config = g_strdup(config);
+	g_array_append_val(ts->tunnels, t);
+	i = ts->tunnels->len - 1;
+	g_hash_table_insert(ts->index, t.config, GUINT_TO_POINTER(i + 1));
+	ts->counts[CONN_DOWN]++;
+
+	return i;
+}
+
+static gboolean set_state(struct tunnel_set *ts, guint i,
+			  enum conn_state state, gboolean provider)
+{
+	struct tunnel *t = tunnel_set_nth(ts, i);
+
+	if (t->state == state && t->provider == provider)
+		return FALSE;
+
+	ts->counts[t->state]--;
+	ts->counts[state]++;
+	t->state = state;
+	t->provider = provider;
+
+	return TRUE;
+}
+
+/*
+ * Remember the state a signal reported; only the last one of a burst is
+ * applied. This is a lookup and an append, however many tunnels there
+ * are.
+ */
+void tunnel_set_stage(struct tunnel_set *ts, const gchar * config,
+		      enum conn_state state, gboolean provider)
+{
+	guint i = tunnel_index(ts, config);
+	struct tunnel *t = tunnel_set_nth(ts, i);
+
+	t->pending_state = state;
+	t->pending_provider = provider;
+
+	if (!t->dirty) {
+		t->dirty = TRUE;
+		g_array_append_val(ts->dirty, i);
+	}
+}
+
+/* Apply what was staged. Returns TRUE if any tunnel changed. */
+gboolean tunnel_set_flush(struct tunnel_set *ts)
+{
+	gboolean changed = FALSE;
+	struct tunnel *t;
+	guint i;
+
+	for (i = 0; i < ts->dirty->len; i++) {
+		t = tunnel_set_nth(ts, g_array_index(ts->dirty, guint, i));
+		t->dirty = FALSE;
+		changed |= set_state(ts, g_array_index(ts->dirty, guint, i),
+				     t->pending_state, t->pending_provider);
+	}
+	g_array_set_size(ts->dirty, 0);
+
+	return changed;
+}
+
+/* Set a state right away, e.g. from a GetStatus reply */
+gboolean tunnel_set_update(struct tunnel_set *ts, const gchar * config,
+			   enum conn_state state, gboolean provider)
+{
+	guint i = tunnel_index(ts, config);
+	struct tunnel *t = tunnel_set_nth(ts, i);
+
+	/* A staged state is older than this one */
+	t->pending_state = state;
+	t->pending_provider = provider;
+
+	return set_state(ts, i, state, provider);
+}
+
+/*
+ * The tunnel running from is now running to, after the active config
+ * changed. Its state, and anything staged for it, moves along.
+ */
+void tunnel_set_rename(struct tunnel_set *ts, const gchar * from,
+		       const gchar * to)
+{
+	struct tunnel *src, *dst;
+	guint i, j;
+
+	if (!g_strcmp0(from, to)
+	    || !g_hash_table_lookup(ts->index, from ? from : ""))
+		return;
+
+	j = tunnel_index(ts, to);
+	i = tunnel_index(ts, from);
+	src = tunnel_set_nth(ts, i);
+
+	set_state(ts, j, src->state, src->provider);
+	set_state(ts, i, CONN_DOWN, FALSE);
+
+	if (src->dirty) {
+		tunnel_set_stage(ts, to, src->pending_state,
+				 src->pending_provider);
+		src->pending_state = CONN_DOWN;
+		src->pending_provider = FALSE;
+	} else {
+		dst = tunnel_set_nth(ts, j);
+		dst->pending_state = dst->state;
+		dst->pending_provider = dst->provider;
+	}
+}
+
+/* What the status icon shows: up if any tunnel is */
+enum conn_state tunnel_set_state(struct tunnel_set *ts)
+{
+	if (ts->counts[CONN_UP])
+		return CONN_UP;
+	if (ts->counts[CONN_CONNECTING])
+		return CONN_CONNECTING;
+	return CONN_DOWN;
+}
+
+guint tunnel_set_count(struct tunnel_set *ts, enum conn_state state)
+{
+	return ts->counts[state];
+}
+
+gchar *tunnel_set_dump(struct tunnel_set *ts)
+{
+	GString *s = g_string_new(NULL);
+	struct tunnel *t;
+	guint i;
+
+	g_string_append_printf(s, "tunnels %u up %u connecting %u down",
+			       ts->counts[CONN_UP], ts->counts[CONN_CONNECTING],
+			       ts->counts[CONN_DOWN]);
+
+	for (i = 0; i < ts->tunnels->len; i++) {
+		t = tunnel_set_nth(ts, i);
+		g_string_append_printf(s, "; %s %s%s",
+				       *t->config ? t->config : "(none)",
+				       state_names[t->state],
+				       t->provider ? " provider" : "");
+	}
+
+	return g_string_free(s, FALSE);
+}
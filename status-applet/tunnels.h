@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __TUNNELS_H__
+#define __TUNNELS_H__
+
+#include <glib.h>
+
+#include "connstats.h"
+
+/*
+ * Every tunnel the provider told us about, by config name; the one on
+ * wg0 with the active config is among them. Tunnels that go down stay
+ * in the set as CONN_DOWN, so their index never changes.
+ */
+struct tunnel {
+	gchar *config;
+	enum conn_state state;
+	gboolean provider;
+	/* Last state of a signal burst, applied by tunnel_set_flush() */
+	enum conn_state pending_state;
+	gboolean pending_provider;
+	gboolean dirty;
+};
+
+struct tunnel_set {
+	/* struct tunnel, in the order they were first seen */
+	GArray *tunnels;
+	/* config name -> index + 1 into tunnels */
+	GHashTable *index;
+	/* Indices of the tunnels with a pending state */
+	GArray *dirty;
+	/* Tunnels in each state, so the summary needs no walk */
+	guint counts[CONN_UP + 1];
+};
+
+#define tunnel_set_nth(ts, i) (&g_array_index((ts)->tunnels, struct tunnel, (i)))
+
+void tunnel_set_init(struct tunnel_set *ts);
+void tunnel_set_clear(struct tunnel_set *ts);
+
+void tunnel_set_stage(struct tunnel_set *ts, const gchar * config,
+		      enum conn_state state, gboolean provider);
+gboolean tunnel_set_flush(struct tunnel_set *ts);
+gboolean tunnel_set_update(struct tunnel_set *ts, const gchar * config,
+			   enum conn_state state, gboolean provider);
+void tunnel_set_rename(struct tunnel_set *ts, const gchar * from,
+		       const gchar * to);
+
+enum conn_state tunnel_set_state(struct tunnel_set *ts);
+guint tunnel_set_count(struct tunnel_set *ts, enum conn_state state);
+gchar *tunnel_set_dump(struct tunnel_set *ts);
+
+#endif
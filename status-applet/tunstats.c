@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tunstats.h"
+#include "wgnl.h"
+
+/* Peers decoded per sample; more than that is counted through sysfs */
+#define TUN_STATS_MAX_PEERS 8
+
+struct tun_stats {
+	gchar ifname[IFNAMSIZ];
+	struct wg_nl *nl;
+	/* Netlink failed for good, e.g. we lack CAP_NET_ADMIN */
+	gboolean no_netlink;
+	struct wg_nl_peer peers[TUN_STATS_MAX_PEERS];
+	struct wg_nl_device dev;
+};
+
+struct tun_stats *tun_stats_new(const gchar * ifname)
+{
+	struct tun_stats *ts = g_new0(struct tun_stats, 1);
+
+	g_strlcpy(ts->ifname, ifname, sizeof(ts->ifname));
+	ts->dev.peers = ts->peers;
+	ts->dev.max_peers = TUN_STATS_MAX_PEERS;
+
+	return ts;
+}
+
+void tun_stats_free(struct tun_stats *ts)
+{
+	if (ts == NULL)
+		return;
+
+	wg_nl_close(ts->nl);
+	g_free(ts);
+}
+
+static gboolean read_counter(const gchar * ifname, const gchar * name,
+			     guint64 * value)
+{
+	gchar path[96], buf[32];
+	ssize_t len;
+	int fd;
+
+	g_snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s",
+		   ifname, name);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return FALSE;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return FALSE;
+
+	buf[len] = '\0';
+	*value = g_ascii_strtoull(buf, NULL, 10);
+	return TRUE;
+}
+
+static gboolean sample_sysfs(struct tun_stats *ts, struct tun_sample *s)
+{
+	return read_counter(ts->ifname, "rx_bytes", &s->rx_bytes)
+	    && read_counter(ts->ifname, "tx_bytes", &s->tx_bytes);
+}
+
+static gboolean sample_netlink(struct tun_stats *ts, struct tun_sample *s)
+{
+	guint i;
+	int ret;
+
+	if (ts->nl == NULL) {
+		ts->nl = wg_nl_open();
+		if (ts->nl == NULL) {
+			ts->no_netlink = TRUE;
+			return FALSE;
+		}
+	}
+
+	ret = wg_nl_get_device(ts->nl, ts->ifname, &ts->dev);
+	if (ret == -EPERM || ret == -EACCES) {
+		ts->no_netlink = TRUE;
+		wg_nl_close(ts->nl);
+		ts->nl = NULL;
+	}
+	if (ret < 0)
+		return FALSE;
+
+	for (i = 0; i < MIN(ts->dev.n_peers, TUN_STATS_MAX_PEERS); i++) {
+		struct wg_nl_peer *peer = &ts->peers[i];
+
+		s->rx_bytes += peer->rx_bytes;
+		s->tx_bytes += peer->tx_bytes;
+		if (peer->last_handshake > s->last_handshake)
+			s->last_handshake = peer->last_handshake;
+	}
+
+	/* Partial sums are worse than none */
+	if (ts->dev.n_peers > TUN_STATS_MAX_PEERS)
+		return sample_sysfs(ts, s);
+
+	return TRUE;
+}
+
+/*
+ * Take one sample of the tunnel counters. Netlink also gives the latest
+ * handshake, but reading it needs CAP_NET_ADMIN; without that, only the
+ * interface byte counters from sysfs are available.
+ */
+gboolean tun_stats_sample(struct tun_stats *ts, struct tun_sample *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->time = g_get_monotonic_time();
+
+	if (!ts->no_netlink && sample_netlink(ts, s))
+		return TRUE;
+
+	s->last_handshake = 0;
+	if (sample_sysfs(ts, s))
+		return TRUE;
+
+	s->time = 0;
+	return FALSE;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __TUNSTATS_H__
+#define __TUNSTATS_H__
+
+#include <glib.h>
+
+/* The interface the provider brings the tunnel up on */
+#ifndef WG_IFNAME
+#define WG_IFNAME "wg0"
+#endif
+
+struct tun_sample {
+	/* Monotonic time of the sample, 0 if there is none */
+	gint64 time;
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+	/* Seconds since the epoch of the newest handshake, 0 if unknown */
+	gint64 last_handshake;
+};
+
+struct tun_stats;
+
+struct tun_stats *tun_stats_new(const gchar * ifname);
+void tun_stats_free(struct tun_stats *ts);
+gboolean tun_stats_sample(struct tun_stats *ts, struct tun_sample *s);
+
+#endif
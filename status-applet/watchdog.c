@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+
+#include <glib.h>
+
+#include "watchdog.h"
+
+/* Start watching a tunnel that just came up */
+void watchdog_reset(struct watchdog *wd, guint failover_s, gint64 now)
+{
+	gint64 last_failover = wd->last_failover;
+	gint64 backoff = wd->backoff;
+
+	memset(wd, 0, sizeof(*wd));
+	wd->failover_after = (gint64) failover_s * G_USEC_PER_SEC;
+	wd->last_progress = now;
+
+	/* Backoff outlives reconnects, that's what stops the flapping */
+	wd->last_failover = last_failover;
+	wd->backoff = backoff ? backoff : wd->failover_after;
+}
+
+/*
+ * Look at a new sample of the tunnel counters. Anything received, or a
+ * fresh handshake, is progress. Sending without any progress for longer
+ * than WATCHDOG_STALE_S degrades the tunnel, and staying degraded for
+ * failover_after asks for a failover, unless the last one is too recent.
+ */
+enum watchdog_verdict watchdog_feed(struct watchdog *wd,
+				    const struct tun_sample *s, gint64 now)
+{
+	if (s->rx_bytes != wd->rx_bytes
+	    || s->last_handshake > wd->last_handshake) {
+		wd->last_progress = now;
+		wd->tx_at_progress = s->tx_bytes;
+	}
+	wd->rx_bytes = s->rx_bytes;
+	wd->last_handshake = s->last_handshake;
+
+	if (s->tx_bytes == wd->tx_at_progress
+	    || now - wd->last_progress <
+	    (gint64) WATCHDOG_STALE_S * G_USEC_PER_SEC) {
+		wd->degraded_since = 0;
+
+		/* Healthy for long enough, forget about earlier trouble */
+		if (wd->last_failover && now - wd->last_failover >
+		    (gint64) WATCHDOG_BACKOFF_MAX_S * G_USEC_PER_SEC) {
+			wd->last_failover = 0;
+			wd->backoff = wd->failover_after;
+		}
+
+		return WATCHDOG_HEALTHY;
+	}
+
+	if (wd->degraded_since == 0)
+		wd->degraded_since = now;
+
+	if (wd->failover_after == 0
+	    || now - wd->degraded_since < wd->failover_after)
+		return WATCHDOG_DEGRADED;
+
+	if (wd->last_failover && now - wd->last_failover < wd->backoff)
+		return WATCHDOG_DEGRADED;
+
+	return WATCHDOG_FAILOVER;
+}
+
+void watchdog_failed_over(struct watchdog *wd, gint64 now)
+{
+	wd->last_failover = now;
+	wd->backoff = MIN(wd->backoff * 2,
+			  (gint64) WATCHDOG_BACKOFF_MAX_S * G_USEC_PER_SEC);
+	wd->degraded_since = 0;
+	wd->last_progress = now;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __WATCHDOG_H__
+#define __WATCHDOG_H__
+
+#include <glib.h>
+
+#include "tunstats.h"
+
+/*
+ * WireGuard drops a session after 180 s without a handshake, so a tunnel
+ * that sends but hears nothing back for longer than that is dead.
+ */
+#define WATCHDOG_STALE_S 180
+#define WATCHDOG_FAILOVER_S 300
+/* Failovers never come closer than this once they keep failing */
+#define WATCHDOG_BACKOFF_MAX_S 3600
+
+enum watchdog_verdict {
+	WATCHDOG_HEALTHY = 0,
+	WATCHDOG_DEGRADED,
+	WATCHDOG_FAILOVER,
+};
+
+/* All times are monotonic microseconds passed in by the caller */
+struct watchdog {
+	gint64 failover_after;
+	gint64 backoff;
+
+	gint64 last_progress;
+	guint64 rx_bytes;
+	guint64 tx_at_progress;
+	gint64 last_handshake;
+
+	gint64 degraded_since;
+	gint64 last_failover;
+};
+
+void watchdog_reset(struct watchdog *wd, guint failover_s, gint64 now);
+enum watchdog_verdict watchdog_feed(struct watchdog *wd,
+				    const struct tun_sample *s, gint64 now);
+void watchdog_failed_over(struct watchdog *wd, gint64 now);
+
+#endif
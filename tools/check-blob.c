@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "blob.h"
+#include "check.h"
+
+/*
+ * Allowed IP parsing, file names, and loading blobs built here by hand:
+ * intact, then damaged in every field wg_blob_valid() looks at. Then a
+ * timing of loading a blob against the string parsing the gconf path
+ * does for the same config, which doesn't count the gconf round trips.
+ */
+
+#define BENCH_PEERS 50
+#define BENCH_ROUNDS 2000
+
+struct ips_case {
+	const gchar *s;
+	/* Addresses parsed, -1 if the list must be refused */
+	gint n;
+	guint8 cidr;
+};
+
+static const struct ips_case ips_cases[] = {
+	{"10.0.0.0/24", 1, 24},
+	{"10.0.0.1", 1, 32},
+	{"fd00::/64", 1, 64},
+	{"fd00::1", 1, 128},
+	{"0.0.0.0/0, ::/0", 2, 0},
+	{" 10.1.0.0/16 ,", 1, 16},
+	{"", 0, 0},
+	{"10.0.0.0/32", 1, 32},
+	{"fd00::/128", 1, 128},
+	{"10.0.0.0/xyz", -1, 0},
+	{"10.0.0.0/99", -1, 0},
+	{"10.0.0.0/33", -1, 0},
+	{"fd00::/129", -1, 0},
+	{"10.0.0.0/", -1, 0},
+	{"10.0.0.0/24x", -1, 0},
+	{"10.0.0.0/-1", -1, 0},
+	{"10.0.0.0/+8", -1, 0},
+	{"10.0.0.0/99999999999999999999", -1, 0},
+	{"10.0.0.0/24, 10.0.0.300", -1, 0},
+};
+
+static void check_allowed_ips(void)
+{
+	GArray *ips;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(ips_cases); i++) {
+		ips = wg_parse_allowed_ips(ips_cases[i].s);
+		CHECK(ips_cases[i].n < 0 ? ips == NULL : ips
+		      && ips->len == (guint) ips_cases[i].n,
+		      "allowed IPs \"%s\"", ips_cases[i].s);
+		if (ips && ips->len)
+			CHECK(g_array_index(ips, struct wg_nl_allowedip, 0).cidr
+			      == ips_cases[i].cidr, "prefix of \"%s\"",
+			      ips_cases[i].s);
+		if (ips)
+			g_array_free(ips, TRUE);
+	}
+}
+
+static void check_paths(void)
+{
+	static const gchar *names[] = {
+		"home vpn", "home_vpn", "home%20vpn", "a/b", "a_b", "..", "",
+	};
+	gchar *paths[G_N_ELEMENTS(names)], *dir;
+	guint i, j;
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++) {
+		paths[i] = wg_blob_path(names[i]);
+		dir = g_path_get_dirname(paths[i]);
+		CHECK(g_str_has_suffix(dir, "/wireguard"),
+		      "\"%s\" leaves the directory: %s", names[i], paths[i]);
+		g_free(dir);
+
+		for (j = 0; j < i; j++)
+			CHECK(strcmp(paths[i], paths[j]), "\"%s\" and \"%s\" "
+			      "share %s", names[i], names[j], paths[i]);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++)
+		g_free(paths[i]);
+}
+
+/* A blob as wg_blob_compile() writes it; *hash gets its hex SHA-256 */
+static GByteArray *build_blob(guint n_peers, guint n_ips, gchar ** hash)
+{
+	GByteArray *out = g_byte_array_new();
+	struct wg_blob_header header;
+	struct wg_blob_peer peer;
+	struct wg_nl_allowedip ip;
+	static const gchar host[] = "vpn.example.org";
+	gsize size, hash_len = WG_BLOB_HASH_LEN;
+	GChecksum *sum;
+	guint i, j;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = WG_BLOB_MAGIC;
+	header.version = WG_BLOB_VERSION;
+	header.n_peers = n_peers;
+	memset(header.private_key, 0x11, WG_KEY_LEN);
+	g_byte_array_append(out, (guint8 *) & header, sizeof(header));
+
+	for (i = 0; i < n_peers; i++) {
+		memset(&peer, 0, sizeof(peer));
+		peer.public_key[0] = i;
+		peer.public_key[1] = i >> 8;
+		peer.n_ips = n_ips;
+		peer.keepalive = 25;
+		peer.port = 51820;
+		peer.endpoint_kind = WG_ENDPOINT_HOSTNAME;
+		peer.host_len = strlen(host);
+
+		size = sizeof(peer) + n_ips * sizeof(ip) + peer.host_len + 1;
+		peer.record_size = (size + 7) & ~(gsize) 7;
+		g_byte_array_append(out, (guint8 *) & peer, sizeof(peer));
+
+		for (j = 0; j < n_ips; j++) {
+			memset(&ip, 0, sizeof(ip));
+			ip.family = AF_INET;
+			ip.addr.ip4.s_addr = htonl(0x0a000000 | i << 8 | j);
+			ip.cidr = 32;
+			g_byte_array_append(out, (guint8 *) & ip, sizeof(ip));
+		}
+
+		/* NUL and padding */
+		g_byte_array_append(out, (guint8 *) host, peer.host_len);
+		for (size--; size < peer.record_size; size++)
+			g_byte_array_append(out, (guint8 *) "", 1);
+	}
+
+	((struct wg_blob_header *)out->data)->size = out->len;
+
+	sum = g_checksum_new(G_CHECKSUM_SHA256);
+	g_checksum_update(sum, out->data + sizeof(header),
+			  out->len - sizeof(header));
+	*hash = g_strdup(g_checksum_get_string(sum));
+	g_checksum_get_digest(sum, ((struct wg_blob_header *)out->data)->hash,
+			      &hash_len);
+	g_checksum_free(sum);
+
+	return out;
+}
+
+static gboolean valid(const guint8 * data, gsize len)
+{
+	struct wg_blob blob = {.data = (gchar *) data,.len = len };
+
+	blob.header = (const struct wg_blob_header *)data;
+	return wg_blob_valid(&blob);
+}
+
+/* The first peer record of a blob */
+#define PEER0(data) ((struct wg_blob_peer *)((data) + \
+					     sizeof(struct wg_blob_header)))
+
+static void check_valid(void)
+{
+	struct wg_blob_header *header;
+	GByteArray *out;
+	guint8 *copy;
+	gchar *hash;
+	gsize len;
+
+	out = build_blob(3, 2, &hash);
+	len = out->len;
+	copy = g_malloc(len);
+	header = (struct wg_blob_header *)copy;
+
+	CHECK(valid(out->data, len), "intact blob");
+	CHECK(!valid(out->data, len - 1), "truncated blob");
+	CHECK(!valid(out->data, sizeof(*header) - 1), "truncated header");
+
+#define DAMAGED(what, change) do {				\
+	memcpy(copy, out->data, len);				\
+	change;							\
+	CHECK(!valid(copy, len), "blob with " what);		\
+} while (0)
+
+	DAMAGED("bad magic", header->magic++);
+	DAMAGED("other version", header->version++);
+	DAMAGED("wrong size", header->size--);
+	DAMAGED("a peer more", header->n_peers++);
+	DAMAGED("a peer less", header->n_peers--);
+	DAMAGED("huge record", PEER0(copy)->record_size = 0x7ffffff8);
+	DAMAGED("short record", PEER0(copy)->record_size = 8);
+	DAMAGED("too many IPs", PEER0(copy)->n_ips = 0x10000000);
+	DAMAGED("long host", PEER0(copy)->host_len = 255);
+
+	g_free(copy);
+	g_byte_array_free(out, TRUE);
+	g_free(hash);
+}
+
+static gchar *write_tmp(const GByteArray * out)
+{
+	GError *error = NULL;
+	gchar *path;
+	int fd;
+
+	fd = g_file_open_tmp("check-blob-XXXXXX", &path, &error);
+	if (fd < 0) {
+		printf("FAIL: %s\n", error->message);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	g_file_set_contents(path, (gchar *) out->data, out->len, NULL);
+	return path;
+}
+
+static void check_load(void)
+{
+	const struct wg_blob_peer *peer = NULL;
+	const struct wg_nl_allowedip *ips;
+	struct wg_blob *blob;
+	guint8 key[WG_KEY_LEN];
+	GByteArray *out;
+	gchar *hash, *path;
+	guint n = 0;
+
+	out = build_blob(3, 2, &hash);
+	path = write_tmp(out);
+
+	blob = wg_blob_load_file(path, hash);
+	CHECK(blob != NULL, "loading an intact blob");
+	if (blob) {
+		while ((peer = wg_blob_next_peer(blob, peer)))
+			n++;
+		CHECK(n == 3, "%u peers", n);
+
+		memset(key, 0, sizeof(key));
+		key[0] = 2;
+		peer = wg_blob_find_peer(blob, key);
+		ips = peer ? wg_blob_peer_ips(peer) : NULL;
+		CHECK(ips && ips[1].addr.ip4.s_addr == htonl(0x0a000201)
+		      && !strcmp(wg_blob_peer_host(peer), "vpn.example.org"),
+		      "third peer");
+		wg_blob_free(blob);
+	}
+
+	/* Not what the config compiled to */
+	CHECK(!wg_blob_load_file(path, "00"), "blob with another hash");
+
+	out->data[out->len - 1] ^= 1;
+	g_file_set_contents(path, (gchar *) out->data, out->len, NULL);
+	CHECK(!wg_blob_load_file(path, hash), "blob changed after hashing");
+
+	g_unlink(path);
+	CHECK(!wg_blob_load_file(path, hash), "missing blob");
+
+	g_free(path);
+	g_free(hash);
+	g_byte_array_free(out, TRUE);
+}
+
+/* What wg_blob_compile() does with the strings gconf returns for a peer */
+static gboolean parse_peer_strings(const gchar * pubkey, const gchar * psk,
+				   const gchar * endpoint,
+				   const gchar * allowed)
+{
+	struct wg_endpoint ep;
+	guchar *raw;
+	GArray *ips;
+	gsize len;
+	gboolean ok;
+
+	raw = g_base64_decode(pubkey, &len);
+	ok = wg_validate_key(pubkey, -1) && len == WG_KEY_LEN;
+	g_free(raw);
+	raw = g_base64_decode(psk, &len);
+	ok = ok && wg_validate_key(psk, -1) && len == WG_KEY_LEN;
+	g_free(raw);
+
+	ok = ok && wg_parse_endpoint(endpoint, -1, &ep) != WG_ENDPOINT_INVALID;
+
+	ips = wg_parse_allowed_ips(allowed);
+	ok = ok && ips;
+	if (ips)
+		g_array_free(ips, TRUE);
+
+	return ok;
+}
+
+static void bench(void)
+{
+	struct wg_blob *blob;
+	GByteArray *out;
+	gchar *hash, *path, *key;
+	guint8 raw[WG_KEY_LEN];
+	gint64 start, blob_ns, strings_ns;
+	guint i, j;
+	gboolean ok = TRUE;
+
+	out = build_blob(BENCH_PEERS, 2, &hash);
+	path = write_tmp(out);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		blob = wg_blob_load_file(path, hash);
+		ok = ok && blob;
+		wg_blob_free(blob);
+	}
+	blob_ns = (g_get_monotonic_time() - start) * 1000 / BENCH_ROUNDS;
+	CHECK(ok, "bench blob");
+
+	memset(raw, 0x42, sizeof(raw));
+	key = g_base64_encode(raw, sizeof(raw));
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		for (j = 0; j < BENCH_PEERS; j++)
+			ok = ok && parse_peer_strings(key, key,
+						      "vpn.example.org:51820",
+						      "10.0.0.1/32, 10.0.0.2/32");
+	strings_ns = (g_get_monotonic_time() - start) * 1000 / BENCH_ROUNDS;
+	CHECK(ok, "bench strings");
+
+	printf("%u peers: blob %" G_GINT64_FORMAT " ns, parsing gconf "
+	       "strings %" G_GINT64_FORMAT " ns plus the gconf round trips\n",
+	       BENCH_PEERS, blob_ns, strings_ns);
+
+	g_unlink(path);
+	g_free(path);
+	g_free(key);
+	g_free(hash);
+	g_byte_array_free(out, TRUE);
+}
+
+int main(void)
+{
+	check_allowed_ips();
+	check_paths();
+	check_valid();
+	check_load();
+	bench();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
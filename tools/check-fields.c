@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "fields.h"
+#include "validate.h"
+
+/*
+ * The wizard's interface page without GTK: the fields get the texts a
+ * new config starts with and are checked once, as the page does when it
+ * is built. Filling in a key and an address must then be enough to
+ * finish it.
+ */
+
+#define KEY "yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBmk="
+
+/* The page derives the public key with wg, the key itself is enough here */
+static gboolean validate_key(struct wizard_data *w_data, const gchar * text)
+{
+	(void)w_data;
+	return wg_validate_key(text, -1);
+}
+
+static gboolean (*const validators[N_FIELDS]) (struct wizard_data *,
+					       const gchar *) = {
+	[FIELD_PRIVKEY] = validate_key,
+	[FIELD_ADDRESS] = wizard_validate_address,
+	[FIELD_DNS] = wizard_validate_dns,
+	[FIELD_MTU] = wizard_validate_mtu,
+	[FIELD_SPEEDTEST] = wizard_validate_speedtest,
+};
+
+/* What new_wizard_local_page() puts in the entries of a new config */
+static const gchar *const fresh[N_FIELDS] = {
+	[FIELD_PRIVKEY] = "",
+	[FIELD_ADDRESS] = "",
+	[FIELD_DNS] = FIELD_OPTIONAL_TEXT,
+	[FIELD_MTU] = FIELD_MTU_AUTO_TEXT,
+	[FIELD_SPEEDTEST] = FIELD_OPTIONAL_TEXT,
+};
+
+static struct validation_stats stats;
+
+static void setup(struct wizard_field *fields)
+{
+	gint i;
+
+	for (i = 0; i < N_FIELDS; i++)
+		wizard_field_init(&fields[i], NULL, NULL, validators[i]);
+}
+
+static void clear(struct wizard_field *fields)
+{
+	gint i;
+
+	for (i = 0; i < N_FIELDS; i++)
+		wizard_field_reset(&fields[i]);
+}
+
+static void check_fresh_page(void)
+{
+	struct wizard_field fields[N_FIELDS] = { {0} };
+	gint i;
+
+	setup(fields);
+	for (i = 0; i < N_FIELDS; i++)
+		wizard_field_check(&fields[i], fresh[i], &stats);
+
+	CHECK(!wizard_fields_complete(fields), "complete without a key");
+	for (i = FIELD_DNS; i < N_FIELDS; i++)
+		CHECK(fields[i].valid, "field %d invalid as it starts out", i);
+
+	wizard_field_check(&fields[FIELD_PRIVKEY], KEY, &stats);
+	CHECK(!wizard_fields_complete(fields), "complete without an address");
+	wizard_field_check(&fields[FIELD_ADDRESS], "10.0.0.2/32", &stats);
+	CHECK(wizard_fields_complete(fields),
+	      "not complete with a key and an address");
+
+	clear(fields);
+	CHECK(!wizard_fields_complete(fields), "complete after a reset");
+}
+
+/* Fields that were never checked keep the page from completing */
+static void check_unchecked(void)
+{
+	struct wizard_field fields[N_FIELDS] = { {0} };
+
+	setup(fields);
+	wizard_field_check(&fields[FIELD_PRIVKEY], KEY, &stats);
+	wizard_field_check(&fields[FIELD_ADDRESS], "10.0.0.2/32", &stats);
+	CHECK(!wizard_fields_complete(fields),
+	      "complete with unchecked fields");
+
+	clear(fields);
+}
+
+static void check_optional(void)
+{
+	struct wizard_field fields[N_FIELDS] = { {0} };
+	guint validations;
+	gint i;
+
+	setup(fields);
+	for (i = 0; i < N_FIELDS; i++)
+		wizard_field_check(&fields[i], fresh[i], &stats);
+	wizard_field_check(&fields[FIELD_PRIVKEY], KEY, &stats);
+	wizard_field_check(&fields[FIELD_ADDRESS], "10.0.0.2/32", &stats);
+
+	CHECK(!wizard_field_check(&fields[FIELD_MTU], "12", &stats),
+	      "MTU 12 valid");
+	CHECK(!wizard_fields_complete(fields), "complete with a bad MTU");
+	CHECK(wizard_field_check(&fields[FIELD_MTU], "1280", &stats),
+	      "MTU 1280 invalid");
+	CHECK(wizard_field_check(&fields[FIELD_DNS], "1.1.1.1, corp", &stats),
+	      "search domain in DNS invalid");
+	CHECK(wizard_field_check(&fields[FIELD_DNS], "", &stats),
+	      "empty DNS invalid");
+	CHECK(!wizard_field_check(&fields[FIELD_SPEEDTEST], "example.com",
+				  &stats), "speed test host name valid");
+	CHECK(wizard_field_check(&fields[FIELD_SPEEDTEST], "10.0.0.1",
+				 &stats), "speed test address invalid");
+	CHECK(wizard_fields_complete(fields), "not complete when fixed");
+
+	/* Checking the same text again is answered from the field */
+	validations = stats.validations;
+	wizard_field_check(&fields[FIELD_SPEEDTEST], "10.0.0.1", &stats);
+	CHECK(stats.validations == validations, "same text validated again");
+
+	clear(fields);
+}
+
+int main(void)
+{
+	check_fresh_page();
+	check_unchecked();
+	check_optional();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "keepalive.h"
+
+/*
+ * The keepalive entry, and the adaptive interval against a simulated
+ * NAT that drops mappings idle for longer than its timeout. Handshakes
+ * are looked at once a minute, like the history poll does.
+ */
+
+#define STEP_S 60
+#define DAY_S (24 * 3600)
+
+struct parse_case {
+	const gchar *s;
+	gboolean ok;
+	gint keepalive;
+};
+
+static const struct parse_case parse_cases[] = {
+	{NULL, TRUE, WG_KEEPALIVE_OFF},
+	{"", TRUE, WG_KEEPALIVE_OFF},
+	{"off", TRUE, WG_KEEPALIVE_OFF},
+	{"auto", TRUE, WG_KEEPALIVE_ADAPTIVE},
+	{"AUTO", TRUE, WG_KEEPALIVE_ADAPTIVE},
+	{"25", TRUE, 25},
+	{"0", TRUE, WG_KEEPALIVE_OFF},
+	{"65535", TRUE, WG_KEEPALIVE_MAX},
+	{"65536", FALSE, 0},
+	{"-1", FALSE, 0},
+	{"25s", FALSE, 0},
+};
+
+static void check_parse(void)
+{
+	gint keepalive;
+	gboolean ok;
+	gchar *s;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(parse_cases); i++) {
+		keepalive = 0;
+		ok = wg_keepalive_parse(parse_cases[i].s, &keepalive);
+		CHECK(ok == parse_cases[i].ok && (!ok || keepalive ==
+						  parse_cases[i].keepalive),
+		      "parse \"%s\"", parse_cases[i].s ? parse_cases[i].s :
+		      "(null)");
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(parse_cases); i++) {
+		if (!parse_cases[i].ok)
+			continue;
+		s = wg_keepalive_to_string(parse_cases[i].keepalive);
+		CHECK(wg_keepalive_parse(s, &keepalive)
+		      && keepalive == parse_cases[i].keepalive,
+		      "\"%s\" doesn't parse back", s);
+		g_free(s);
+	}
+}
+
+struct nat {
+	/* Seconds a mapping survives without traffic */
+	guint timeout;
+	/* Minutes the tunnel was broken because the interval was too long */
+	guint broken;
+};
+
+/* Run for secs of simulated time from *now */
+static void run(struct wg_keepalive *ka, struct nat *nat, gint64 * now,
+		guint secs)
+{
+	gint64 end = *now + (gint64) secs * G_USEC_PER_SEC;
+	gboolean ok;
+
+	while (*now < end) {
+		*now += STEP_S * G_USEC_PER_SEC;
+		ok = wg_keepalive_current(ka) <= nat->timeout;
+		if (!ok)
+			nat->broken++;
+		wg_keepalive_feed(ka, ok, *now);
+	}
+}
+
+/* The longest interval that works, as far as the interval can go */
+static guint best(guint timeout)
+{
+	return CLAMP(timeout, WG_KEEPALIVE_MIN_S, WG_KEEPALIVE_CEILING_S);
+}
+
+static void check_nats(void)
+{
+	struct wg_keepalive ka;
+	struct nat nat;
+	guint timeout, worst = 0;
+	gint64 now;
+
+	for (timeout = 10; timeout <= 2 * WG_KEEPALIVE_CEILING_S;
+	     timeout += 5) {
+		nat.timeout = timeout;
+		nat.broken = 0;
+		now = 0;
+		ka.battery = FALSE;
+		ka.backoffs = 0;
+		wg_keepalive_reset(&ka, now);
+		run(&ka, &nat, &now, DAY_S);
+
+		CHECK(ka.interval <= best(timeout)
+		      && ka.interval + WG_KEEPALIVE_PRECISION_S >= best(timeout),
+		      "NAT timeout %u s: settled at %u s", timeout,
+		      ka.interval);
+		CHECK(timeout < WG_KEEPALIVE_MIN_S || nat.broken <= 8,
+		      "NAT timeout %u s: broken for %u minutes", timeout,
+		      nat.broken);
+		if (timeout >= WG_KEEPALIVE_MIN_S)
+			worst = MAX(worst, nat.broken);
+	}
+
+	/* The network changes to a stingier NAT */
+	nat.timeout = 180;
+	nat.broken = 0;
+	now = 0;
+	wg_keepalive_reset(&ka, now);
+	run(&ka, &nat, &now, DAY_S);
+	nat.timeout = 60;
+	run(&ka, &nat, &now, DAY_S);
+	CHECK(ka.interval <= 60 && ka.interval + WG_KEEPALIVE_PRECISION_S >= 60,
+	      "after the NAT changed: %u s", ka.interval);
+
+	printf("NATs from %u to %u s: broken for at most %u minutes a day\n",
+	       WG_KEEPALIVE_MIN_S, 2 * WG_KEEPALIVE_CEILING_S, worst);
+}
+
+static void check_battery(void)
+{
+	struct wg_keepalive ka = { 0 };
+	struct nat nat = {.timeout = 120 };
+	gint64 now = 0;
+	guint interval;
+
+	wg_keepalive_reset(&ka, now);
+	run(&ka, &nat, &now, DAY_S);
+	interval = ka.interval;
+
+	CHECK(wg_keepalive_set_battery(&ka, TRUE, now)
+	      && wg_keepalive_current(&ka) == WG_KEEPALIVE_BATTERY_S,
+	      "battery profile: %u s", wg_keepalive_current(&ka));
+
+	/* Mappings expire on battery, that teaches nothing */
+	run(&ka, &nat, &now, 3600);
+	CHECK(ka.interval == interval, "learnt on battery: %u s", ka.interval);
+
+	CHECK(wg_keepalive_set_battery(&ka, FALSE, now)
+	      && wg_keepalive_current(&ka) == interval,
+	      "back from battery: %u s", wg_keepalive_current(&ka));
+	CHECK(!wg_keepalive_set_battery(&ka, FALSE, now), "no change");
+}
+
+int main(void)
+{
+	check_parse();
+	check_nats();
+	check_battery();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "mtu.h"
+#include "wakeups.h"
+
+/*
+ * The MTU key, the tunnel MTU for a link MTU, and probing over
+ * loopback: once to a socket that takes the probes silently and once
+ * to a closed port, which must not keep the probe busy.
+ */
+
+struct parse_case {
+	const gchar *s;
+	gint mtu;
+};
+
+static const struct parse_case parse_cases[] = {
+	{NULL, WG_MTU_AUTO},
+	{"", WG_MTU_AUTO},
+	{"auto", WG_MTU_AUTO},
+	{"Auto", WG_MTU_AUTO},
+	{"1420", 1420},
+	{"1280", 1280},
+	{"9000", 9000},
+	{"1279", -1},
+	{"9001", -1},
+	{"1420 ", -1},
+	{"14x0", -1},
+	{"-1420", -1},
+};
+
+struct link_case {
+	guint link_mtu;
+	int family;
+	guint mtu;
+};
+
+static const struct link_case link_cases[] = {
+	/* Nothing known */
+	{0, AF_INET, WG_MTU_DEFAULT},
+	{0, AF_INET6, WG_MTU_DEFAULT},
+	/* Ethernet and WLAN */
+	{1500, AF_INET, 1440},
+	{1500, AF_INET6, 1420},
+	/* PPPoE */
+	{1492, AF_INET, 1432},
+	{1492, AF_INET6, 1412},
+	/* Just enough, and too little for IPv6 inside */
+	{1340, AF_INET, 1280},
+	{1360, AF_INET6, 1280},
+	{1339, AF_INET, WG_MTU_MIN},
+	{576, AF_INET, WG_MTU_MIN},
+	{1280, AF_INET6, WG_MTU_MIN},
+	/* Jumbo frames and loopback */
+	{9000, AF_INET, 8940},
+	{65536, AF_INET, WG_MTU_MAX},
+	{65536, AF_INET6, WG_MTU_MAX},
+};
+
+static void check_tables(void)
+{
+	gint mtu;
+	guint i, tmtu;
+
+	for (i = 0; i < G_N_ELEMENTS(parse_cases); i++) {
+		mtu = wg_mtu_parse(parse_cases[i].s);
+		CHECK(mtu == parse_cases[i].mtu, "parse \"%s\": %d, expected %d",
+		      parse_cases[i].s ? parse_cases[i].s : "(null)", mtu,
+		      parse_cases[i].mtu);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(link_cases); i++) {
+		tmtu = wg_mtu_for_link(link_cases[i].link_mtu,
+				       link_cases[i].family);
+		CHECK(tmtu == link_cases[i].mtu, "link %u over IPv%c: %u, "
+		      "expected %u", link_cases[i].link_mtu,
+		      link_cases[i].family == AF_INET6 ? '6' : '4', tmtu,
+		      link_cases[i].mtu);
+	}
+}
+
+static gint probed;
+
+static void probe_cb(gint mtu, gpointer data)
+{
+	probed = mtu;
+	g_main_loop_quit(data);
+}
+
+/* Probe loopback at port, the tunnel MTU it found or -1 */
+static gint probe(guint16 port, gint64 * ms, guint * wakeups)
+{
+	struct sockaddr_in sin = {.sin_family = AF_INET };
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	struct wg_mtu_probe *mp;
+	guint before = wakeup_total();
+	gint64 start = g_get_monotonic_time();
+
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+
+	probed = -1;
+	mp = wg_mtu_probe_start((struct sockaddr *)&sin, sizeof(sin),
+				probe_cb, loop);
+	if (mp)
+		g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+
+	*ms = (g_get_monotonic_time() - start) / 1000;
+	*wakeups = wakeup_total() - before;
+	return probed;
+}
+
+static int bind_loopback(guint16 * port)
+{
+	struct sockaddr_in sin = {.sin_family = AF_INET };
+	socklen_t len = sizeof(sin);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0
+	    || getsockname(fd, (struct sockaddr *)&sin, &len) < 0) {
+		perror("bind");
+		exit(EXIT_FAILURE);
+	}
+
+	*port = ntohs(sin.sin_port);
+	return fd;
+}
+
+static void check_loopback(void)
+{
+	struct sockaddr_in sin = {.sin_family = AF_INET };
+	guint16 silent, closed;
+	guint wakeups;
+	gint mtu, path;
+	gint64 ms;
+	int fd;
+
+	fd = bind_loopback(&silent);
+	close(bind_loopback(&closed));
+
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(silent);
+	path = wg_mtu_path((struct sockaddr *)&sin, sizeof(sin));
+	CHECK(path >= 1500, "loopback path MTU %d", path);
+
+	/* Loopback takes more than a tunnel ever uses */
+	mtu = probe(silent, &ms, &wakeups);
+	CHECK(mtu == WG_MTU_MAX, "loopback probed to %d", mtu);
+	CHECK(ms >= WG_MTU_PROBE_TIMEOUT_MS && ms < 2 * WG_MTU_PROBE_TIMEOUT_MS,
+	      "probe took %" G_GINT64_FORMAT " ms", ms);
+	CHECK(wakeups <= 2, "%u wakeups probing", wakeups);
+
+	/* Port unreachable is no MTU, and mustn't be read in a loop */
+	mtu = probe(closed, &ms, &wakeups);
+	CHECK(mtu == WG_MTU_MAX, "closed port probed to %d", mtu);
+	CHECK(wakeups <= 2 * WG_MTU_PROBE_TRIES, "%u wakeups probing a "
+	      "closed port", wakeups);
+
+	close(fd);
+}
+
+int main(void)
+{
+	check_tables();
+	check_loopback();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
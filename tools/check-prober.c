@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "prober.h"
+
+/*
+ * The prober against local UDP services: one echoing the probes back
+ * like an echo service would, one that never answers like a real
+ * WireGuard peer, and a closed port. Where unprivileged ICMP works,
+ * the kernel answers all of them and only the ordering is checked.
+ */
+
+static int bind_loopback(guint16 * port)
+{
+	struct sockaddr_in sin = {.sin_family = AF_INET };
+	socklen_t len = sizeof(sin);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0
+	    || getsockname(fd, (struct sockaddr *)&sin, &len) < 0) {
+		perror("bind");
+		exit(EXIT_FAILURE);
+	}
+
+	*port = ntohs(sin.sin_port);
+	return fd;
+}
+
+static gboolean echo_cb(GIOChannel * source, GIOCondition cond,
+			gpointer data)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = sizeof(ss);
+	guint8 buf[2048];
+	ssize_t n;
+
+	(void)cond;
+	(void)data;
+
+	n = recvfrom(g_io_channel_unix_get_fd(source), buf, sizeof(buf), 0,
+		     (struct sockaddr *)&ss, &len);
+	if (n > 0)
+		sendto(g_io_channel_unix_get_fd(source), buf, n, 0,
+		       (struct sockaddr *)&ss, len);
+
+	return TRUE;
+}
+
+static void done_cb(gpointer data)
+{
+	g_main_loop_quit(data);
+}
+
+/* Run the prober and return how long it took in milliseconds */
+static gint64 run(struct wg_prober *prober, GMainLoop * loop)
+{
+	gint64 start = g_get_monotonic_time();
+
+	if (!wg_prober_run(prober, done_cb, loop))
+		return -1;
+
+	g_main_loop_run(loop);
+	return (g_get_monotonic_time() - start) / 1000;
+}
+
+static void add(struct wg_prober *prober, const gchar * name, guint16 port)
+{
+	gchar *endpoint = g_strdup_printf("127.0.0.1:%u", port);
+
+	wg_prober_add(prober, name, endpoint);
+	g_free(endpoint);
+}
+
+static gint compare(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return wg_prober_compare(data, *(const gchar **)a, *(const gchar **)b);
+}
+
+int main(void)
+{
+	static const gchar *names[] = { "closed", "none", "silent", "echo" };
+	const struct wg_probe_result *echo, *silent, *closed;
+	struct wg_prober *prober = wg_prober_new();
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	guint16 echo_port, silent_port, closed_port;
+	GIOChannel *channel;
+	GPtrArray *order;
+	gboolean icmp;
+	gint64 ms;
+	guint i;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+	icmp = fd >= 0;
+	if (fd >= 0)
+		close(fd);
+
+	channel = g_io_channel_unix_new(bind_loopback(&echo_port));
+	g_io_add_watch(channel, G_IO_IN, echo_cb, NULL);
+	bind_loopback(&silent_port);
+	close(bind_loopback(&closed_port));
+
+	/* Everything answers or fails at once */
+	add(prober, "echo", echo_port);
+	add(prober, "closed", closed_port);
+	ms = run(prober, loop);
+	CHECK(ms >= 0 && ms < WG_PROBE_TIMEOUT_MS / 2,
+	      "run waited %" G_GINT64_FORMAT " ms for nothing", ms);
+
+	add(prober, "silent", silent_port);
+	ms = run(prober, loop);
+	CHECK(icmp || ms >= WG_PROBE_TIMEOUT_MS,
+	      "silent peer gave up after %" G_GINT64_FORMAT " ms", ms);
+
+	echo = wg_prober_lookup(prober, "echo");
+	silent = wg_prober_lookup(prober, "silent");
+	closed = wg_prober_lookup(prober, "closed");
+	CHECK(echo && echo->rtt_us >= 0 && echo->received == WG_PROBE_COUNT
+	      && !echo->unmeasured, "echo service not measured");
+	CHECK(wg_prober_lookup(prober, "none") == NULL, "result out of thin air");
+
+	if (icmp) {
+		printf("ICMP echo works here, UDP silence is not checked\n");
+	} else {
+		CHECK(silent && silent->rtt_us < 0 && silent->unmeasured,
+		      "silent peer not reported as unmeasured");
+		CHECK(closed && closed->rtt_us < 0 && !closed->unmeasured
+		      && closed->received == 0, "closed port not unreachable");
+	}
+
+	/* Measured first, then unranked by name, unreachable last */
+	order = g_ptr_array_new();
+	for (i = 0; i < G_N_ELEMENTS(names); i++)
+		g_ptr_array_add(order, (gpointer) names[i]);
+	g_ptr_array_sort_with_data(order, compare, prober);
+
+	CHECK(!strcmp(order->pdata[0], "echo"), "%s ranked first",
+	      (gchar *) order->pdata[0]);
+	if (!icmp)
+		CHECK(!strcmp(order->pdata[1], "none")
+		      && !strcmp(order->pdata[2], "silent")
+		      && !strcmp(order->pdata[3], "closed"),
+		      "order %s %s %s", (gchar *) order->pdata[1],
+		      (gchar *) order->pdata[2], (gchar *) order->pdata[3]);
+
+	g_ptr_array_free(order, TRUE);
+	g_io_channel_unref(channel);
+	wg_prober_free(prober);
+	g_main_loop_unref(loop);
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
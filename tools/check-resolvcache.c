@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gio/gio.h>
+
+#include "check.h"
+#include "resolvcache.h"
+
+/*
+ * The resolver cache against a stand-in GResolver that answers every
+ * name after a delay, and fails names starting with "fail.".
+ */
+
+#define LOOKUP_DELAY_MS 200
+#define STANDIN_ADDRESS "192.0.2.1"
+
+typedef struct {
+	GResolver parent;
+	guint lookups;
+} StandinResolver;
+
+typedef struct {
+	GResolverClass parent_class;
+} StandinResolverClass;
+
+G_DEFINE_TYPE(StandinResolver, standin_resolver, G_TYPE_RESOLVER)
+
+static gboolean answer_cb(gpointer data)
+{
+	GTask *task = data;
+	const gchar *host = g_task_get_task_data(task);
+
+	if (g_str_has_prefix(host, "fail."))
+		g_task_return_new_error(task, G_RESOLVER_ERROR,
+					G_RESOLVER_ERROR_NOT_FOUND,
+					"%s: not found", host);
+	else
+		g_task_return_pointer(task,
+				      g_list_append(NULL,
+						    g_inet_address_new_from_string
+						    (STANDIN_ADDRESS)),
+				      (GDestroyNotify)
+				      g_resolver_free_addresses);
+
+	g_object_unref(task);
+	return FALSE;
+}
+
+static void standin_lookup_async(GResolver * resolver, const gchar * host,
+				 GCancellable * cancellable,
+				 GAsyncReadyCallback cb, gpointer data)
+{
+	StandinResolver *standin = (StandinResolver *) resolver;
+	GTask *task = g_task_new(resolver, cancellable, cb, data);
+
+	standin->lookups++;
+	g_task_set_task_data(task, g_strdup(host), g_free);
+	g_timeout_add(LOOKUP_DELAY_MS, answer_cb, task);
+}
+
+static GList *standin_lookup_finish(GResolver * resolver,
+				    GAsyncResult * res, GError ** error)
+{
+	(void)resolver;
+	return g_task_propagate_pointer(G_TASK(res), error);
+}
+
+static void standin_resolver_class_init(StandinResolverClass * klass)
+{
+	GResolverClass *resolver_class = G_RESOLVER_CLASS(klass);
+
+	resolver_class->lookup_by_name_async = standin_lookup_async;
+	resolver_class->lookup_by_name_finish = standin_lookup_finish;
+}
+
+static void standin_resolver_init(StandinResolver * standin)
+{
+	(void)standin;
+}
+
+static guint answers;
+static guint failed_answers;
+
+static void answer_count_cb(const gchar * host, GInetAddress * addr,
+			    gpointer data)
+{
+	gchar *s;
+
+	(void)data;
+
+	if (addr == NULL) {
+		failed_answers++;
+		return;
+	}
+
+	s = g_inet_address_to_string(addr);
+	CHECK(!g_strcmp0(s, STANDIN_ADDRESS), "%s resolved to %s", host, s);
+	g_free(s);
+	answers++;
+}
+
+/* Run the main loop until want answers came in, or a second passed */
+static gint64 wait_answers(guint want)
+{
+	gint64 start = g_get_monotonic_time();
+
+	while (answers + failed_answers < want
+	       && g_get_monotonic_time() - start < G_USEC_PER_SEC)
+		g_main_context_iteration(NULL, TRUE);
+
+	return (g_get_monotonic_time() - start) / 1000;
+}
+
+int main(void)
+{
+	static const gchar *const endpoints[] = {
+		"a.example:51820", "b.example:51820", "[2001:db8::1]:1",
+		"c.example:51820", NULL
+	};
+	StandinResolver *standin;
+	struct wg_resolv_cache *cache;
+	const struct wg_resolv_stats *st;
+	struct sockaddr_storage ss;
+	socklen_t len;
+	gint64 ms;
+
+	standin = g_object_new(standin_resolver_get_type(), NULL);
+	cache = wg_resolv_cache_new(G_RESOLVER(standin),
+				    WG_RESOLV_POSITIVE_TTL,
+				    WG_RESOLV_NEGATIVE_TTL);
+	st = wg_resolv_cache_get_stats(cache);
+
+	/* Two requests in flight share one lookup */
+	wg_resolv_cache_resolve(cache, "vpn.example", answer_count_cb, NULL);
+	wg_resolv_cache_resolve(cache, "vpn.example", answer_count_cb, NULL);
+	CHECK(answers == 0, "answered before the lookup finished");
+	wait_answers(2);
+	CHECK(answers == 2 && standin->lookups == 1 && st->joined == 1,
+	      "joined lookup: %u answers, %u lookups", answers,
+	      standin->lookups);
+
+	/* Answered from the cache, right away */
+	wg_resolv_cache_resolve(cache, "vpn.example", answer_count_cb, NULL);
+	CHECK(answers == 3 && standin->lookups == 1 && st->hits == 1,
+	      "cached answer: %u answers, %u lookups", answers,
+	      standin->lookups);
+
+	/* Failures are cached too */
+	wg_resolv_cache_resolve(cache, "fail.example", answer_count_cb, NULL);
+	wait_answers(4);
+	wg_resolv_cache_resolve(cache, "fail.example", answer_count_cb, NULL);
+	CHECK(failed_answers == 2 && standin->lookups == 2
+	      && st->failures == 1, "negative entry: %u lookups",
+	      standin->lookups);
+
+	/* Expired entries are looked up again */
+	wg_resolv_cache_expire(cache);
+	wg_resolv_cache_resolve(cache, "vpn.example", answer_count_cb, NULL);
+	wait_answers(6);
+	CHECK(standin->lookups == 3, "after expiry: %u lookups",
+	      standin->lookups);
+
+	/* Prefetching starts all lookups at once; addresses need none */
+	CHECK(wg_resolv_cache_prefetch(cache, endpoints) == 3,
+	      "prefetch started a different number of lookups");
+	CHECK(!wg_resolv_cache_sockaddr(cache, endpoints[0], &ss, &len),
+	      "sockaddr before the lookup finished");
+	wg_resolv_cache_resolve(cache, "c.example", answer_count_cb, NULL);
+	ms = wait_answers(7);
+	CHECK(ms < 2 * LOOKUP_DELAY_MS, "prefetch took %" G_GINT64_FORMAT
+	      "ms, lookups ran one after another", ms);
+
+	/* Let the other two prefetches land */
+	answers = failed_answers = 0;
+	wg_resolv_cache_resolve(cache, "a.example", answer_count_cb, NULL);
+	wg_resolv_cache_resolve(cache, "b.example", answer_count_cb, NULL);
+	wait_answers(2);
+	CHECK(standin->lookups == 6, "prefetch: %u lookups", standin->lookups);
+
+	CHECK(wg_resolv_cache_sockaddr(cache, endpoints[0], &ss, &len)
+	      && ss.ss_family == AF_INET, "sockaddr of a cached name");
+	CHECK(wg_resolv_cache_sockaddr(cache, endpoints[2], &ss, &len)
+	      && ss.ss_family == AF_INET6, "sockaddr of an address");
+
+	wg_resolv_cache_free(cache);
+	g_object_unref(standin);
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 wireguard-network-applet contributors
+#
+# This file is part of wireguard-network-applet
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Flip the status applet's state many times with wg-mock-provider and
+# fail if hildon-desktop's resident memory grows by more than the
+# threshold. This needs a device running hildon-desktop with the applet
+# loaded and the real provider stopped. A first, shorter run loads
+# whatever the applet keeps around, so only what the flips leak counts.
+#
+#   check-soak.sh [-n SIGNALS] [-r HZ] [-t KB]
+
+signals=100000
+rate=200
+threshold=512
+mock=${MOCK:-$(dirname "$0")/wg-mock-provider}
+
+while getopts n:r:t: opt; do
+	case $opt in
+	n) signals=$OPTARG ;;
+	r) rate=$OPTARG ;;
+	t) threshold=$OPTARG ;;
+	*) echo "Usage: $0 [-n SIGNALS] [-r HZ] [-t KB]" >&2; exit 2 ;;
+	esac
+done
+
+pid=$(pidof hildon-desktop)
+if [ -z "$pid" ]; then
+	echo "hildon-desktop is not running" >&2
+	exit 1
+fi
+
+# Resident set in kB
+rss() {
+	sed -n 's/^VmRSS:[^0-9]*\([0-9]*\) kB/\1/p' "/proc/$pid/status"
+}
+
+# Let the last frame's update run before looking
+soak() {
+	"$mock" --rate "$rate" --count "$1" >/dev/null || exit 1
+	sleep 2
+}
+
+soak 1000
+before=$(rss)
+
+soak "$signals"
+after=$(rss)
+
+growth=$((after - before))
+echo "$signals signals: VmRSS ${before} kB -> ${after} kB," \
+	"grew ${growth} kB (threshold ${threshold} kB)"
+[ "$growth" -le "$threshold" ]
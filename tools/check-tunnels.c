@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "tunnels.h"
+
+/*
+ * The set of tunnels the applet shows: states staged over a signal
+ * burst and applied at the end, replies that overtake them, renames
+ * when the active config changes, and the counts the icon and the menu
+ * are built from, which must always match a walk of the set.
+ */
+
+#define BENCH_TUNNELS 1000
+#define BENCH_BURST 100000
+
+/* The kept counts against counting them again */
+static void check_counts(struct tunnel_set *ts, const gchar * what)
+{
+	guint counts[CONN_UP + 1] = { 0 };
+	struct tunnel *t;
+	guint i;
+
+	for (i = 0; i < ts->tunnels->len; i++) {
+		t = tunnel_set_nth(ts, i);
+		counts[t->state]++;
+		CHECK(GPOINTER_TO_UINT(g_hash_table_lookup(ts->index,
+							   t->config)) == i + 1,
+		      "%s: %s not indexed at %u", what, t->config, i);
+	}
+
+	for (i = CONN_DOWN; i <= CONN_UP; i++)
+		CHECK(tunnel_set_count(ts, i) == counts[i],
+		      "%s: %u tunnels in state %u, counted %u", what,
+		      tunnel_set_count(ts, i), i, counts[i]);
+}
+
+static enum conn_state state_of(struct tunnel_set *ts, const gchar * config)
+{
+	guint i = GPOINTER_TO_UINT(g_hash_table_lookup(ts->index, config));
+
+	return i ? tunnel_set_nth(ts, i - 1)->state : (enum conn_state)-1;
+}
+
+/* Only the last state of a burst counts, and only once flushed */
+static void check_burst(void)
+{
+	struct tunnel_set ts;
+
+	tunnel_set_init(&ts);
+
+	tunnel_set_stage(&ts, "home", CONN_CONNECTING, FALSE);
+	tunnel_set_stage(&ts, "home", CONN_UP, FALSE);
+	tunnel_set_stage(&ts, "work", CONN_CONNECTING, TRUE);
+	tunnel_set_stage(&ts, "home", CONN_DOWN, FALSE);
+	tunnel_set_stage(&ts, "home", CONN_UP, FALSE);
+
+	CHECK(ts.tunnels->len == 2, "%u tunnels for two names",
+	      ts.tunnels->len);
+	CHECK(ts.dirty->len == 2, "%u dirty for two tunnels", ts.dirty->len);
+	CHECK(tunnel_set_state(&ts) == CONN_DOWN, "state before the flush");
+
+	CHECK(tunnel_set_flush(&ts), "flush changed nothing");
+	CHECK(state_of(&ts, "home") == CONN_UP, "home not up");
+	CHECK(state_of(&ts, "work") == CONN_CONNECTING, "work not connecting");
+	CHECK(tunnel_set_nth(&ts, 1)->provider, "work lost the provider flag");
+	CHECK(tunnel_set_state(&ts) == CONN_UP, "up with a tunnel up");
+	CHECK(ts.dirty->len == 0, "still dirty after the flush");
+	check_counts(&ts, "burst");
+
+	/* The same states again are no change */
+	tunnel_set_stage(&ts, "home", CONN_CONNECTING, FALSE);
+	tunnel_set_stage(&ts, "home", CONN_UP, FALSE);
+	CHECK(!tunnel_set_flush(&ts), "flush of the same state changed it");
+
+	tunnel_set_stage(&ts, "home", CONN_DOWN, FALSE);
+	CHECK(tunnel_set_flush(&ts), "flush of home going down");
+	CHECK(tunnel_set_state(&ts) == CONN_CONNECTING,
+	      "connecting with one tunnel connecting");
+	CHECK(ts.tunnels->len == 2, "down tunnel dropped from the set");
+	check_counts(&ts, "down");
+
+	tunnel_set_clear(&ts);
+}
+
+/* A reply is newer than anything staged before it */
+static void check_update(void)
+{
+	struct tunnel_set ts;
+
+	tunnel_set_init(&ts);
+
+	tunnel_set_stage(&ts, "home", CONN_CONNECTING, FALSE);
+	CHECK(tunnel_set_update(&ts, "home", CONN_UP, FALSE),
+	      "update changed nothing");
+	CHECK(!tunnel_set_flush(&ts), "staged state undid the update");
+	CHECK(state_of(&ts, "home") == CONN_UP, "home not up");
+	check_counts(&ts, "update");
+
+	/* No name is the tunnel on wg0, kept under "" */
+	tunnel_set_update(&ts, NULL, CONN_CONNECTING, FALSE);
+	CHECK(state_of(&ts, "") == CONN_CONNECTING, "unnamed not connecting");
+
+	tunnel_set_clear(&ts);
+}
+
+/*
+ * The tunnel and its staged state go with the new name, and the old
+ * name stays as a down tunnel; nothing is left up under either.
+ */
+static void check_rename(void)
+{
+	struct tunnel_set ts;
+	gchar *dump;
+
+	tunnel_set_init(&ts);
+
+	tunnel_set_update(&ts, "home", CONN_UP, TRUE);
+	tunnel_set_rename(&ts, "home", "work");
+	CHECK(state_of(&ts, "work") == CONN_UP, "work not up after the move");
+	CHECK(tunnel_set_nth(&ts, 1)->provider, "provider flag not moved");
+	CHECK(state_of(&ts, "home") == CONN_DOWN, "home still up");
+	CHECK(tunnel_set_count(&ts, CONN_UP) == 1, "%u up after a move",
+	      tunnel_set_count(&ts, CONN_UP));
+	check_counts(&ts, "rename");
+
+	tunnel_set_stage(&ts, "work", CONN_CONNECTING, FALSE);
+	tunnel_set_rename(&ts, "work", "home");
+	tunnel_set_flush(&ts);
+	CHECK(state_of(&ts, "home") == CONN_CONNECTING,
+	      "staged state not moved");
+	CHECK(state_of(&ts, "work") == CONN_DOWN, "staged state left behind");
+	check_counts(&ts, "staged rename");
+
+	/* Names nobody reported are nothing to move */
+	tunnel_set_rename(&ts, "gone", "home");
+	CHECK(ts.tunnels->len == 2, "rename of an unknown name added one");
+	tunnel_set_rename(&ts, NULL, "home");
+	CHECK(ts.tunnels->len == 2, "rename of no name added one");
+
+	dump = tunnel_set_dump(&ts);
+	CHECK(!strcmp(dump, "tunnels 0 up 1 connecting 1 down; "
+		      "home connecting; work down"), "dump: %s", dump);
+	g_free(dump);
+
+	tunnel_set_clear(&ts);
+}
+
+/* Signals spread over many tunnels, and the icon state after each frame */
+static void bench(void)
+{
+	struct tunnel_set ts;
+	gchar *names[BENCH_TUNNELS];
+	gint64 start, took;
+	guint i;
+
+	tunnel_set_init(&ts);
+	for (i = 0; i < BENCH_TUNNELS; i++)
+		names[i] = g_strdup_printf("tunnel%u", i);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < BENCH_BURST; i++) {
+		tunnel_set_stage(&ts, names[(i * 7919) % BENCH_TUNNELS],
+				 i % 3, FALSE);
+		if (i % 64 == 63) {
+			tunnel_set_flush(&ts);
+			tunnel_set_state(&ts);
+		}
+	}
+	tunnel_set_flush(&ts);
+	took = g_get_monotonic_time() - start;
+
+	check_counts(&ts, "bench");
+	printf("%u signals over %u tunnels: %.3f us each\n", BENCH_BURST,
+	       BENCH_TUNNELS, (gdouble) took / BENCH_BURST);
+
+	for (i = 0; i < BENCH_TUNNELS; i++)
+		g_free(names[i]);
+	tunnel_set_clear(&ts);
+}
+
+int main(void)
+{
+	check_burst();
+	check_update();
+	check_rename();
+	bench();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "validate.h"
+
+/*
+ * Cases for the validator, a fuzz run that counts heap allocations made
+ * while validating (there must be none), and a rough timing.
+ */
+
+#define FUZZ_ROUNDS 200000
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gboolean counting;
+static guint allocations;
+
+void *malloc(size_t size)
+{
+	if (counting)
+		allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	if (counting)
+		allocations++;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (counting)
+		allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+struct list_case {
+	const gchar *s;
+	gint n;
+};
+
+static const struct list_case cidrs[] = {
+	{"10.0.0.1/32", 1},
+	{"10.0.0.1/24, fd00::1/64", 2},
+	{" 192.168.1.2/16 ", 1},
+	{"fd00::1/128", 1},
+	{"10.0.0.1", -1},
+	{"10.0.0.1/33", -1},
+	{"fd00::1/129", -1},
+	{"10.0.0.0/xyz", -1},
+	{"10.0.0.0/", -1},
+	{"10.0.0.1/24,", -1},
+	{"", -1},
+};
+
+static const struct list_case ips[] = {
+	{"1.1.1.1", 1},
+	{"1.1.1.1, 2606:4700::1111", 2},
+	{"1.1.1.1,,8.8.8.8", -1},
+	{"300.1.1.1", -1},
+	{"1.1.1.1, example.com", -1},
+};
+
+/* The wizard and the importer both take search domains here */
+static const struct list_case dns[] = {
+	{"1.1.1.1", 1},
+	{"1.1.1.1, 2606:4700::1111", 2},
+	{"1.1.1.1, example.com", 2},
+	{"corp", 1},
+	{"1.1.1.1,,8.8.8.8", -1},
+	{"300.1.1.1", -1},
+	{"-bad.example", -1},
+};
+
+struct endpoint_case {
+	const gchar *s;
+	enum wg_endpoint_kind kind;
+	guint16 port;
+};
+
+static const struct endpoint_case endpoints[] = {
+	{"1.2.3.4:51820", WG_ENDPOINT_IPV4, 51820},
+	{"[2001:db8::1]:51820", WG_ENDPOINT_IPV6, 51820},
+	{"vpn.example.com:443", WG_ENDPOINT_HOSTNAME, 443},
+	{"2001:db8::1:51820", WG_ENDPOINT_INVALID, 0},
+	{"[1.2.3.4]:51820", WG_ENDPOINT_INVALID, 0},
+	{"1.2.3.4", WG_ENDPOINT_INVALID, 0},
+	{"1.2.3.4:0", WG_ENDPOINT_INVALID, 0},
+	{"1.2.3.4:65536", WG_ENDPOINT_INVALID, 0},
+	{"10.0.0.256:1", WG_ENDPOINT_INVALID, 0},
+	{"-bad.example:1", WG_ENDPOINT_INVALID, 0},
+};
+
+#define KEY "yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBmk="
+
+struct config_case {
+	const gchar *s;
+	gboolean valid;
+	guint err_line;
+};
+
+static const struct config_case configs[] = {
+	{"[Interface]\nPrivateKey = " KEY "\nAddress = 10.0.0.2/32\n"
+	 "[Peer]\nPublicKey = " KEY "\nEndpoint = [::1]:51820\n"
+	 "AllowedIPs = 0.0.0.0/0, ::/0", TRUE, 0},
+	{"[Interface]\nPrivateKey = " KEY "\nAddress = 10.0.0.2/32\n"
+	 "DNS = 1.1.1.1, corp\n[Peer]\nPublicKey = " KEY "\n", TRUE, 0},
+	{"[Interface]\nPrivateKey = " KEY "\nDNS = 1.1.1.1,\n", FALSE, 3},
+	{"[Interface]\nPrivateKey = " KEY "\nAddress = 10.0.0.2\n",
+	 FALSE, 3},
+	{"[Interface]\nAddress = 10.0.0.2/32\n[Peer]\nPublicKey = " KEY
+	 "\n", FALSE, 1},
+	{"[Interface]\nPrivateKey = " KEY "\n[Peer]\nEndpoint = a:1\n",
+	 FALSE, 3},
+	{"[Interface]\nPrivateKey = " KEY "\nBogus = 1\n", FALSE, 3},
+	{"# comment only\n", FALSE, 1},
+};
+
+static void check_cases(void)
+{
+	struct wg_endpoint ep;
+	enum wg_endpoint_kind kind;
+	guint i, line;
+	gboolean ok;
+	gint n;
+
+	for (i = 0; i < G_N_ELEMENTS(cidrs); i++) {
+		n = wg_validate_cidr_list(cidrs[i].s, -1, TRUE);
+		CHECK(n == cidrs[i].n, "cidr list \"%s\": %d, not %d",
+		      cidrs[i].s, n, cidrs[i].n);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(ips); i++) {
+		n = wg_validate_ip_list(ips[i].s, -1);
+		CHECK(n == ips[i].n, "ip list \"%s\": %d, not %d",
+		      ips[i].s, n, ips[i].n);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(dns); i++) {
+		n = wg_validate_dns_list(dns[i].s, -1);
+		CHECK(n == dns[i].n, "dns list \"%s\": %d, not %d",
+		      dns[i].s, n, dns[i].n);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(endpoints); i++) {
+		kind = wg_parse_endpoint(endpoints[i].s, -1, &ep);
+		CHECK(kind == endpoints[i].kind
+		      && (kind == WG_ENDPOINT_INVALID
+			  || ep.port == endpoints[i].port),
+		      "endpoint \"%s\": kind %d", endpoints[i].s, kind);
+	}
+
+	CHECK(wg_validate_key(KEY, -1), "key");
+	CHECK(!wg_validate_key("yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBml=",
+			       -1), "key with bits in the padding");
+
+	for (i = 0; i < G_N_ELEMENTS(configs); i++) {
+		line = 0;
+		ok = wg_validate_config(configs[i].s, strlen(configs[i].s),
+					&line);
+		CHECK(ok == configs[i].valid
+		      && (ok || line == configs[i].err_line),
+		      "config %u: %s at line %u", i, ok ? "valid" : "invalid",
+		      line);
+	}
+}
+
+/* Validate mutations of the cases, which must never allocate */
+static void fuzz(void)
+{
+	gchar buf[256];
+	GRand *rand = g_rand_new_with_seed(863);
+	const gchar *src;
+	gsize len, i;
+	guint round;
+
+	for (round = 0; round < FUZZ_ROUNDS; round++) {
+		switch (round % 4) {
+		case 0:
+			src = cidrs[round % G_N_ELEMENTS(cidrs)].s;
+			break;
+		case 1:
+			src = endpoints[round % G_N_ELEMENTS(endpoints)].s;
+			break;
+		case 2:
+			src = dns[round % G_N_ELEMENTS(dns)].s;
+			break;
+		default:
+			src = configs[round % G_N_ELEMENTS(configs)].s;
+			break;
+		}
+
+		len = MIN(strlen(src), sizeof(buf));
+		memcpy(buf, src, len);
+		for (i = g_rand_int_range(rand, 0, 4); i > 0 && len; i--)
+			buf[g_rand_int_range(rand, 0, len)] =
+			    g_rand_int_range(rand, 1, 128);
+
+		/* Unterminated on purpose, lengths are always passed */
+		counting = TRUE;
+		wg_validate_cidr_list(buf, len, TRUE);
+		wg_validate_ip_list(buf, len);
+		wg_validate_dns_list(buf, len);
+		wg_parse_endpoint(buf, len, NULL);
+		wg_validate_key(buf, len);
+		wg_validate_config(buf, len, NULL);
+		counting = FALSE;
+	}
+
+	g_rand_free(rand);
+
+	CHECK(allocations == 0, "%u allocations while fuzzing", allocations);
+}
+
+static void bench(void)
+{
+	const gchar *cfg = configs[0].s;
+	gsize len = strlen(cfg);
+	gint64 start;
+	guint i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < FUZZ_ROUNDS; i++)
+		wg_validate_config(cfg, len, NULL);
+
+	printf("validate_config: %.0f ns per config\n",
+	       (g_get_monotonic_time() - start) * 1000.0 / FUZZ_ROUNDS);
+}
+
+int main(void)
+{
+	check_cases();
+	fuzz();
+	bench();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 wireguard-network-applet contributors
+#
+# This file is part of wireguard-network-applet
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Run the status applet against wg-mock-provider and fail if it wakes up
+# more often than the budget allows. This needs a device running
+# hildon-desktop with the applet loaded from a build configured with
+# --enable-debug-dump, the real provider stopped, and syslog in $SYSLOG. The applet's timers run on the wall clock, so the
+# hour is a real one; -d runs shorter and scales the count to an hour.
+#
+#   check-wakeup-budget.sh [-b WAKEUPS_PER_HOUR] [-d SECONDS]
+
+budget=120
+duration=3600
+mock=${MOCK:-$(dirname "$0")/wg-mock-provider}
+syslog=${SYSLOG:-/var/log/syslog}
+
+while getopts b:d: opt; do
+	case $opt in
+	b) budget=$OPTARG ;;
+	d) duration=$OPTARG ;;
+	*) echo "Usage: $0 [-b WAKEUPS_PER_HOUR] [-d SECONDS]" >&2; exit 2 ;;
+	esac
+done
+
+# Have the applet log its counters; prints "total seconds"
+dump() {
+	dbus-send --system --type=signal /org/maemo/wireguard/applet \
+		org.maemo.wireguard.applet.DumpStats
+	sleep 2
+	sed -n 's/.*wg-sb: wakeups: total=\([0-9]*\) in \([0-9]*\)s.*/\1 \2/p' \
+		"$syslog" | tail -n 1
+}
+
+# A connected tunnel, and the display going off and on every 10 minutes
+"$mock" --state connected --display-cycle 600 &
+mock_pid=$!
+trap 'kill $mock_pid 2>/dev/null' EXIT INT TERM
+
+sleep 5
+if ! kill -0 $mock_pid 2>/dev/null; then
+	echo "wg-mock-provider did not start" >&2
+	exit 1
+fi
+
+set -- $(dump)
+start_total=$1
+start_time=$2
+if [ -z "$start_total" ]; then
+	echo "No wakeup counters in $syslog, is the applet loaded?" >&2
+	exit 1
+fi
+
+sleep "$duration"
+
+set -- $(dump)
+wakeups=$(($1 - start_total))
+elapsed=$(($2 - start_time))
+[ "$elapsed" -gt 0 ] || elapsed=1
+per_hour=$((wakeups * 3600 / elapsed))
+
+echo "$wakeups wakeups in ${elapsed}s, $per_hour per hour (budget $budget)"
+[ "$per_hour" -le "$budget" ]
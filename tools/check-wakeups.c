@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "history.h"
+#include "wakeups.h"
+
+/*
+ * The wakeup accounting on a fake clock: the busy start, an hour of a
+ * connected tunnel nobody looks at, and then a blink left running. The
+ * idle hour is what check-wakeup-budget.sh measures on a device, with
+ * its default budget and display cycle.
+ */
+
+#define BUDGET "120"
+#define DISPLAY_CYCLE_S 600
+#define S(x) ((gint64) (x) * G_USEC_PER_SEC)
+
+static gint64 now = S(1000);
+
+static gint64 fake_clock(void)
+{
+	return now;
+}
+
+static void wake(enum wakeup_source source)
+{
+	struct wakeup w;
+
+	wakeup_begin(&w, source);
+	wakeup_end(&w);
+}
+
+static gboolean dump_has(const gchar * text)
+{
+	gchar *dump = wakeup_dump();
+	gboolean found = strstr(dump, text) != NULL;
+
+	g_free(dump);
+	return found;
+}
+
+/* Loading, the status query and a StatusChanged burst */
+static void check_startup(void)
+{
+	guint i;
+
+	wake(WAKEUP_STARTUP);
+	wake(WAKEUP_ICON_THEME);
+	now += S(2);
+	wake(WAKEUP_DBUS_REPLY);
+	for (i = 0; i < 20; i++) {
+		now += G_USEC_PER_SEC / 2;
+		wake(WAKEUP_DBUS_FILTER);
+	}
+	wake(WAKEUP_STATUS_FRAME);
+
+	CHECK(wakeup_total() == 24, "startup counted %u wakeups",
+	      wakeup_total());
+	CHECK(!wakeup_over_budget(),
+	      "the first minute is extrapolated to %u an hour",
+	      wakeup_total() * 360);
+}
+
+/*
+ * Only the history poll is left, and the display going off and on. The
+ * first history sample is taken when the tunnel comes up.
+ */
+static void check_idle_hour(void)
+{
+	guint start = wakeup_total();
+	gint64 t;
+
+	for (t = 0; t < 3600; t++) {
+		now += S(1);
+		if (t % HISTORY_INTERVAL_S == 0)
+			wake(WAKEUP_HISTORY);
+		if (t % DISPLAY_CYCLE_S == 0) {
+			wake(WAKEUP_DBUS_FILTER);
+			wake(WAKEUP_DBUS_FILTER);
+		}
+	}
+
+	CHECK(wakeup_total() - start == 72, "idle hour took %u wakeups",
+	      wakeup_total() - start);
+	CHECK(!wakeup_over_budget(), "idle hour is over a budget of %s",
+	      BUDGET);
+	CHECK(dump_has(" history=60/"), "history wakeups not in the dump");
+	CHECK(dump_has(" total=96 in 3612s"), "total not in the dump");
+	CHECK(!dump_has("OVER BUDGET"), "idle hour dumped as over budget");
+}
+
+/* A blink that never stops, as when a connect hangs, blows the budget */
+static void check_stuck_blink(void)
+{
+	gint64 t;
+
+	for (t = 0; t < 180; t++) {
+		now += S(1);
+		wake(WAKEUP_BLINK);
+	}
+
+	CHECK(wakeup_over_budget(), "a stuck blink is within the budget");
+	CHECK(dump_has(" blink=180/"), "blink wakeups not in the dump");
+	CHECK(dump_has("OVER BUDGET"), "stuck blink not dumped as over budget");
+
+	g_unsetenv(WAKEUP_BUDGET_ENV);
+	CHECK(!wakeup_over_budget(), "over budget without a budget");
+	g_setenv(WAKEUP_BUDGET_ENV, BUDGET, TRUE);
+}
+
+int main(void)
+{
+	wakeup_set_clock(fake_clock);
+	g_setenv(WAKEUP_BUDGET_ENV, BUDGET, TRUE);
+
+	check_startup();
+	check_idle_hour();
+	check_stuck_blink();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
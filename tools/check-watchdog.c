@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "watchdog.h"
+
+/*
+ * The handshake watchdog on a fake clock: a tunnel whose peer died,
+ * failovers that keep failing and back off, an idle tunnel, and
+ * recovering from it all. Samples come every STEP_S like the history
+ * poll takes them.
+ */
+
+#define STEP_S 10
+#define S(x) ((gint64) (x) * G_USEC_PER_SEC)
+
+static gint64 now;
+static struct tun_sample sample;
+
+/* One poll; the tunnel always sends, and hears back if the peer is alive */
+static enum watchdog_verdict step(struct watchdog *wd, gboolean alive,
+				  gboolean sending)
+{
+	now += S(STEP_S);
+	sample.time = now;
+	if (sending)
+		sample.tx_bytes += 148;
+	if (alive) {
+		sample.rx_bytes += 92;
+		sample.last_handshake = 1700000000 + now / G_USEC_PER_SEC;
+	}
+
+	return watchdog_feed(wd, &sample, now);
+}
+
+/* Seconds until the verdict is first seen, -1 if not within limit_s */
+static gint64 until(struct watchdog *wd, enum watchdog_verdict verdict,
+		    gboolean alive, gint64 limit_s)
+{
+	gint64 start = now;
+
+	while (now - start < S(limit_s))
+		if (step(wd, alive, TRUE) == verdict)
+			return (now - start) / G_USEC_PER_SEC;
+
+	return -1;
+}
+
+static void check_dead_peer(void)
+{
+	struct watchdog wd = { 0 };
+	gint64 t, expect;
+	guint i;
+
+	watchdog_reset(&wd, WATCHDOG_FAILOVER_S, now);
+	CHECK(until(&wd, WATCHDOG_DEGRADED, TRUE, 3600) == -1,
+	      "live peer degraded");
+
+	t = until(&wd, WATCHDOG_DEGRADED, FALSE, 3600);
+	CHECK(t >= WATCHDOG_STALE_S && t <= WATCHDOG_STALE_S + STEP_S,
+	      "degraded after %" G_GINT64_FORMAT " s", t);
+	t = until(&wd, WATCHDOG_FAILOVER, FALSE, 3600);
+	CHECK(t >= WATCHDOG_FAILOVER_S && t <= WATCHDOG_FAILOVER_S + STEP_S,
+	      "failover %" G_GINT64_FORMAT " s after degrading", t);
+
+	/* The next configs are dead too; each try waits twice as long */
+	expect = WATCHDOG_FAILOVER_S;
+	for (i = 0; i < 6; i++) {
+		watchdog_failed_over(&wd, now);
+		watchdog_reset(&wd, WATCHDOG_FAILOVER_S, now);
+		expect = MIN(expect * 2, WATCHDOG_BACKOFF_MAX_S);
+
+		t = until(&wd, WATCHDOG_FAILOVER, FALSE, 4 * 3600);
+		CHECK(t >= expect && t <= MAX(expect, WATCHDOG_STALE_S +
+					      WATCHDOG_FAILOVER_S) + 2 * STEP_S,
+		      "failover %u after %" G_GINT64_FORMAT " s, expected %"
+		      G_GINT64_FORMAT, i + 2, t, expect);
+	}
+
+	/* A healthy hour forgets the backoff */
+	watchdog_failed_over(&wd, now);
+	watchdog_reset(&wd, WATCHDOG_FAILOVER_S, now);
+	CHECK(until(&wd, WATCHDOG_DEGRADED, TRUE, WATCHDOG_BACKOFF_MAX_S +
+		    STEP_S) == -1, "recovered tunnel degraded");
+	t = until(&wd, WATCHDOG_FAILOVER, FALSE, 3600);
+	CHECK(t > 0 && t <= WATCHDOG_STALE_S + WATCHDOG_FAILOVER_S + STEP_S,
+	      "failover after recovering took %" G_GINT64_FORMAT " s", t);
+}
+
+/* Nothing sent means nothing to complain about, handshakes or not */
+static void check_idle(void)
+{
+	struct watchdog wd = { 0 };
+	guint i;
+
+	watchdog_reset(&wd, WATCHDOG_FAILOVER_S, now);
+	for (i = 0; i < 3600 / STEP_S; i++)
+		if (step(&wd, FALSE, FALSE) != WATCHDOG_HEALTHY)
+			break;
+	CHECK(i == 3600 / STEP_S, "idle tunnel unhealthy after %u s",
+	      i * STEP_S);
+
+	/* A handshake alone is progress, without any payload coming back */
+	watchdog_reset(&wd, WATCHDOG_FAILOVER_S, now);
+	for (i = 0; i < 3600 / STEP_S; i++) {
+		sample.last_handshake += STEP_S;
+		if (step(&wd, FALSE, TRUE) != WATCHDOG_HEALTHY)
+			break;
+	}
+	CHECK(i == 3600 / STEP_S, "handshaking tunnel unhealthy after %u s",
+	      i * STEP_S);
+}
+
+/* A timeout of 0 turns failover off but still reports the tunnel */
+static void check_disabled(void)
+{
+	struct watchdog wd = { 0 };
+
+	watchdog_reset(&wd, 0, now);
+	CHECK(until(&wd, WATCHDOG_DEGRADED, FALSE, 3600) > 0,
+	      "never degraded without failover");
+	CHECK(until(&wd, WATCHDOG_FAILOVER, FALSE, 24 * 3600) == -1,
+	      "failover while turned off");
+}
+
+int main(void)
+{
+	now = S(1000);
+
+	check_dead_peer();
+	check_idle();
+	check_disabled();
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
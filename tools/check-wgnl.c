@@ -0,0 +1,632 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+
+#include "check.h"
+#include "wgnl.h"
+
+/*
+ * The netlink client against recorded kernel messages on a socketpair,
+ * which keeps message boundaries like netlink does. Replies are queued
+ * before each call, so no kernel and no second thread are needed. Then
+ * a timing against parsing the text of 'wg show <if> dump'.
+ */
+
+#define FAMILY 0x1d
+#define MSG_SIZE 32768
+#define BENCH_PEERS 500
+#define BENCH_ROUNDS 200
+
+/* Our end of the socketpair, and the sequence number the client uses next */
+static int kernel_fd, client_fd;
+static guint32 seq;
+
+static struct nlmsghdr *msg_new(guint8 * buf, guint16 type, guint32 s)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+
+	memset(buf, 0, NLMSG_LENGTH(GENL_HDRLEN));
+	nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_MULTI;
+	nlh->nlmsg_seq = s;
+	((struct genlmsghdr *)NLMSG_DATA(nlh))->cmd = WG_CMD_GET_DEVICE;
+
+	return nlh;
+}
+
+static struct nlattr *put(struct nlmsghdr *nlh, guint16 type,
+			  const void *data, gsize len)
+{
+	struct nlattr *a;
+
+	a = (struct nlattr *)((guint8 *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+	a->nla_type = type;
+	a->nla_len = NLA_HDRLEN + len;
+	if (len)
+		memcpy((guint8 *)a + NLA_HDRLEN, data, len);
+	memset((guint8 *)a + a->nla_len, 0,
+	       NLA_ALIGN(a->nla_len) - a->nla_len);
+
+	nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(a->nla_len);
+	return a;
+}
+
+static struct nlattr *nest(struct nlmsghdr *nlh, guint16 type)
+{
+	return put(nlh, type | NLA_F_NESTED, NULL, 0);
+}
+
+static void nest_end(struct nlmsghdr *nlh, struct nlattr *a)
+{
+	a->nla_len = (guint8 *)nlh + nlh->nlmsg_len - (guint8 *)a;
+}
+
+static void put_u16(struct nlmsghdr *nlh, guint16 type, guint16 v)
+{
+	put(nlh, type, &v, sizeof(v));
+}
+
+static void put_u32(struct nlmsghdr *nlh, guint16 type, guint32 v)
+{
+	put(nlh, type, &v, sizeof(v));
+}
+
+static void put_u64(struct nlmsghdr *nlh, guint16 type, guint64 v)
+{
+	put(nlh, type, &v, sizeof(v));
+}
+
+static void put_device(struct nlmsghdr *nlh)
+{
+	guint8 key[WG_KEY_LEN];
+
+	memset(key, 0xaa, sizeof(key));
+	put_u32(nlh, WGDEVICE_A_IFINDEX, 7);
+	put(nlh, WGDEVICE_A_IFNAME, "wg0", 4);
+	put(nlh, WGDEVICE_A_PUBLIC_KEY, key, sizeof(key));
+	put_u16(nlh, WGDEVICE_A_LISTEN_PORT, 51820);
+	put_u32(nlh, WGDEVICE_A_FWMARK, 0x42);
+}
+
+static void put_key(struct nlmsghdr *nlh, guint n)
+{
+	guint8 key[WG_KEY_LEN];
+
+	memset(key, 0, sizeof(key));
+	key[0] = n & 0xff;
+	key[1] = n >> 8;
+	put(nlh, WGPEER_A_PUBLIC_KEY, key, sizeof(key));
+}
+
+static void put_allowed_ips(struct nlmsghdr *nlh, guint first, guint n)
+{
+	struct nlattr *ips, *ip;
+	guint16 family = AF_INET;
+	guint8 cidr = 32;
+	guint32 addr;
+	guint i;
+
+	ips = nest(nlh, WGPEER_A_ALLOWEDIPS);
+	for (i = first; i < first + n; i++) {
+		addr = htonl(0x0a000000 | i);
+		ip = nest(nlh, 0);
+		put(nlh, WGALLOWEDIP_A_FAMILY, &family, sizeof(family));
+		put(nlh, WGALLOWEDIP_A_IPADDR, &addr, sizeof(addr));
+		put(nlh, WGALLOWEDIP_A_CIDR_MASK, &cidr, sizeof(cidr));
+		nest_end(nlh, ip);
+	}
+	nest_end(nlh, ips);
+}
+
+/* Peer n with an IPv4 endpoint, traffic and a handshake */
+static void put_full_peer(struct nlmsghdr *nlh, guint n, guint n_ips)
+{
+	struct sockaddr_in sin = {.sin_family = AF_INET };
+	struct nlattr *peer;
+	guint64 handshake[2] = { 1700000000 + n, 0 };
+
+	sin.sin_addr.s_addr = htonl(0xc0000200 | (n & 0xff));
+	sin.sin_port = htons(51820);
+
+	peer = nest(nlh, 0);
+	put_key(nlh, n);
+	put(nlh, WGPEER_A_ENDPOINT, &sin, sizeof(sin));
+	put(nlh, WGPEER_A_LAST_HANDSHAKE_TIME, handshake, sizeof(handshake));
+	put_u64(nlh, WGPEER_A_RX_BYTES, 1000ULL * n);
+	put_u64(nlh, WGPEER_A_TX_BYTES, 2000ULL * n);
+	put_u16(nlh, WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL, 25);
+	put_allowed_ips(nlh, n * 16, n_ips);
+	nest_end(nlh, peer);
+}
+
+static void queue(const void *buf, gsize len)
+{
+	if (send(kernel_fd, buf, len, 0) != (gssize) len) {
+		perror("send");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void queue_error(guint32 s, int error)
+{
+	guint8 buf[NLMSG_SPACE(sizeof(struct nlmsgerr))];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(*err));
+	nlh->nlmsg_type = NLMSG_ERROR;
+	nlh->nlmsg_seq = s;
+	err->error = error;
+	queue(buf, nlh->nlmsg_len);
+}
+
+static void queue_done(guint32 s)
+{
+	guint8 buf[NLMSG_SPACE(sizeof(int))];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(int));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_flags = NLM_F_MULTI;
+	nlh->nlmsg_seq = s;
+	queue(buf, nlh->nlmsg_len);
+}
+
+/*
+ * Three peers over two messages in one datagram. The second peer's
+ * allowed IPs continue in the second message, which repeats its key.
+ * The third peer has no endpoint and ends in a broken attribute. A
+ * message with another sequence number must be ignored.
+ */
+static void queue_small_dump(guint32 s)
+{
+	static guint8 buf[2 * MSG_SIZE], other[MSG_SIZE];
+	struct sockaddr_in6 sin6 = {.sin6_family = AF_INET6 };
+	struct nlmsghdr *nlh, *nlh2;
+	struct nlattr *peers, *peer, *bad;
+
+	nlh = msg_new(buf, FAMILY, s);
+	put_device(nlh);
+	peers = nest(nlh, WGDEVICE_A_PEERS);
+	put_full_peer(nlh, 1, 2);
+	peer = nest(nlh, 0);
+	put_key(nlh, 2);
+	sin6.sin6_port = htons(443);
+	sin6.sin6_addr.s6_addr[0] = 0x20;
+	put(nlh, WGPEER_A_ENDPOINT, &sin6, sizeof(sin6));
+	put_allowed_ips(nlh, 100, 3);
+	nest_end(nlh, peer);
+	nest_end(nlh, peers);
+
+	nlh2 = msg_new(buf + NLMSG_ALIGN(nlh->nlmsg_len), FAMILY, s);
+	put_u32(nlh2, WGDEVICE_A_IFINDEX, 7);
+	peers = nest(nlh2, WGDEVICE_A_PEERS);
+	peer = nest(nlh2, 0);
+	put_key(nlh2, 2);
+	put_allowed_ips(nlh2, 103, 4);
+	nest_end(nlh2, peer);
+	peer = nest(nlh2, 0);
+	put_key(nlh2, 3);
+	put_allowed_ips(nlh2, 200, 1);
+	bad = put(nlh2, WGPEER_A_RX_BYTES, NULL, 0);
+	bad->nla_len = 200;
+	nest_end(nlh2, peer);
+	nest_end(nlh2, peers);
+
+	queue(buf, NLMSG_ALIGN(nlh->nlmsg_len) + nlh2->nlmsg_len);
+
+	nlh = msg_new(other, FAMILY, s + 100);
+	peers = nest(nlh, WGDEVICE_A_PEERS);
+	put_full_peer(nlh, 9, 1);
+	nest_end(nlh, peers);
+	queue(other, nlh->nlmsg_len);
+
+	queue_done(s);
+}
+
+/* Read what the client sent; NULL when nothing is waiting */
+static struct nlmsghdr *take_request(guint8 * buf)
+{
+	gssize len = recv(kernel_fd, buf, MSG_SIZE, MSG_DONTWAIT);
+
+	return len > 0 ? (struct nlmsghdr *)buf : NULL;
+}
+
+static struct nlattr *find_attr(struct nlattr *a, gssize len, guint16 type)
+{
+	while (len >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN
+	       && a->nla_len <= len) {
+		if ((a->nla_type & NLA_TYPE_MASK) == type)
+			return a;
+		len -= NLA_ALIGN(a->nla_len);
+		a = (struct nlattr *)((guint8 *)a + NLA_ALIGN(a->nla_len));
+	}
+
+	return NULL;
+}
+
+#define REQ_ATTRS(nlh) \
+	((struct nlattr *)((guint8 *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+#define REQ_ATTRS_LEN(nlh) \
+	((gssize)(nlh)->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN))
+#define NEST_ATTRS(a) ((struct nlattr *)((guint8 *)(a) + NLA_HDRLEN))
+#define NEST_LEN(a) ((gssize)(a)->nla_len - NLA_HDRLEN)
+
+static guint count_attrs(struct nlattr *a)
+{
+	struct nlattr *i = NEST_ATTRS(a);
+	gssize len = NEST_LEN(a);
+	guint n = 0;
+
+	while (len >= NLA_HDRLEN && i->nla_len >= NLA_HDRLEN
+	       && i->nla_len <= len) {
+		n++;
+		len -= NLA_ALIGN(i->nla_len);
+		i = (struct nlattr *)((guint8 *)i + NLA_ALIGN(i->nla_len));
+	}
+
+	return n;
+}
+
+static void check_get_device(struct wg_nl *nl)
+{
+	static guint8 req[MSG_SIZE];
+	struct wg_nl_peer peers[3];
+	struct wg_nl_device dev = {.peers = peers,.max_peers = 3 };
+	struct sockaddr_in *sin;
+	struct nlmsghdr *nlh;
+	struct nlattr *a;
+	int ret;
+
+	queue_small_dump(++seq);
+	ret = wg_nl_get_device(nl, "wg0", &dev);
+	CHECK(ret == 0, "get_device: %d", ret);
+
+	nlh = take_request(req);
+	CHECK(nlh && nlh->nlmsg_type == FAMILY
+	      && (nlh->nlmsg_flags & NLM_F_DUMP)
+	      && ((struct genlmsghdr *)NLMSG_DATA(nlh))->cmd ==
+	      WG_CMD_GET_DEVICE, "get_device request");
+	a = nlh ? find_attr(REQ_ATTRS(nlh), REQ_ATTRS_LEN(nlh),
+			    WGDEVICE_A_IFNAME) : NULL;
+	CHECK(a && !strcmp((gchar *) NEST_ATTRS(a), "wg0"),
+	      "get_device request names the interface");
+
+	CHECK(dev.ifindex == 7 && dev.listen_port == 51820
+	      && dev.fwmark == 0x42 && dev.public_key[0] == 0xaa
+	      && !strcmp(dev.ifname, "wg0"), "device attributes");
+	CHECK(dev.n_peers == 3, "%u peers, not 3", dev.n_peers);
+
+	sin = (struct sockaddr_in *)&peers[0].endpoint;
+	CHECK(peers[0].public_key[0] == 1 && sin->sin_family == AF_INET
+	      && ntohs(sin->sin_port) == 51820
+	      && peers[0].last_handshake == 1700000001
+	      && peers[0].rx_bytes == 1000 && peers[0].tx_bytes == 2000
+	      && peers[0].keepalive == 25 && peers[0].n_allowed_ips == 2,
+	      "first peer");
+	CHECK(peers[1].public_key[0] == 2
+	      && peers[1].endpoint.ss_family == AF_INET6
+	      && peers[1].n_allowed_ips == 7,
+	      "split peer: %u allowed IPs, not 7", peers[1].n_allowed_ips);
+	CHECK(peers[2].public_key[0] == 3
+	      && peers[2].endpoint.ss_family == 0
+	      && peers[2].n_allowed_ips == 1 && peers[2].rx_bytes == 0,
+	      "peer without endpoint, ending in a broken attribute");
+
+	/* Too little room: counted, but only the first ones filled in */
+	memset(peers, 0x5a, sizeof(peers));
+	dev.max_peers = 2;
+	queue_small_dump(++seq);
+	ret = wg_nl_get_device(nl, "wg0", &dev);
+	take_request(req);
+	CHECK(ret == 0 && dev.n_peers == 3 && peers[1].public_key[0] == 2
+	      && peers[2].public_key[0] == 0x5a,
+	      "dump larger than the peer array");
+
+	queue_error(++seq, -ENODEV);
+	ret = wg_nl_get_device(nl, "wg9", &dev);
+	take_request(req);
+	CHECK(ret == -ENODEV, "missing interface: %d", ret);
+}
+
+static void check_set_device(struct wg_nl *nl)
+{
+	static guint8 req[MSG_SIZE];
+	static struct wg_nl_peer_config many[1500];
+	static guint8 keys[G_N_ELEMENTS(many)][WG_KEY_LEN];
+	struct wg_nl_allowedip ip = {.family = AF_INET,.cidr = 24 };
+	struct wg_nl_peer_config two[2];
+	struct nlmsghdr *nlh;
+	struct nlattr *peers, *peer, *a;
+	guint i, msgs, total, flagged;
+	int ret;
+
+	memset(two, 0, sizeof(two));
+	memset(keys, 0, sizeof(keys));
+	inet_pton(AF_INET, "10.1.0.0", &ip.addr.ip4);
+	two[0].public_key = keys[1];
+	two[0].keepalive = 25;
+	two[0].allowed_ips = &ip;
+	two[0].n_allowed_ips = 1;
+	two[1].public_key = keys[2];
+	two[1].keepalive = -1;
+	two[1].flags = WGPEER_F_REMOVE_ME;
+
+	queue_error(++seq, 0);
+	ret = wg_nl_set_device(nl, "wg0", WGDEVICE_F_REPLACE_PEERS, two, 2);
+	CHECK(ret == 0, "set_device: %d", ret);
+
+	nlh = take_request(req);
+	CHECK(nlh && (nlh->nlmsg_flags & NLM_F_ACK)
+	      && ((struct genlmsghdr *)NLMSG_DATA(nlh))->cmd ==
+	      WG_CMD_SET_DEVICE, "set_device request");
+	if (nlh == NULL)
+		return;
+
+	a = find_attr(REQ_ATTRS(nlh), REQ_ATTRS_LEN(nlh), WGDEVICE_A_FLAGS);
+	CHECK(a && *(guint32 *) NEST_ATTRS(a) == WGDEVICE_F_REPLACE_PEERS,
+	      "device flags");
+	peers = find_attr(REQ_ATTRS(nlh), REQ_ATTRS_LEN(nlh),
+			  WGDEVICE_A_PEERS);
+	CHECK(peers && count_attrs(peers) == 2, "two peers sent");
+	if (peers == NULL)
+		return;
+
+	peer = NEST_ATTRS(peers);
+	a = find_attr(NEST_ATTRS(peer), NEST_LEN(peer),
+		      WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL);
+	CHECK(a && *(guint16 *) NEST_ATTRS(a) == 25, "keepalive sent");
+	a = find_attr(NEST_ATTRS(peer), NEST_LEN(peer), WGPEER_A_ALLOWEDIPS);
+	CHECK(a && count_attrs(a) == 1, "allowed IP sent");
+
+	peer = (struct nlattr *)((guint8 *)peer + NLA_ALIGN(peer->nla_len));
+	CHECK(!find_attr(NEST_ATTRS(peer), NEST_LEN(peer),
+			 WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL),
+	      "keepalive left alone");
+	a = find_attr(NEST_ATTRS(peer), NEST_LEN(peer), WGPEER_A_FLAGS);
+	CHECK(a && *(guint32 *) NEST_ATTRS(a) == WGPEER_F_REMOVE_ME,
+	      "peer flags");
+
+	/* More peers than fit into one message */
+	for (i = 0; i < G_N_ELEMENTS(many); i++) {
+		keys[i][0] = i & 0xff;
+		keys[i][1] = i >> 8;
+		many[i].public_key = keys[i];
+		many[i].keepalive = 25;
+		many[i].allowed_ips = &ip;
+		many[i].n_allowed_ips = 1;
+	}
+	/* A unix socket queues only a few datagrams; unused ACKs are dropped */
+	for (i = 1; i <= 8; i++)
+		queue_error(seq + i, 0);
+
+	ret = wg_nl_set_device(nl, "wg0", WGDEVICE_F_REPLACE_PEERS, many,
+			       G_N_ELEMENTS(many));
+	CHECK(ret == 0, "large set_device: %d", ret);
+
+	msgs = total = flagged = 0;
+	while ((nlh = take_request(req))) {
+		msgs++;
+		if (find_attr(REQ_ATTRS(nlh), REQ_ATTRS_LEN(nlh),
+			      WGDEVICE_A_FLAGS))
+			flagged++;
+		peers = find_attr(REQ_ATTRS(nlh), REQ_ATTRS_LEN(nlh),
+				  WGDEVICE_A_PEERS);
+		total += peers ? count_attrs(peers) : 0;
+	}
+	CHECK(msgs > 1 && total == G_N_ELEMENTS(many) && flagged == 1,
+	      "large set_device: %u peers in %u messages, %u with flags",
+	      total, msgs, flagged);
+
+	seq += msgs;
+	while (recv(client_fd, req, MSG_SIZE, MSG_DONTWAIT) > 0) ;
+}
+
+/* BENCH_PEERS peers as the kernel would send them, packed into datagrams */
+static void queue_bench_dump(guint32 s)
+{
+	static guint8 buf[MSG_SIZE];
+	struct nlmsghdr *nlh = NULL;
+	struct nlattr *peers = NULL;
+	guint i;
+
+	for (i = 0; i < BENCH_PEERS; i++) {
+		if (nlh && nlh->nlmsg_len > MSG_SIZE - 512) {
+			nest_end(nlh, peers);
+			queue(buf, nlh->nlmsg_len);
+			nlh = NULL;
+		}
+		if (nlh == NULL) {
+			nlh = msg_new(buf, FAMILY, s);
+			put_device(nlh);
+			peers = nest(nlh, WGDEVICE_A_PEERS);
+		}
+		put_full_peer(nlh, i, 2);
+	}
+
+	nest_end(nlh, peers);
+	queue(buf, nlh->nlmsg_len);
+	queue_done(s);
+}
+
+/* The same interface as 'wg show wg0 dump' prints it */
+static gchar *bench_dump_text(void)
+{
+	GString *text = g_string_new(NULL);
+	guint8 key[WG_KEY_LEN];
+	gchar *b64;
+	guint i;
+
+	memset(key, 0xaa, sizeof(key));
+	b64 = g_base64_encode(key, sizeof(key));
+	g_string_append_printf(text, "%s\t%s\t51820\t0x42\n", b64, b64);
+	g_free(b64);
+
+	for (i = 0; i < BENCH_PEERS; i++) {
+		memset(key, 0, sizeof(key));
+		key[0] = i & 0xff;
+		key[1] = i >> 8;
+		b64 = g_base64_encode(key, sizeof(key));
+		g_string_append_printf(text, "%s\t(none)\t192.0.2.%u:51820\t"
+				       "10.0.%u.%u/32,10.0.%u.%u/32\t%u\t%u\t"
+				       "%u\t25\n", b64, i & 0xff,
+				       (i * 16) >> 8, (i * 16) & 0xff,
+				       (i * 16 + 1) >> 8, (i * 16 + 1) & 0xff,
+				       1700000000 + i, 1000 * i, 2000 * i);
+		g_free(b64);
+	}
+
+	return g_string_free(text, FALSE);
+}
+
+/* What reading the same from wg's output would take, minus running wg */
+static guint parse_dump_text(const gchar * text, struct wg_nl_device *dev)
+{
+	gchar **lines, **line, **f, *colon, **ips;
+	struct sockaddr_in *sin;
+	struct wg_nl_peer *peer;
+	guchar *key;
+	gsize len;
+
+	dev->n_peers = 0;
+	lines = g_strsplit(text, "\n", -1);
+
+	for (line = lines + 1; *line && **line; line++) {
+		f = g_strsplit(*line, "\t", -1);
+		if (g_strv_length(f) < 8 || dev->n_peers >= dev->max_peers) {
+			g_strfreev(f);
+			continue;
+		}
+
+		peer = &dev->peers[dev->n_peers++];
+		memset(peer, 0, sizeof(*peer));
+
+		key = g_base64_decode(f[0], &len);
+		if (len == WG_KEY_LEN)
+			memcpy(peer->public_key, key, WG_KEY_LEN);
+		g_free(key);
+
+		colon = strrchr(f[2], ':');
+		if (colon) {
+			*colon = '\0';
+			sin = (struct sockaddr_in *)&peer->endpoint;
+			if (inet_pton(AF_INET, f[2], &sin->sin_addr) == 1) {
+				sin->sin_family = AF_INET;
+				sin->sin_port = htons(atoi(colon + 1));
+			}
+		}
+
+		ips = g_strsplit(f[3], ",", -1);
+		peer->n_allowed_ips = g_strv_length(ips);
+		g_strfreev(ips);
+
+		peer->last_handshake = g_ascii_strtoll(f[4], NULL, 10);
+		peer->rx_bytes = g_ascii_strtoull(f[5], NULL, 10);
+		peer->tx_bytes = g_ascii_strtoull(f[6], NULL, 10);
+		peer->keepalive = atoi(f[7]);
+
+		g_strfreev(f);
+	}
+
+	g_strfreev(lines);
+	return dev->n_peers;
+}
+
+static void bench(struct wg_nl *nl)
+{
+	static guint8 req[MSG_SIZE];
+	static struct wg_nl_peer peers[BENCH_PEERS];
+	struct wg_nl_device dev = {.peers = peers,.max_peers = BENCH_PEERS };
+	gint64 start, netlink = 0, text_us, spawn_us;
+	gchar *text;
+	guint i;
+	pid_t pid;
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		queue_bench_dump(++seq);
+		start = g_get_monotonic_time();
+		wg_nl_get_device(nl, "wg0", &dev);
+		netlink += g_get_monotonic_time() - start;
+		take_request(req);
+	}
+	CHECK(dev.n_peers == BENCH_PEERS && peers[BENCH_PEERS - 1].rx_bytes
+	      == 1000ULL * (BENCH_PEERS - 1), "bench dump");
+
+	text = bench_dump_text();
+	start = g_get_monotonic_time();
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		parse_dump_text(text, &dev);
+	text_us = g_get_monotonic_time() - start;
+	g_free(text);
+	CHECK(dev.n_peers == BENCH_PEERS && peers[BENCH_PEERS - 1].rx_bytes
+	      == 1000ULL * (BENCH_PEERS - 1), "bench text");
+
+	/* The least running wg costs, before it has done anything */
+	start = g_get_monotonic_time();
+	for (i = 0; i < 20; i++) {
+		pid = fork();
+		if (pid == 0) {
+			execlp("true", "true", NULL);
+			_exit(127);
+		}
+		if (pid > 0)
+			waitpid(pid, NULL, 0);
+	}
+	spawn_us = (g_get_monotonic_time() - start) / 20;
+
+	printf("%u peers: netlink %" G_GINT64_FORMAT "us, 'wg show dump' "
+	       "text %" G_GINT64_FORMAT "us plus %" G_GINT64_FORMAT
+	       "us to start a process\n", BENCH_PEERS, netlink / BENCH_ROUNDS,
+	       text_us / BENCH_ROUNDS, spawn_us);
+}
+
+int main(void)
+{
+	struct wg_nl *nl;
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+		perror("socketpair");
+		return EXIT_FAILURE;
+	}
+	client_fd = fds[0];
+	kernel_fd = fds[1];
+	nl = wg_nl_open_fd(fds[0], FAMILY);
+
+	check_get_device(nl);
+	check_set_device(nl);
+	bench(nl);
+
+	wg_nl_close(nl);
+	close(kernel_fd);
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
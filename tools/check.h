@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+
+#include <glib.h>
+
+/*
+ * Shared by the checkers: CHECK() prints what failed and counts it, and
+ * main() exits with failure if anything did.
+ */
+
+static guint failures;
+
+#define CHECK(cond, ...) do {			\
+	if (!(cond)) {				\
+		failures++;			\
+		printf("FAIL: " __VA_ARGS__);	\
+		printf("\n");			\
+	}					\
+} while (0)
+
+#endif
@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbus/dbus-glib-lowlevel.h>
+#include <glib.h>
+#include <icd/dbus_api.h>
+#include <icd/wireguard/libicd_wireguard_shared.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include "gckeys.h"
+
+/*
+ * Stand-in for the ICD WireGuard provider, to run the status applet
+ * without a tunnel. It owns the provider's name on the system bus, so
+ * stop the real provider and run it as a user the bus policy allows:
+ *
+ *   wg-mock-provider --status-delay 30000 --state connected
+ *
+ * and restart hildon-desktop. The applet has to come up right away and
+ * show the tunnel as connected 30 seconds later.
+ *
+ * With --rate it also cycles StatusChanged through stopped, started and
+ * connected, to soak the applet in state changes:
+ *
+ *   wg-mock-provider --rate 50 --count 1000000
+ *
+ * hildon-desktop's memory use must level off while this runs, which
+ * check-soak.sh measures.
+ *
+ * --display-cycle stands in for MCE, turning the display off and on
+ * again every few seconds. With the tunnel connecting, the applet's
+ * blink timer has to stop while the display is off:
+ *
+ *   wg-mock-provider --state started --display-cycle 10
+ *
+ * --iap-cycle does the same for ICD, saying every few seconds that
+ * another WLAN is connected now. With the tunnel connected, the applet
+ * has to kick it and time how long it takes to come back:
+ *
+ *   wg-mock-provider --state connected --iap-cycle 60
+ *
+ * Where ICD's name is free, as on a private bus, the mock also answers
+ * ICD's state_req with the WLAN it is on. An applet started then knows
+ * the network, so the first switch already counts as a change.
+ *
+ * Traces the applet recorded to $WG_APPLET_SIGNAL_TRACE play back with
+ * their original timing, or faster:
+ *
+ *   wg-mock-provider --replay trace.txt --speed 100
+ *
+ * The MTU and keepalives the applet asks for are printed. With
+ * --no-tuning the methods are unknown, like on an older provider, and
+ * the applet has to stop learning the adaptive keepalive.
+ */
+
+/* Anything but the provider mode is a tunnel started from the applet */
+#define MODE_STANDALONE "standalone"
+
+/* One line of a trace: "gap-in-us state mode [config]" */
+struct traced_signal {
+	gint64 gap;
+	gchar *status;
+	gchar *mode;
+	gchar *config;
+};
+
+struct delayed_reply {
+	DBusConnection *dbus;
+	DBusMessage *reply;
+};
+
+static gboolean session_bus;
+static gint status_delay;
+static gchar *state_name;
+static gboolean provider_mode;
+static gint rate;
+static gint count;
+static gchar *config;
+static gint display_cycle;
+static gint iap_cycle;
+static gchar *replay_file;
+static gdouble speed = 1.0;
+static gboolean no_tuning;
+/* Which of the networks --iap-cycle switches between we are on */
+static guint iap;
+
+static GArray *trace;
+
+static DBusConnection *bus;
+
+static const gchar *state = ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED;
+
+static GOptionEntry entries[] = {
+	{"session", 0, 0, G_OPTION_ARG_NONE, &session_bus,
+	 "Use the session bus instead of the system bus", NULL},
+	{"status-delay", 'd', 0, G_OPTION_ARG_INT, &status_delay,
+	 "Answer GetStatus after MS milliseconds", "MS"},
+	{"state", 0, 0, G_OPTION_ARG_STRING, &state_name,
+	 "Tunnel state: stopped, started or connected", "STATE"},
+	{"provider", 'p', 0, G_OPTION_ARG_NONE, &provider_mode,
+	 "Report the tunnel as started by the provider", NULL},
+	{"rate", 'r', 0, G_OPTION_ARG_INT, &rate,
+	 "Emit HZ StatusChanged signals per second", "HZ"},
+	{"count", 'n', 0, G_OPTION_ARG_INT, &count,
+	 "Stop emitting after N signals", "N"},
+	{"config", 0, 0, G_OPTION_ARG_STRING, &config,
+	 "Name the config the signals are about", "NAME"},
+	{"display-cycle", 0, 0, G_OPTION_ARG_INT, &display_cycle,
+	 "Turn the display off and on every S seconds", "S"},
+	{"iap-cycle", 0, 0, G_OPTION_ARG_INT, &iap_cycle,
+	 "Switch to another WLAN every S seconds", "S"},
+	{"replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_file,
+	 "Emit the StatusChanged signals recorded in FILE", "FILE"},
+	{"speed", 0, 0, G_OPTION_ARG_DOUBLE, &speed,
+	 "Replay X times as fast as recorded", "X"},
+	{"no-tuning", 0, 0, G_OPTION_ARG_NONE, &no_tuning,
+	 "Don't know SetMtu and SetKeepalive", NULL},
+	{NULL, 0, 0, 0, NULL, NULL, NULL}
+};
+
+static gboolean parse_state_name(const gchar * name)
+{
+	if (name == NULL || !g_strcmp0(name, "stopped"))
+		state = ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED;
+	else if (!g_strcmp0(name, "started"))
+		state = ICD_WIREGUARD_SIGNALS_STATUS_STATE_STARTED;
+	else if (!g_strcmp0(name, "connected"))
+		state = ICD_WIREGUARD_SIGNALS_STATUS_STATE_CONNECTED;
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+static const gchar *mode(void)
+{
+	return provider_mode ? ICD_WIREGUARD_SIGNALS_STATUS_MODE_PROVIDER
+	    : MODE_STANDALONE;
+}
+
+static gboolean emit_status(const gchar * status, const gchar * m,
+			    const gchar * config)
+{
+	DBusMessage *msg;
+	gboolean ok;
+
+	msg = dbus_message_new_signal(ICD_WIREGUARD_DBUS_PATH,
+				      ICD_WIREGUARD_DBUS_INTERFACE,
+				      ICD_WIREGUARD_SIGNAL_STATUSCHANGED);
+	if (msg == NULL)
+		return FALSE;
+
+	ok = dbus_message_append_args(msg, DBUS_TYPE_STRING, &status,
+				      DBUS_TYPE_STRING, &m, DBUS_TYPE_INVALID)
+	    && (config == NULL
+		|| dbus_message_append_args(msg, DBUS_TYPE_STRING, &config,
+					    DBUS_TYPE_INVALID))
+	    && dbus_connection_send(bus, msg, NULL);
+
+	dbus_message_unref(msg);
+	return ok;
+}
+
+/*
+ * Timers don't fire more often than every millisecond, so each tick
+ * sends as many signals as are due by now.
+ */
+static gboolean emit_cb(gpointer data)
+{
+	static const gchar *const cycle[] = {
+		ICD_WIREGUARD_SIGNALS_STATUS_STATE_STOPPED,
+		ICD_WIREGUARD_SIGNALS_STATUS_STATE_STARTED,
+		ICD_WIREGUARD_SIGNALS_STATUS_STATE_CONNECTED,
+	};
+	static gint64 start;
+	static gint sent;
+	GMainLoop *loop = data;
+	gint64 due;
+
+	if (start == 0)
+		start = g_get_monotonic_time();
+
+	due = (g_get_monotonic_time() - start) * rate / G_USEC_PER_SEC + 1;
+	if (count && due > count)
+		due = count;
+
+	for (; sent < due; sent++) {
+		state = cycle[sent % G_N_ELEMENTS(cycle)];
+		if (!emit_status(state, mode(), config)) {
+			fprintf(stderr, "Unable to emit StatusChanged\n");
+			g_main_loop_quit(loop);
+			return FALSE;
+		}
+	}
+
+	if (count && sent >= count) {
+		/* Let the bus have the last ones before leaving */
+		dbus_connection_flush(bus);
+		printf("%d signals in %" G_GINT64_FORMAT "ms\n", sent,
+		       (g_get_monotonic_time() - start) / 1000);
+		g_main_loop_quit(loop);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* "-" stands for a missing argument, which goes out as an empty one */
+static gchar *trace_arg(const gchar * arg)
+{
+	return g_strdup(g_strcmp0(arg, "-") ? arg : "");
+}
+
+static gboolean load_trace(const gchar * path)
+{
+	struct traced_signal sig;
+	gchar *contents, **lines, **line, **fields;
+	GError *error = NULL;
+
+	if (!g_file_get_contents(path, &contents, NULL, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	trace = g_array_new(FALSE, FALSE, sizeof(struct traced_signal));
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	for (line = lines; *line; line++) {
+		if (**line == '\0')
+			continue;
+
+		fields = g_strsplit(*line, " ", 4);
+		if (g_strv_length(fields) < 3) {
+			fprintf(stderr, "%s:%d: not a traced signal\n", path,
+				(int)(line - lines) + 1);
+			g_strfreev(fields);
+			g_strfreev(lines);
+			return FALSE;
+		}
+
+		sig.gap = g_ascii_strtoll(fields[0], NULL, 10) / speed;
+		sig.status = trace_arg(fields[1]);
+		sig.mode = trace_arg(fields[2]);
+		sig.config = fields[3] ? g_strdup(fields[3]) : NULL;
+		g_array_append_val(trace, sig);
+
+		g_strfreev(fields);
+	}
+
+	g_strfreev(lines);
+	return TRUE;
+}
+
+/*
+ * Sends everything that is due by now, then sleeps until the next one.
+ * Gaps under a millisecond end up sent together, like emit_cb does.
+ */
+static gboolean replay_cb(gpointer data)
+{
+	static gint64 due;
+	static guint next;
+	GMainLoop *loop = data;
+	gint64 now = g_get_monotonic_time();
+	struct traced_signal *sig;
+
+	if (due == 0)
+		due = now;
+
+	for (; next < trace->len; next++) {
+		sig = &g_array_index(trace, struct traced_signal, next);
+		if (due + sig->gap > now) {
+			g_timeout_add(MAX((due + sig->gap - now) / 1000, 1),
+				      replay_cb, loop);
+			return FALSE;
+		}
+
+		due += sig->gap;
+		if (!emit_status(sig->status, sig->mode, sig->config)) {
+			fprintf(stderr, "Unable to emit StatusChanged\n");
+			g_main_loop_quit(loop);
+			return FALSE;
+		}
+	}
+
+	dbus_connection_flush(bus);
+	printf("%u signals replayed\n", trace->len);
+	g_main_loop_quit(loop);
+	return FALSE;
+}
+
+/* MCE itself sends this; the applet's match doesn't ask for a sender */
+static gboolean display_cb(gpointer data)
+{
+	static gboolean off;
+	const gchar *state;
+	DBusMessage *msg;
+	(void)data;
+
+	off = !off;
+	state = off ? MCE_DISPLAY_OFF_STRING : MCE_DISPLAY_ON_STRING;
+
+	msg = dbus_message_new_signal(MCE_SIGNAL_PATH, MCE_SIGNAL_IF,
+				      MCE_DISPLAY_SIG);
+	if (msg == NULL)
+		return TRUE;
+
+	if (dbus_message_append_args(msg, DBUS_TYPE_STRING, &state,
+				     DBUS_TYPE_INVALID))
+		dbus_connection_send(bus, msg, NULL);
+	dbus_message_unref(msg);
+
+	return TRUE;
+}
+
+/* Like ICD's state_sig for a connected IAP, on one of two networks */
+static void emit_iap_state(void)
+{
+	static const guchar ssids[][5] = { "wlan0", "wlan1" };
+	const gchar *service_type = "", *service_id = "", *error = "";
+	const gchar *network_type = "WLAN_INFRA";
+	dbus_uint32_t service_attrs = 0, network_attrs = 0;
+	dbus_uint32_t state = ICD_STATE_CONNECTED;
+	const guchar *network_id = ssids[iap % G_N_ELEMENTS(ssids)];
+	int id_len = sizeof(ssids[0]);
+	DBusMessage *msg;
+
+	msg = dbus_message_new_signal(ICD_DBUS_API_PATH,
+				      ICD_DBUS_API_INTERFACE,
+				      ICD_DBUS_API_STATE_SIG);
+	if (msg == NULL)
+		return;
+
+	if (dbus_message_append_args(msg, DBUS_TYPE_STRING, &service_type,
+				     DBUS_TYPE_UINT32, &service_attrs,
+				     DBUS_TYPE_STRING, &service_id,
+				     DBUS_TYPE_STRING, &network_type,
+				     DBUS_TYPE_UINT32, &network_attrs,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE,
+				     &network_id, id_len,
+				     DBUS_TYPE_STRING, &error,
+				     DBUS_TYPE_UINT32, &state,
+				     DBUS_TYPE_INVALID))
+		dbus_connection_send(bus, msg, NULL);
+	dbus_message_unref(msg);
+}
+
+static gboolean iap_cb(gpointer data)
+{
+	(void)data;
+
+	iap++;
+	emit_iap_state();
+	return TRUE;
+}
+
+/* ICD replies with how many state_sig follow */
+static DBusHandlerResult answer_state_req(DBusConnection * dbus,
+					  DBusMessage * msg)
+{
+	dbus_uint32_t n = 1;
+	DBusMessage *reply;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL || !dbus_message_append_args(reply,
+							DBUS_TYPE_UINT32, &n,
+							DBUS_TYPE_INVALID)) {
+		if (reply)
+			dbus_message_unref(reply);
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+	}
+
+	if (!dbus_message_get_no_reply(msg))
+		dbus_connection_send(dbus, reply, NULL);
+	dbus_message_unref(reply);
+
+	emit_iap_state();
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static gboolean send_reply_cb(gpointer data)
+{
+	struct delayed_reply *r = data;
+
+	dbus_connection_send(r->dbus, r->reply, NULL);
+	dbus_message_unref(r->reply);
+	dbus_connection_unref(r->dbus);
+	g_free(r);
+
+	return FALSE;
+}
+
+/* Print what SetMtu or SetKeepalive asked for, and say it was done */
+static DBusMessage *tuning_reply(DBusMessage * msg)
+{
+	dbus_uint32_t mtu, *seconds;
+	gchar **keys;
+	int n_keys, n_seconds, i;
+
+	if (no_tuning)
+		return dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_METHOD,
+					      dbus_message_get_member(msg));
+
+	if (dbus_message_has_member(msg, ICD_WIREGUARD_METHOD_SETMTU)
+	    && dbus_message_get_args(msg, NULL, DBUS_TYPE_UINT32, &mtu,
+				     DBUS_TYPE_INVALID)) {
+		printf("MTU %u\n", mtu);
+	} else if (dbus_message_get_args(msg, NULL, DBUS_TYPE_ARRAY,
+					 DBUS_TYPE_STRING, &keys, &n_keys,
+					 DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+					 &seconds, &n_seconds,
+					 DBUS_TYPE_INVALID)) {
+		for (i = 0; i < n_keys && i < n_seconds; i++)
+			printf("keepalive %us for %s\n", seconds[i], keys[i]);
+		dbus_free_string_array(keys);
+	} else {
+		return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS,
+					      dbus_message_get_member(msg));
+	}
+
+	fflush(stdout);
+	return dbus_message_new_method_return(msg);
+}
+
+static DBusHandlerResult on_message(DBusConnection * dbus,
+				    DBusMessage * msg, gpointer data)
+{
+	struct delayed_reply *r;
+	const gchar *m = mode();
+	DBusMessage *reply;
+	(void)data;
+
+	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	if (iap_cycle && dbus_message_is_method_call(msg,
+						     ICD_DBUS_API_INTERFACE,
+						     ICD_DBUS_API_STATE_REQ))
+		return answer_state_req(dbus, msg);
+
+	if (!dbus_message_has_path(msg, ICD_WIREGUARD_DBUS_PATH))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	if (dbus_message_has_member(msg, ICD_WIREGUARD_METHOD_SETMTU)
+	    || dbus_message_has_member(msg, ICD_WIREGUARD_METHOD_SETKEEPALIVE)) {
+		reply = tuning_reply(msg);
+		if (reply == NULL)
+			return DBUS_HANDLER_RESULT_NEED_MEMORY;
+		if (!dbus_message_get_no_reply(msg))
+			dbus_connection_send(dbus, reply, NULL);
+		dbus_message_unref(reply);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if (!dbus_message_has_member(msg, "GetStatus"))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	r = g_new0(struct delayed_reply, 1);
+	r->reply = dbus_message_new_method_return(msg);
+	if (r->reply == NULL || !dbus_message_append_args(r->reply,
+							   DBUS_TYPE_STRING,
+							   &state,
+							   DBUS_TYPE_STRING,
+							   &m,
+							   DBUS_TYPE_INVALID)) {
+		if (r->reply)
+			dbus_message_unref(r->reply);
+		g_free(r);
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+	}
+	r->dbus = dbus_connection_ref(dbus);
+
+	g_timeout_add(status_delay, send_reply_cb, r);
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	DBusError err;
+	GMainLoop *loop;
+	int ret;
+
+	context = g_option_context_new(NULL);
+	g_option_context_set_summary(context,
+				     "Stand in for the ICD WireGuard provider "
+				     "on the bus.");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return 2;
+	}
+	g_option_context_free(context);
+
+	if (status_delay < 0 || rate < 0 || count < 0 || display_cycle < 0
+	    || iap_cycle < 0 || speed <= 0 || (rate && replay_file)
+	    || !parse_state_name(state_name)) {
+		fprintf(stderr, "Usage: %s [OPTION...]\n", argv[0]);
+		return 2;
+	}
+
+	if (replay_file && !load_trace(replay_file))
+		return 1;
+
+	dbus_error_init(&err);
+	bus = dbus_bus_get(session_bus ? DBUS_BUS_SESSION : DBUS_BUS_SYSTEM,
+			    &err);
+	if (bus == NULL) {
+		fprintf(stderr, "Unable to connect to the bus: %s\n",
+			err.message);
+		dbus_error_free(&err);
+		return 1;
+	}
+
+	ret = dbus_bus_request_name(bus, ICD_WIREGUARD_DBUS_INTERFACE,
+				    DBUS_NAME_FLAG_DO_NOT_QUEUE, &err);
+	if (ret != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+		fprintf(stderr, "Unable to own %s: %s\n",
+			ICD_WIREGUARD_DBUS_INTERFACE,
+			dbus_error_is_set(&err) ? err.message : "name taken");
+		dbus_error_free(&err);
+		return 1;
+	}
+
+	/* The real ICD answers for itself */
+	if (iap_cycle
+	    && dbus_bus_request_name(bus, ICD_DBUS_API_INTERFACE,
+				     DBUS_NAME_FLAG_DO_NOT_QUEUE, NULL) !=
+	    DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+		printf("%s is taken, not answering state_req\n",
+		       ICD_DBUS_API_INTERFACE);
+
+	if (!dbus_connection_add_filter(bus, on_message, NULL, NULL)) {
+		fprintf(stderr, "Unable to add a D-Bus filter\n");
+		return 1;
+	}
+	dbus_connection_setup_with_g_main(bus, NULL);
+
+	loop = g_main_loop_new(NULL, FALSE);
+	if (rate)
+		g_timeout_add(MAX(1000 / rate, 1), emit_cb, loop);
+	if (trace)
+		g_idle_add(replay_cb, loop);
+	if (display_cycle)
+		g_timeout_add_seconds(display_cycle, display_cb, NULL);
+	if (iap_cycle)
+		g_timeout_add_seconds(iap_cycle, iap_cb, NULL);
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+
+	return 0;
+}
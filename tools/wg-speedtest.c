@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2026 wireguard-network-applet contributors
+ *
+ * This file is part of wireguard-network-applet
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "speedtest.h"
+
+/*
+ * Stand-in for the far end of the speed test, and a client to run it
+ * from a shell. On one machine, over loopback:
+ *
+ *   wg-speedtest --serve -d 9009 -c 9019 &
+ *   wg-speedtest -d 9009 -c 9019 127.0.0.1
+ *
+ * Any inetd with its built-in discard and chargen services will do as a
+ * server too.
+ */
+
+struct client {
+	int fd;
+	off_t offset;
+};
+
+static gint discard_port = WG_SPEEDTEST_DISCARD_PORT;
+static gint chargen_port = WG_SPEEDTEST_CHARGEN_PORT;
+static gint seconds = WG_SPEEDTEST_SECONDS;
+static gboolean serve;
+
+/* chargen output, as a file so sendfile() takes it from the page cache */
+static int pattern_fd = -1;
+
+static GOptionEntry entries[] = {
+	{"serve", 's', 0, G_OPTION_ARG_NONE, &serve,
+	 "Serve discard and chargen instead of testing", NULL},
+	{"discard-port", 'd', 0, G_OPTION_ARG_INT, &discard_port,
+	 "Port of the discard service", "PORT"},
+	{"chargen-port", 'c', 0, G_OPTION_ARG_INT, &chargen_port,
+	 "Port of the chargen service", "PORT"},
+	{"seconds", 't', 0, G_OPTION_ARG_INT, &seconds,
+	 "Seconds to test each direction for", "N"},
+	{NULL, 0, 0, 0, NULL, NULL, NULL}
+};
+
+static void client_close(struct client *c)
+{
+	close(c->fd);
+	g_free(c);
+}
+
+static gboolean discard_cb(GIOChannel * source, GIOCondition cond,
+			   gpointer data)
+{
+	static guint8 buf[WG_SPEEDTEST_CHUNK];
+	struct client *c = data;
+	gssize n;
+
+	(void)source;
+	(void)cond;
+
+	/* Nothing is looked at; MSG_TRUNC skips the copy */
+	do {
+		n = recv(c->fd, buf, sizeof(buf), MSG_TRUNC);
+		if (n < 0 && errno == EINVAL)
+			n = recv(c->fd, buf, sizeof(buf), 0);
+	} while (n > 0 || (n < 0 && errno == EINTR));
+
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return TRUE;
+
+	client_close(c);
+	return FALSE;
+}
+
+static gboolean chargen_cb(GIOChannel * source, GIOCondition cond,
+			   gpointer data)
+{
+	struct client *c = data;
+	gssize n;
+
+	(void)source;
+	(void)cond;
+
+	do {
+		n = sendfile(c->fd, pattern_fd, &c->offset,
+			     WG_SPEEDTEST_CHUNK - c->offset);
+		if (c->offset >= WG_SPEEDTEST_CHUNK)
+			c->offset = 0;
+	} while (n > 0 || (n < 0 && errno == EINTR));
+
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return TRUE;
+
+	client_close(c);
+	return FALSE;
+}
+
+static gboolean accept_cb(GIOChannel * source, GIOCondition cond,
+			  gpointer data)
+{
+	gboolean is_chargen = GPOINTER_TO_INT(data);
+	int size = WG_SPEEDTEST_SOCKBUF;
+	GIOChannel *channel;
+	struct client *c;
+	int fd;
+
+	(void)cond;
+
+	fd = accept(g_io_channel_unix_get_fd(source), NULL, NULL);
+	if (fd < 0)
+		return TRUE;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	setsockopt(fd, SOL_SOCKET, is_chargen ? SO_SNDBUF : SO_RCVBUF, &size,
+		   sizeof(size));
+
+	c = g_new0(struct client, 1);
+	c->fd = fd;
+
+	channel = g_io_channel_unix_new(fd);
+	if (is_chargen)
+		g_io_add_watch(channel, G_IO_OUT | G_IO_HUP | G_IO_ERR,
+			       chargen_cb, c);
+	else
+		g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+			       discard_cb, c);
+	g_io_channel_unref(channel);
+
+	return TRUE;
+}
+
+/* Both address families where there is IPv6, IPv4 only otherwise */
+static int listen_on(guint16 port)
+{
+	struct sockaddr_in6 sin6 = { 0 };
+	struct sockaddr_in sin = { 0 };
+	int fd, on = 1, off = 0;
+
+	fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd >= 0) {
+		sin6.sin6_family = AF_INET6;
+		sin6.sin6_addr = in6addr_any;
+		sin6.sin6_port = htons(port);
+		setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(fd, (struct sockaddr *)&sin6, sizeof(sin6)) == 0
+		    && listen(fd, 16) == 0)
+			return fd;
+		close(fd);
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons(port);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0
+	    && listen(fd, 16) == 0)
+		return fd;
+
+	close(fd);
+	return -1;
+}
+
+static int open_pattern(void)
+{
+	guint8 *buf;
+	gchar *path;
+	int fd;
+
+	fd = g_file_open_tmp("wg-speedtest-XXXXXX", &path, NULL);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	g_free(path);
+
+	buf = g_malloc(WG_SPEEDTEST_CHUNK);
+	wg_speedtest_pattern(buf, WG_SPEEDTEST_CHUNK);
+	if (write(fd, buf, WG_SPEEDTEST_CHUNK) != WG_SPEEDTEST_CHUNK) {
+		close(fd);
+		fd = -1;
+	}
+	g_free(buf);
+
+	return fd;
+}
+
+static int run_server(GMainLoop * loop)
+{
+	GIOChannel *channel;
+	int discard_fd, chargen_fd;
+
+	pattern_fd = open_pattern();
+	if (pattern_fd < 0) {
+		fprintf(stderr, "Unable to create the chargen pattern\n");
+		return 1;
+	}
+
+	discard_fd = listen_on(discard_port);
+	chargen_fd = listen_on(chargen_port);
+	if (discard_fd < 0 || chargen_fd < 0) {
+		fprintf(stderr, "Unable to listen on ports %d and %d: %s\n",
+			discard_port, chargen_port, g_strerror(errno));
+		return 1;
+	}
+
+	channel = g_io_channel_unix_new(discard_fd);
+	g_io_add_watch(channel, G_IO_IN, accept_cb, GINT_TO_POINTER(FALSE));
+	g_io_channel_unref(channel);
+
+	channel = g_io_channel_unix_new(chargen_fd);
+	g_io_add_watch(channel, G_IO_IN, accept_cb, GINT_TO_POINTER(TRUE));
+	g_io_channel_unref(channel);
+
+	printf("discard on %d, chargen on %d\n", discard_port, chargen_port);
+	g_main_loop_run(loop);
+
+	return 0;
+}
+
+static void result_cb(const struct wg_speedtest_result *r, gpointer data)
+{
+	printf("down %.1f Mbit/s (%" G_GUINT64_FORMAT " bytes)\n"
+	       "up %.1f Mbit/s (%" G_GUINT64_FORMAT " bytes)\n"
+	       "process cpu %.0f%%\n", r->down_mbps, r->down_bytes,
+	       r->up_mbps, r->up_bytes, r->cpu_percent);
+	if (r->error)
+		printf("error: %s\n", g_strerror(-r->error));
+
+	g_main_loop_quit(data);
+}
+
+static int run_client(GMainLoop * loop, const gchar * host)
+{
+	struct addrinfo hints = { 0 }, *res;
+	int ret;
+
+	hints.ai_socktype = SOCK_STREAM;
+	ret = getaddrinfo(host, NULL, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", host, gai_strerror(ret));
+		return 1;
+	}
+
+	if (wg_speedtest_start(res->ai_addr, res->ai_addrlen, discard_port,
+			       chargen_port, seconds, result_cb, loop) == NULL) {
+		fprintf(stderr, "%s: unsupported address\n", host);
+		freeaddrinfo(res);
+		return 1;
+	}
+	freeaddrinfo(res);
+
+	g_main_loop_run(loop);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GMainLoop *loop;
+	int ret;
+
+	context = g_option_context_new("[HOST]");
+	g_option_context_set_summary(context,
+				     "Measure tunnel throughput against the "
+				     "discard and chargen services of HOST.");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return 2;
+	}
+	g_option_context_free(context);
+
+	if (discard_port < 1 || discard_port > G_MAXUINT16
+	    || chargen_port < 1 || chargen_port > G_MAXUINT16
+	    || (!serve && argc != 2)) {
+		fprintf(stderr, "Usage: %s [OPTION...] [HOST]\n", argv[0]);
+		return 2;
+	}
+
+	/* Clients going away show up as EPIPE instead */
+	signal(SIGPIPE, SIG_IGN);
+
+	loop = g_main_loop_new(NULL, FALSE);
+	ret = serve ? run_server(loop) : run_client(loop, argv[1]);
+	g_main_loop_unref(loop);
+
+	return ret;
+}